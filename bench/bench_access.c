@@ -0,0 +1,135 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sroc.h>
+
+#include "bench_helper.h"
+
+#define SECTIONS 1000
+#define READS_PER_THREAD 2000000
+#define MAX_THREADS 64
+
+static const char *const hot_keys[] = {"port", "host", "enabled", "timeout"};
+
+struct reader {
+        const struct sroc_root *root;
+        size_t id;
+        pthread_t thread;
+};
+
+/**
+ * Every thread mostly reads the same few keys of one section, the worst case
+ * for a single shared counter, with a cold key of another section every so
+ * often
+ */
+static void *run_reader(void *data)
+{
+        struct reader *reader = data;
+        char section[32];
+        int64_t number;
+        const char *string;
+        bool boolean;
+
+        for (size_t i = 0; i < READS_PER_THREAD; ++i) {
+                size_t key = i % 4;
+
+                if (i % 64 == 0) {
+                        snprintf(section,
+                                 sizeof(section),
+                                 "tenant_%06zu",
+                                 (i / 64 + reader->id) % SECTIONS);
+                } else if (i % 64 == 1) {
+                        snprintf(section, sizeof(section), "tenant_000000");
+                }
+
+                if (key == 1) {
+                        sroc_read_string(
+                                reader->root, section, hot_keys[key], &string);
+                } else if (key == 2) {
+                        sroc_read_bool(
+                                reader->root, section, hot_keys[key], &boolean);
+                } else {
+                        sroc_read_number(
+                                reader->root, section, hot_keys[key], &number);
+                }
+        }
+
+        return NULL;
+}
+
+static double run_readers(const struct sroc_root *root, size_t threads)
+{
+        struct reader readers[MAX_THREADS];
+        double start = bench_now();
+
+        for (size_t i = 0; i < threads; ++i) {
+                readers[i].root = root;
+                readers[i].id = i;
+                pthread_create(
+                        &readers[i].thread, NULL, run_reader, &readers[i]);
+        }
+
+        for (size_t i = 0; i < threads; ++i) {
+                pthread_join(readers[i].thread, NULL);
+        }
+
+        return bench_now() - start;
+}
+
+static int sum_counts(const char *section, const char *key, uint64_t count,
+                      void *data)
+{
+        *(uint64_t *)data += count;
+
+        return 0;
+}
+
+int main(int argc, char **argv)
+{
+        size_t threads = (argc > 1) ? strtoul(argv[1], NULL, 10) : 4;
+        size_t length;
+        char *config = bench_generate_config(SECTIONS, &length);
+        struct sroc_root *root;
+
+        if (threads == 0 || threads > MAX_THREADS) {
+                fprintf(stderr, "Thread count must be 1 to %d\n", MAX_THREADS);
+
+                return EXIT_FAILURE;
+        }
+
+        if (config == NULL
+            || (root = sroc_parse_buffer(config, length)) == NULL) {
+                fprintf(stderr, "Failed to parse generated config\n");
+
+                return EXIT_FAILURE;
+        }
+
+        double reads = (double)(threads * READS_PER_THREAD);
+        double plain_time = run_readers(root, threads);
+
+        printf("threads:   %zu\n", threads);
+        printf("untracked: %8.1f ns/read\n", plain_time * 1e9 / reads);
+
+        if (sroc_track_access(root) != 0) {
+                printf("tracked:   built without SROC_WITH_ACCESS_TRACKING\n");
+        } else {
+                double tracked_time = run_readers(root, threads);
+                uint64_t counted = 0;
+
+                sroc_access_report(root, sum_counts, &counted);
+                printf("tracked:   %8.1f ns/read (%+.1f%%), %llu counted\n",
+                       tracked_time * 1e9 / reads,
+                       (tracked_time / plain_time - 1.0) * 100.0,
+                       (unsigned long long)counted);
+        }
+
+        sroc_destroy_root(root);
+        free(config);
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,90 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sroc.h>
+
+#include "bench_helper.h"
+
+#define OVERRIDE_KEYS 16
+
+/**
+ * Layers OVERRIDE_KEYS new or replaced keys onto every section of root, the
+ * way environment and command line overrides are applied to a parsed config
+ */
+static int apply_overrides(struct sroc_root *root, size_t sections)
+{
+        char name[32];
+        char key[32];
+
+        for (size_t i = 0; i < sections; ++i) {
+                struct sroc_table *table;
+
+                snprintf(name, sizeof(name), "tenant_%06zu", i);
+
+                if (sroc_root_add_section(root, name, &table) != 0) {
+                        return -1;
+                }
+
+                for (size_t k = 0; k < OVERRIDE_KEYS; ++k) {
+                        snprintf(key, sizeof(key), "override_%02zu", k);
+
+                        if (sroc_table_set_number(table, key, (int64_t)k)
+                                    != 0
+                            || sroc_table_set_number(table, "port", 443)
+                                       != 0) {
+                                return -1;
+                        }
+                }
+        }
+
+        return 0;
+}
+
+int main(int argc, char **argv)
+{
+        size_t sections = (argc > 1) ? strtoul(argv[1], NULL, 10) : 20000;
+        size_t length;
+        char *config = bench_generate_config(sections, &length);
+        struct sroc_root *root;
+
+        if (config == NULL
+            || (root = sroc_parse_buffer(config, length)) == NULL) {
+                fprintf(stderr, "Failed to parse generated config\n");
+
+                return EXIT_FAILURE;
+        }
+
+        double start = bench_now();
+
+        if (apply_overrides(root, sections) != 0) {
+                fprintf(stderr, "Failed to apply overrides\n");
+
+                return EXIT_FAILURE;
+        }
+
+        double set_time = bench_now() - start;
+
+        start = bench_now();
+
+        if (sroc_freeze(root) != 0) {
+                fprintf(stderr, "Failed to freeze\n");
+
+                return EXIT_FAILURE;
+        }
+
+        double freeze_time = bench_now() - start;
+        size_t sets = sections * OVERRIDE_KEYS * 2;
+
+        printf("input:  %zu sections, %zu sets\n", sections, sets);
+        printf("set:    %8.1f ns/set\n", set_time * 1e9 / (double)sets);
+        printf("freeze: %8.3f ms\n", freeze_time * 1e3);
+
+        sroc_destroy_root(root);
+        free(config);
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,65 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sroc.h>
+
+#include "bench_helper.h"
+
+#define ITERATIONS 20
+
+int main(int argc, char **argv)
+{
+        size_t sections = (argc > 1) ? strtoul(argv[1], NULL, 10) : 20000;
+        size_t length;
+        char *config = bench_generate_config(sections, &length);
+
+        if (config == NULL) {
+                return EXIT_FAILURE;
+        }
+
+        struct sroc_root *root = NULL;
+        double start = bench_now();
+
+        for (int i = 0; i < ITERATIONS; ++i) {
+                sroc_destroy_root(root);
+                root = sroc_parse_buffer(config, length);
+        }
+
+        double parse_time = bench_now() - start;
+
+        if (root == NULL) {
+                fprintf(stderr, "Failed to parse generated config\n");
+
+                return EXIT_FAILURE;
+        }
+
+        struct sroc_sink sink;
+        size_t emitted = 0;
+
+        sroc_init_buffer_sink(&sink);
+        start = bench_now();
+
+        for (int i = 0; i < ITERATIONS; ++i) {
+                // Reuse the grown buffer between iterations
+                sink.buffer.length = 0;
+                sroc_emit(root, &sink);
+                emitted += sink.buffer.length;
+        }
+
+        double emit_time = bench_now() - start;
+
+        printf("input: %zu bytes, %zu sections\n", length, sections);
+        printf("parse: %8.1f MB/s\n",
+               bench_mb_per_sec(length * ITERATIONS, parse_time));
+        printf("emit:  %8.1f MB/s\n", bench_mb_per_sec(emitted, emit_time));
+
+        sroc_release_sink(&sink);
+        sroc_destroy_root(root);
+        free(config);
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,76 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static inline double bench_now(void)
+{
+        struct timespec now;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static inline double bench_mb_per_sec(size_t bytes, double seconds)
+{
+        return ((double)bytes / (1024.0 * 1024.0)) / seconds;
+}
+
+/**
+ * Generates a config with the given number of sections, each holding a mix of
+ * every value type. The result is null terminated and must be freed
+ */
+static inline char *bench_generate_config(size_t sections, size_t *length)
+{
+        size_t capacity = 256 + sections * 512;
+        // Cast so bench-hpp can include this from C++
+        char *buffer = (char *)malloc(capacity);
+        size_t used = 0;
+
+        if (buffer == NULL) {
+                return NULL;
+        }
+
+        used += (size_t)snprintf(buffer + used,
+                                 capacity - used,
+                                 "name = \"generated\"\nversion = 3\n");
+
+        for (size_t i = 0; i < sections; ++i) {
+                used += (size_t)snprintf(
+                        buffer + used,
+                        capacity - used,
+                        "\n[tenant_%06zu]\n"
+                        "host = \"backend-%zu.region-%zu.example.com\"\n"
+                        "port = %zu\n"
+                        "timeout = %zu\n"
+                        "enabled = %s\n"
+                        "weight = -%zu\n"
+                        "motd = \"Say \\\"hello\\\" to tenant %zu\"\n"
+                        "ports = [%zu, %zu, %zu, %zu]\n"
+                        "pools = [\"primary\", \"secondary\"]\n",
+                        i,
+                        i,
+                        i % 16,
+                        8000 + i % 1000,
+                        i * 37,
+                        (i % 2 == 0) ? "true" : "false",
+                        i % 100,
+                        i,
+                        i,
+                        i + 1,
+                        i + 2,
+                        i + 3);
+        }
+
+        *length = used;
+
+        return buffer;
+}
@@ -0,0 +1,101 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sroc.hpp>
+
+#include "bench_helper.h"
+
+#define SECTIONS 1000
+#define READS 20000000
+
+using namespace sroc::literals;
+
+/**
+ * The reads of bench-lookup through the C API, hashing every name each time
+ */
+static int64_t run_c_reads(const struct sroc_root *root)
+{
+        static const char *const sections[] = {
+                "tenant_000000", "tenant_000042", "tenant_000500", NULL};
+        static const char *const keys[] = {"port", "timeout", "weight"};
+        int64_t sum = 0;
+
+        for (size_t i = 0; i < READS; ++i) {
+                int64_t number = 0;
+
+                sroc_read_number(root, sections[i % 4], keys[i % 3], &number);
+                sum += number;
+        }
+
+        return sum;
+}
+
+/**
+ * The same reads through sroc.hpp, with every name hashed at compile time
+ */
+static int64_t run_hpp_reads(const sroc::root &cfg)
+{
+        static constexpr sroc::section sections[] = {
+                "tenant_000000"_sec, "tenant_000042"_sec, "tenant_000500"_sec};
+        static constexpr sroc::key keys[] = {
+                "port"_key, "timeout"_key, "weight"_key};
+        int64_t sum = 0;
+
+        for (size_t i = 0; i < READS; ++i) {
+                int64_t number = 0;
+
+                if (i % 4 == 3) {
+                        cfg.read(keys[i % 3], number);
+                } else {
+                        cfg.read(sections[i % 4], keys[i % 3], number);
+                }
+
+                sum += number;
+        }
+
+        return sum;
+}
+
+int main(void)
+{
+        size_t length;
+        char *config = bench_generate_config(SECTIONS, &length);
+
+        if (config == NULL) {
+                fprintf(stderr, "Failed to generate config\n");
+
+                return EXIT_FAILURE;
+        }
+
+        sroc::root cfg = sroc::root::parse(std::string_view(config, length));
+
+        if (!cfg) {
+                fprintf(stderr, "Failed to parse generated config\n");
+
+                return EXIT_FAILURE;
+        }
+
+        double start = bench_now();
+        int64_t c_sum = run_c_reads(cfg.handle());
+        double c_elapsed = bench_now() - start;
+
+        start = bench_now();
+        int64_t hpp_sum = run_hpp_reads(cfg);
+        double hpp_elapsed = bench_now() - start;
+
+        printf("c api    %6.1f ns/read (checksum %lld)\n",
+               c_elapsed * 1e9 / READS,
+               (long long)c_sum);
+        printf("sroc.hpp %6.1f ns/read (checksum %lld)\n",
+               hpp_elapsed * 1e9 / READS,
+               (long long)hpp_sum);
+
+        free(config);
+
+        return (c_sum == hpp_sum) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,142 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include <sroc.h>
+
+#include "bench_helper.h"
+
+#define SECTIONS 100000
+#define READS 20000000
+
+// The copied variant links a library built with SROC_NO_INTERN, which gives
+// every key and string a copy of its own as before interning
+#if defined(SROC_NO_INTERN)
+#define BENCH_VARIANT "copied"
+#else
+#define BENCH_VARIANT "interned"
+#endif
+
+#define KEYS 4
+
+static const char *const key_names[KEYS] = {
+        "port", "timeout", "weight", "host"};
+
+/**
+ * Bytes the allocator has handed out, or 0 where that cannot be asked for
+ */
+static size_t heap_in_use(void)
+{
+#if defined(__GLIBC__)
+#if __GLIBC_PREREQ(2, 33)
+// mallinfo2 returns its counters by value
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Waggregate-return"
+        struct mallinfo2 info = mallinfo2();
+#pragma GCC diagnostic pop
+
+        return info.uordblks;
+#endif
+#endif
+        return 0;
+}
+
+/**
+ * The same few keys of a handful of sections again and again, with the keys
+ * given by the caller
+ */
+static double run_reads(const struct sroc_root *root,
+                        const struct sroc_key *keys, int64_t *checksum)
+{
+        struct sroc_key sections[3];
+        static const char *const section_names[] = {
+                "tenant_000000", "tenant_042000", "tenant_099999"};
+
+        for (size_t i = 0; i < 3; ++i) {
+                sections[i].name = section_names[i];
+                sections[i].hash = sroc_hash_key(section_names[i],
+                                                 strlen(section_names[i]));
+        }
+
+        int64_t sum = 0;
+        double start = bench_now();
+
+        for (size_t i = 0; i < READS; ++i) {
+                const struct sroc_value *value;
+
+                if (sroc_read_value(root,
+                                    &sections[i % 3],
+                                    &keys[i % KEYS],
+                                    &value)
+                    == 0) {
+                        sum += (value->type == SROC_NUMBER) ? value->number : 1;
+                }
+        }
+
+        *checksum = sum;
+
+        return bench_now() - start;
+}
+
+int main(void)
+{
+        size_t length;
+        char *config = bench_generate_config(SECTIONS, &length);
+
+        if (config == NULL) {
+                fprintf(stderr, "Failed to generate config\n");
+
+                return EXIT_FAILURE;
+        }
+
+        size_t heap_before = heap_in_use();
+        double start = bench_now();
+        struct sroc_root *root = sroc_parse_buffer(config, length);
+        double parse_time = bench_now() - start;
+        size_t heap = heap_in_use() - heap_before;
+
+        if (root == NULL) {
+                fprintf(stderr, "Failed to parse generated config\n");
+
+                return EXIT_FAILURE;
+        }
+
+        struct sroc_key plain[KEYS];
+        struct sroc_key interned[KEYS];
+
+        for (size_t i = 0; i < KEYS; ++i) {
+                plain[i].name = key_names[i];
+                plain[i].hash = sroc_hash_key(key_names[i],
+                                              strlen(key_names[i]));
+
+                // Falls back to the plain key when nothing was interned
+                sroc_intern_key(root, key_names[i], &interned[i]);
+        }
+
+        int64_t plain_sum;
+        int64_t interned_sum;
+        double plain_time = run_reads(root, plain, &plain_sum);
+        double interned_time = run_reads(root, interned, &interned_sum);
+
+        printf("%-9s %8.1f MB heap %8.1f ms parse %6.1f ns/read plain keys "
+               "%6.1f ns/read interned keys (checksum %lld)\n",
+               BENCH_VARIANT,
+               (double)heap / (1024.0 * 1024.0),
+               parse_time * 1e3,
+               plain_time * 1e9 / READS,
+               interned_time * 1e9 / READS,
+               (long long)(plain_sum + interned_sum));
+
+        sroc_destroy_root(root);
+        free(config);
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,76 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// The amalgamated variant compiles the whole library into this file instead
+// of linking it, so the reads below can be inlined
+#if defined(BENCH_AMALGAMATED)
+#include "sroc_amalgamation.c"
+#else
+#include <sroc.h>
+#endif
+
+#include "bench_helper.h"
+
+#define SECTIONS 1000
+#define READS 20000000
+
+#if defined(BENCH_AMALGAMATED)
+#define BENCH_VARIANT "amalgamated"
+#elif defined(BENCH_STATIC)
+#define BENCH_VARIANT "static"
+#else
+#define BENCH_VARIANT "shared"
+#endif
+
+/**
+ * The hot path of a program reading its settings, the same few keys of a
+ * handful of sections again and again
+ */
+static int64_t run_reads(const struct sroc_root *root)
+{
+        static const char *const sections[] = {
+                "tenant_000000", "tenant_000042", "tenant_000500", NULL};
+        static const char *const keys[] = {"port", "timeout", "weight"};
+        int64_t sum = 0;
+
+        for (size_t i = 0; i < READS; ++i) {
+                int64_t number = 0;
+
+                sroc_read_number(root, sections[i % 4], keys[i % 3], &number);
+                sum += number;
+        }
+
+        return sum;
+}
+
+int main(void)
+{
+        size_t length;
+        char *config = bench_generate_config(SECTIONS, &length);
+        struct sroc_root *root;
+
+        if (config == NULL
+            || (root = sroc_parse_buffer(config, length)) == NULL) {
+                fprintf(stderr, "Failed to parse generated config\n");
+
+                return EXIT_FAILURE;
+        }
+
+        double start = bench_now();
+        int64_t sum = run_reads(root);
+        double elapsed = bench_now() - start;
+
+        printf("%-12s %6.1f ns/read (checksum %lld)\n",
+               BENCH_VARIANT,
+               elapsed * 1e9 / READS,
+               (long long)sum);
+
+        sroc_destroy_root(root);
+        free(config);
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sroc.h>
+
+#include "bench_helper.h"
+
+#define SERVICES 20000
+#define LOOKUPS 10000000
+
+static const char *const small_keys[] = {
+        "host", "port", "timeout", "retries", "weight", "zone"};
+
+/**
+ * Generates one item per service holding a nested object with a small object
+ * of connection settings and a large object of per route limits
+ */
+static char *generate_objects(size_t services, size_t *length)
+{
+        size_t capacity = services * 512;
+        char *buffer = malloc(capacity);
+        size_t used = 0;
+
+        if (buffer == NULL) {
+                return NULL;
+        }
+
+        for (size_t i = 0; i < services; ++i) {
+                used += (size_t)snprintf(
+                        buffer + used,
+                        capacity - used,
+                        "service_%06zu = {\n"
+                        "    conn: {host: \"svc-%zu.internal\", port: %zu, "
+                        "timeout: 30, retries: 3, weight: %zu, zone: \"a\"},\n"
+                        "    routes: {r0: 1, r1: 2, r2: 3, r3: 4, r4: 5, "
+                        "r5: 6, r6: 7, r7: 8, r8: 9, r9: 10, r10: 11, "
+                        "r11: 12},\n"
+                        "}\n",
+                        i,
+                        i,
+                        8000 + i % 1000,
+                        i % 100);
+        }
+
+        *length = used;
+
+        return buffer;
+}
+
+int main(int argc, char **argv)
+{
+        size_t services = (argc > 1) ? strtoul(argv[1], NULL, 10) : SERVICES;
+        size_t length;
+        char *config = generate_objects(services, &length);
+
+        if (config == NULL) {
+                return EXIT_FAILURE;
+        }
+
+        double start = bench_now();
+        struct sroc_root *root = sroc_parse_buffer(config, length);
+        double parse_time = bench_now() - start;
+
+        if (root == NULL) {
+                fprintf(stderr, "Failed to parse generated config\n");
+
+                return EXIT_FAILURE;
+        }
+
+        struct sroc_object *service;
+        const struct sroc_value *conn;
+        const struct sroc_value *routes;
+        const struct sroc_value *value;
+        int64_t sum = 0;
+
+        sroc_read_object(root, NULL, "service_000042", &service);
+        sroc_object_get(service, "conn", &conn);
+        sroc_object_get(service, "routes", &routes);
+
+        start = bench_now();
+
+        for (size_t i = 0; i < LOOKUPS; ++i) {
+                if (sroc_object_get(conn->object, small_keys[i % 6], &value)
+                            == 0
+                    && value->type == SROC_NUMBER) {
+                        sum += value->number;
+                }
+        }
+
+        double small_time = bench_now() - start;
+
+        start = bench_now();
+
+        for (size_t i = 0; i < LOOKUPS; ++i) {
+                if (sroc_object_get(routes->object, (i & 1) ? "r3" : "r11",
+                                    &value)
+                    == 0) {
+                        sum += value->number;
+                }
+        }
+
+        double large_time = bench_now() - start;
+
+        printf("parse:        %8.1f MB/s (%zu services)\n",
+               bench_mb_per_sec(length, parse_time),
+               services);
+        printf("small object: %8.1f ns/lookup\n", small_time * 1e9 / LOOKUPS);
+        printf("large object: %8.1f ns/lookup\n", large_time * 1e9 / LOOKUPS);
+        printf("checksum:     %lld\n", (long long)sum);
+
+        sroc_destroy_root(root);
+        free(config);
+
+        return EXIT_SUCCESS;
+}
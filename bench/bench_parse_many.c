@@ -0,0 +1,138 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sroc.h>
+
+#include "bench_helper.h"
+
+#define PATH_LENGTH 64
+#define SECTIONS_PER_FILE 4
+
+/**
+ * Writes count small per tenant files into a new temporary directory and
+ * returns their paths
+ */
+static char **write_files(char *dir, size_t count)
+{
+        size_t length;
+        char *config = bench_generate_config(SECTIONS_PER_FILE, &length);
+        char **paths = calloc(count, sizeof(char *));
+
+        if (config == NULL || paths == NULL || mkdtemp(dir) == NULL) {
+                return NULL;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+                paths[i] = malloc(PATH_LENGTH);
+
+                if (paths[i] == NULL) {
+                        return NULL;
+                }
+
+                snprintf(paths[i], PATH_LENGTH, "%s/%06zu.conf", dir, i);
+
+                FILE *file = fopen(paths[i], "w");
+
+                if (file == NULL) {
+                        return NULL;
+                }
+
+                fwrite(config, 1, length, file);
+                fclose(file);
+        }
+
+        free(config);
+
+        return paths;
+}
+
+static double time_sequential(char **paths, size_t count)
+{
+        double start = bench_now();
+
+        for (size_t i = 0; i < count; ++i) {
+                FILE *file = fopen(paths[i], "r");
+
+                if (file == NULL) {
+                        exit(EXIT_FAILURE);
+                }
+
+                struct sroc_root *root = sroc_parse_file(file);
+
+                fclose(file);
+
+                if (root == NULL) {
+                        exit(EXIT_FAILURE);
+                }
+
+                sroc_destroy_root(root);
+        }
+
+        return bench_now() - start;
+}
+
+static double time_batch(char **paths, size_t count, size_t nthreads,
+                         struct sroc_parse_result *results)
+{
+        const char *const *path_list = (const char *const *)paths;
+        double start = bench_now();
+
+        if (sroc_parse_many(path_list, count, nthreads, results) != 0) {
+                fprintf(stderr, "sroc_parse_many reported failures\n");
+                exit(EXIT_FAILURE);
+        }
+
+        double elapsed = bench_now() - start;
+
+        for (size_t i = 0; i < count; ++i) {
+                sroc_destroy_root(results[i].root);
+        }
+
+        return elapsed;
+}
+
+int main(int argc, char **argv)
+{
+        size_t count = (argc > 1) ? strtoul(argv[1], NULL, 10) : 20000;
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        char dir[] = "/tmp/sroc-bench-XXXXXX";
+        char **paths = write_files(dir, count);
+        struct sroc_parse_result *results
+                = calloc(count, sizeof(struct sroc_parse_result));
+
+        if (paths == NULL || results == NULL) {
+                fprintf(stderr, "Failed to generate benchmark files\n");
+
+                return EXIT_FAILURE;
+        }
+
+        // Warm the page cache so every run measures the same thing
+        time_sequential(paths, count);
+
+        printf("files: %zu, cpus: %ld\n", count, cpus);
+        printf("fopen + sroc_parse_file:     %8.1f ms\n",
+               time_sequential(paths, count) * 1000.0);
+
+        for (size_t nthreads = 1; nthreads <= (size_t)cpus * 2; nthreads *= 2) {
+                printf("sroc_parse_many %3zu threads: %8.1f ms\n",
+                       nthreads,
+                       time_batch(paths, count, nthreads, results) * 1000.0);
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+                unlink(paths[i]);
+                free(paths[i]);
+        }
+
+        rmdir(dir);
+        free(paths);
+        free(results);
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,62 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sroc.h>
+
+#include "bench_helper.h"
+
+#define ITERATIONS 20
+
+int main(int argc, char **argv)
+{
+        size_t sections = (argc > 1) ? strtoul(argv[1], NULL, 10) : 20000;
+        size_t length;
+        char *config = bench_generate_config(sections, &length);
+
+        if (config == NULL) {
+                return EXIT_FAILURE;
+        }
+
+        struct sroc_root *root = NULL;
+        double start = bench_now();
+
+        for (int i = 0; i < ITERATIONS; ++i) {
+                sroc_destroy_root(root);
+                root = sroc_parse_buffer(config, length);
+        }
+
+        double parse_time = (bench_now() - start) / ITERATIONS;
+
+        // Flip a single digit of a port in the middle of the file on every
+        // reload so exactly one section changes each time
+        char *port = strstr(config + length / 2, "port = ");
+
+        start = bench_now();
+
+        for (int i = 0; i < ITERATIONS; ++i) {
+                port[7] = (char)('1' + i % 9);
+                root = sroc_reparse(root, config, length);
+        }
+
+        double reparse_time = (bench_now() - start) / ITERATIONS;
+
+        if (root == NULL) {
+                fprintf(stderr, "Failed to reparse generated config\n");
+
+                return EXIT_FAILURE;
+        }
+
+        printf("input: %zu bytes, %zu sections\n", length, sections);
+        printf("full parse:   %10.3f ms\n", parse_time * 1000.0);
+        printf("reparse:      %10.3f ms\n", reparse_time * 1000.0);
+
+        sroc_destroy_root(root);
+        free(config);
+
+        return EXIT_SUCCESS;
+}
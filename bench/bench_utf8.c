@@ -0,0 +1,100 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/scan.h"
+#include "../src/utf8.h"
+#include "bench_helper.h"
+
+#define ITERATIONS 50
+
+typedef size_t (*validator)(const char *buffer, size_t length);
+
+static double time_validator(validator validate, const char *buffer,
+                             size_t length)
+{
+        double start = bench_now();
+
+        for (int i = 0; i < ITERATIONS; ++i) {
+                if (validate(buffer, length) != length) {
+                        fprintf(stderr, "Benchmark input is not valid UTF-8\n");
+                        exit(EXIT_FAILURE);
+                }
+        }
+
+        return (bench_now() - start) / ITERATIONS;
+}
+
+static double time_memcpy(char *dest, const char *buffer, size_t length)
+{
+        double start = bench_now();
+
+        for (int i = 0; i < ITERATIONS; ++i) {
+                memcpy(dest, buffer, length);
+        }
+
+        double elapsed = (bench_now() - start) / ITERATIONS;
+
+        // Keeps the copies from being optimized away
+        if (memcmp(dest, buffer, length) != 0) {
+                exit(EXIT_FAILURE);
+        }
+
+        return elapsed;
+}
+
+static void run(const char *name, char *buffer, char *copy, size_t length)
+{
+        enum scan_tier active = scan_active_tier();
+
+        printf("%s (%zu bytes)\n", name, length);
+
+        for (int tier = SCAN_SCALAR; tier <= (int)scan_supported_tier();
+             ++tier) {
+                scan_use_tier((enum scan_tier)tier);
+                printf("  %-6s utf8_validate: %8.1f MB/s\n",
+                       scan_tier_name((enum scan_tier)tier),
+                       bench_mb_per_sec(length,
+                                        time_validator(utf8_validate, buffer,
+                                                       length)));
+        }
+
+        scan_use_tier(active);
+        printf("  memcpy:               %8.1f MB/s\n",
+               bench_mb_per_sec(length, time_memcpy(copy, buffer, length)));
+}
+
+int main(int argc, char **argv)
+{
+        size_t sections = (argc > 1) ? strtoul(argv[1], NULL, 10) : 20000;
+        size_t length;
+        char *config = bench_generate_config(sections, &length);
+        char *text = malloc(length);
+        char *copy = malloc(length);
+
+        if (config == NULL || text == NULL || copy == NULL) {
+                return EXIT_FAILURE;
+        }
+
+        // Mixed width text, where every block has to take the vector path
+        const char *phrase = "caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x91\x8b ";
+        size_t phrase_length = strlen(phrase);
+        size_t text_length = length - length % phrase_length;
+
+        for (size_t i = 0; i < text_length; i += phrase_length) {
+                memcpy(text + i, phrase, phrase_length);
+        }
+
+        run("generated config", config, copy, length);
+        run("multi-byte text", text, copy, text_length);
+
+        free(copy);
+        free(text);
+        free(config);
+
+        return EXIT_SUCCESS;
+}
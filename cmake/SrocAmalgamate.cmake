@@ -0,0 +1,78 @@
+# SrocAmalgamate
+# --------------
+#
+# Script run with cmake -P by the sroc-amalgamation target. It joins every
+# library source into a single sroc_amalgamation.c and copies sroc.h next to
+# it, so the library can be compiled into a program's own translation units
+# where the compiler is free to inline it
+#
+# The sources are appended in the order of SROC_SOURCES. Each internal header
+# is pasted in place of the first include of it and later includes of it are
+# dropped, so headers always come before their users
+#
+# Variables
+# ---------
+# SROC_SOURCE_DIR - Root of the sroc source tree
+# SROC_SOURCES - Library sources relative to SROC_SOURCE_DIR
+# SROC_OUTPUT_DIR - Directory the pair is written to
+#
+
+set(_output ${SROC_OUTPUT_DIR}/sroc_amalgamation.c)
+
+# sroc.h is included once at the top of the amalgamation
+set_property(GLOBAL PROPERTY SROC_AMALGAMATED_HEADERS sroc.h)
+
+function(sroc_expand_includes content_var)
+    set(_content "${${content_var}}")
+    string(REGEX MATCHALL "#include \"[a-z0-9_]+\\.h\"\n" _includes
+        "${_content}"
+    )
+
+    foreach(_include ${_includes})
+        string(REGEX REPLACE "#include \"([a-z0-9_]+\\.h)\"\n" "\\1" _header
+            "${_include}"
+        )
+        get_property(_done GLOBAL PROPERTY SROC_AMALGAMATED_HEADERS)
+        list(FIND _done ${_header} _position)
+
+        if(NOT _position EQUAL -1)
+            string(REPLACE "${_include}" "" _content "${_content}")
+            continue()
+        endif()
+
+        set_property(GLOBAL APPEND PROPERTY SROC_AMALGAMATED_HEADERS
+            ${_header}
+        )
+        file(READ ${SROC_SOURCE_DIR}/src/${_header} _header_content)
+        string(REPLACE "#pragma once\n" "" _header_content
+            "${_header_content}"
+        )
+        sroc_expand_includes(_header_content)
+        string(REPLACE "${_include}"
+            "// src/${_header}\n${_header_content}\n" _content "${_content}"
+        )
+    endforeach()
+
+    set(${content_var} "${_content}" PARENT_SCOPE)
+endfunction()
+
+file(MAKE_DIRECTORY ${SROC_OUTPUT_DIR})
+configure_file(${SROC_SOURCE_DIR}/include/sroc.h ${SROC_OUTPUT_DIR}/sroc.h
+    COPYONLY
+)
+
+file(WRITE ${_output}
+    "// Generated from the sroc sources by SrocAmalgamate.cmake, do not edit\n"
+    "\n"
+    "#include \"sroc.h\"\n"
+)
+
+foreach(_source ${SROC_SOURCES})
+    if(NOT _source MATCHES "\\.c$")
+        continue()
+    endif()
+
+    file(READ ${SROC_SOURCE_DIR}/${_source} _content)
+    sroc_expand_includes(_content)
+    file(APPEND ${_output} "\n// ${_source}\n\n${_content}")
+endforeach()
@@ -0,0 +1,43 @@
+# SrocEmbedConfig
+# ---------------
+#
+# Function which compiles a sroc configuration file into C source and adds it
+# to a target. The configuration is available as a static const sroc_root,
+# which is usable with every sroc_read_* function without parsing at runtime
+#
+# The root is named sroc_config_<name> where <name> is the file name without
+# its extension and with anything that is not alphanumeric replaced by '_'. It
+# is declared in the generated header sroc_config_<name>.h
+#
+# Example
+# -------
+# sroc_embed_config(my-app defaults.conf)
+#
+# #include "sroc_config_defaults.h"
+# sroc_read_number(&sroc_config_defaults, "net", "port", &port);
+#
+
+function(SROC_EMBED_CONFIG _TARGET_NAME _CONFIG_FILE)
+    get_filename_component(_config_path ${_CONFIG_FILE} ABSOLUTE)
+    get_filename_component(_config_name ${_CONFIG_FILE} NAME_WE)
+    string(MAKE_C_IDENTIFIER ${_config_name} _config_name)
+
+    set(_symbol sroc_config_${_config_name})
+    set(_output_dir ${CMAKE_CURRENT_BINARY_DIR}/sroc_embedded)
+    set(_output_source ${_output_dir}/${_symbol}.c)
+    set(_output_header ${_output_dir}/${_symbol}.h)
+
+    add_custom_command(
+        OUTPUT ${_output_source} ${_output_header}
+        COMMAND ${CMAKE_COMMAND} -E make_directory ${_output_dir}
+        COMMAND sroc-compile
+            ${_config_path} ${_output_source} ${_output_header} ${_symbol}
+        DEPENDS sroc-compile ${_config_path}
+        COMMENT "Compiling sroc configuration ${_CONFIG_FILE}"
+        VERBATIM
+    )
+
+    target_sources(${_TARGET_NAME} PRIVATE ${_output_source} ${_output_header})
+    target_include_directories(${_TARGET_NAME} PRIVATE ${_output_dir})
+    target_link_libraries(${_TARGET_NAME} PRIVATE sroc)
+endfunction(SROC_EMBED_CONFIG)
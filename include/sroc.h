@@ -8,11 +8,25 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
 enum sroc_error {
         SROC_ERRNOKEY = -1,
         SROC_ERRNOSECTION = -2,
         SROC_ERRNOMEM = -3,
         SROC_ERRIO = -4,
+        SROC_ERRINVAL = -5,
+        SROC_ERRTYPE = -6,
+        SROC_ERRTOOBIG = -7,
+        SROC_ERRDEPTH = -8,
+        SROC_ERRITEMS = -9,
+        SROC_ERRSTRLEN = -10,
+        SROC_ERRMEMLIMIT = -11,
+        SROC_ERRTIMEOUT = -12,
+        SROC_ERRAGAIN = -13,
+        SROC_ERRCANCELED = -14,
 };
 
 enum sroc_type {
@@ -20,85 +34,459 @@ enum sroc_type {
         SROC_BOOL,
         SROC_NUMBER,
         SROC_STRING,
+        SROC_OBJECT,
+};
+
+enum sroc_change {
+        SROC_ADDED,
+        SROC_REMOVED,
+        SROC_MODIFIED,
 };
 
 // Forward declare sroc_type for use with parent types
 struct sroc_value;
+struct sroc_object;
+
+// Read counters of a root, private to the library
+struct sroc_access;
+
+// Interned keys and strings of a root, private to the library
+struct sroc_intern;
+
+// A file being loaded in the background by sroc_load_async
+struct sroc_load_job;
 
 /**
  * A sroc array is an array of valid sroc value
  *
- * Each item in the array must be equal in type to the rest of the items
+ * Each item in the array must be equal in type to the rest of the items.
+ * capacity is the number of values items has room for, which is at least
+ * length while the array is being built
+ *
+ * frozen is set on arrays which were parsed, generated by sroc-compile or
+ * passed through sroc_freeze. Their item already holds a hash of their
+ * content and they may be shared with derived roots, so sroc_array_push
+ * rejects them. Arrays of a built root which was not frozen before it was
+ * derived from are shared with the derived roots without being frozen and
+ * must not be pushed onto either
  */
 struct sroc_array {
         size_t length;
         enum sroc_type type;
         struct sroc_value **items;
+        size_t capacity;
+        bool frozen;
 };
 
 /**
  * The sroc value contains one of the valid sroc values
+ *
+ * interned is set when string is a copy stored in the intern table of the
+ * root which parsed it and shared with equal strings, so it must not be freed
+ * on its own
  */
 struct sroc_value {
         enum sroc_type type;
+        bool interned;
         union {
                 struct sroc_array *array;
                 bool boolean;
                 int64_t number;
                 char *string;
+                struct sroc_object *object;
         };
 };
 
+/**
+ * A sroc field is a key value pair of an object. Unlike items the value is
+ * stored inline rather than behind a pointer
+ */
+struct sroc_field {
+        char *key;
+        struct sroc_value value;
+};
+
+/**
+ * A sroc object is a list of fields kept in file order. An object is a single
+ * allocation holding its fields, the hash of each key and the text of every
+ * key and string value, so parsing one does not allocate per field. Nested
+ * objects and arrays are allocations of their own.
+ *
+ * Objects of up to SROC_SMALL_OBJECT fields are searched by comparing the key
+ * hash against all of hashes at once, which is padded to SROC_SMALL_OBJECT
+ * entries for that. Larger objects also hold an open addressed lookup in
+ * slots, and slots is NULL otherwise. Objects built at run time have a seed
+ * of 0 and place each field by a hash of its key keyed per process. Objects
+ * generated by sroc-compile place the field with key hash h at
+ * hash_mix(h ^ seed) & mask.
+ *
+ * Objects are read only. The fields of an object must never be destroyed on
+ * their own, only the whole object with sroc_destroy_object
+ */
+#define SROC_SMALL_OBJECT 8
+
+struct sroc_object {
+        size_t length;
+        struct sroc_field *fields;
+        uint64_t *hashes;
+        size_t mask;
+        size_t *slots;
+        uint64_t seed;
+};
+
 /**
  * A sroc item is a key value type where the key is a single word string and
  * the value is any valid sroc value
+ *
+ * The value hash is a hash of the value's content, or 0 when unknown, and
+ * lets sroc_diff tell most changed items apart without walking their values
+ *
+ * interned is set when key is stored in the intern table of the root, like
+ * the interned strings of values
  */
 struct sroc_item {
         char *key;
         struct sroc_value *value;
+        uint64_t value_hash;
+        bool interned;
+};
+
+/**
+ * A sroc lookup is an open addressed hash index from key to position.
+ *
+ * Lookups built at parse time place a key by a hash of it keyed per process,
+ * so which keys collide cannot be known ahead of time. They probe linearly
+ * from there and keep that hash of the key at each slot in hashes, so keys
+ * are only compared when their hashes match. Lookups generated by sroc-compile
+ * place a key with hash h at hash_mix(h ^ seed) & mask, with one seed per
+ * bucket (h & seeds_mask) chosen so that no two keys share a slot, so a
+ * single probe is enough, and hashes is NULL
+ */
+#define SROC_EMPTY_SLOT SIZE_MAX
+
+struct sroc_lookup {
+        size_t mask;
+        size_t *slots;
+        size_t seeds_mask;
+        uint64_t *seeds;
+        uint64_t *hashes;
 };
 
 /**
  * A sroc table (or section) is a keyed list of sroc items
+ *
+ * The hash is a fingerprint of the source text the table was parsed from and
+ * is used by sroc_reparse to detect unchanged sections. It is keyed per
+ * process and 0 for tables which were not parsed by this one
+ *
+ * The index holds the positions of the items sorted by key and the lookup
+ * maps key hashes to positions. Both are built at parse time, kept current by
+ * the sroc_table_set_* functions and are empty for tables which have not been
+ * indexed
+ *
+ * capacity is the number of items the items array (and the index, when there
+ * is one) has room for. It is separate from size so items can be added
+ * without reallocating each time
+ *
+ * base is the table of a base root this table was copied from when a derived
+ * root first changed it, and NULL otherwise. An item at the same position as
+ * in base is shared with it and belongs to base
  */
 struct sroc_table {
         char *key;
         size_t size;
+        size_t capacity;
         struct sroc_item **items;
+        size_t *index;
+        struct sroc_lookup lookup;
+        uint64_t hash;
+        const struct sroc_table *base;
 };
 
 /**
  * The sroc root is the root of the file. It contains all the sroc items that
  * are not under a section as well as all the sections in the configuration
  * file
+ *
+ * access holds the read counters started by sroc_track_access and is NULL
+ * while reads are not being counted
+ *
+ * base is the root a root made by sroc_derive reads through to, and NULL for
+ * any other root. A derived root holds only the sections it changed, and
+ * shares the items outside of sections with base until it changes one of
+ * them. references counts the roots derived from this one which are still
+ * alive and is managed by the library. It is SROC_STATIC_ROOT for roots
+ * generated by sroc-compile, which live in read only storage and are never
+ * counted or freed
+ *
+ * strings holds the keys and short strings of a parsed root, stored once
+ * however often they repeat. It is NULL for roots which were not parsed
  */
+#define SROC_STATIC_ROOT SIZE_MAX
+
 struct sroc_root {
         size_t items_length;
+        size_t items_capacity;
         struct sroc_item **items;
+        size_t *items_index;
+        struct sroc_lookup items_lookup;
+        uint64_t items_hash;
         size_t sections_length;
+        size_t sections_capacity;
         struct sroc_table **sections;
+        size_t *sections_index;
+        struct sroc_lookup sections_lookup;
+        struct sroc_access *access;
+        struct sroc_root *base;
+        size_t references;
+        struct sroc_intern *strings;
+};
+
+/**
+ * A sroc key is a section or key name together with its sroc_hash_key, so
+ * the hash can be computed once, or at compile time by sroc.hpp, and reused
+ * by every sroc_read_value. Roots generated by sroc-compile look keys up by
+ * that hash alone, parsed roots by a hash of the name keyed per process
+ */
+struct sroc_key {
+        const char *name;
+        uint64_t hash;
+};
+
+/**
+ * Cursors walk a range of the sorted section or key index. They allocate
+ * nothing and are advanced with sroc_next_section and sroc_next_key. The
+ * section cursor of a derived root also walks the matching range of its base
+ */
+struct sroc_section_cursor {
+        struct sroc_table *const *sections;
+        const size_t *next;
+        const size_t *end;
+        struct sroc_table *const *base_sections;
+        const size_t *base_next;
+        const size_t *base_end;
+};
+
+struct sroc_key_cursor {
+        struct sroc_item *const *items;
+        const size_t *next;
+        const size_t *end;
 };
 
+struct sroc_field_cursor {
+        const struct sroc_field *next;
+        const struct sroc_field *end;
+};
+
+enum sroc_sink_type {
+        SROC_SINK_BUFFER,
+        SROC_SINK_FILE,
+        SROC_SINK_FD,
+};
+
+/**
+ * A sroc sink is the destination sroc_emit writes to. A buffer sink grows as
+ * needed, is always null terminated and must be released with
+ * sroc_release_sink
+ */
+struct sroc_sink {
+        enum sroc_sink_type type;
+        union {
+                struct {
+                        char *data;
+                        size_t length;
+                        size_t capacity;
+                } buffer;
+                FILE *file;
+                int fd;
+        };
+};
+
+/**
+ * Outcome of parsing a single file with sroc_parse_many. error is 0 and root
+ * is set on success, otherwise root is NULL and error is a negative sroc_error
+ */
+struct sroc_parse_result {
+        struct sroc_root *root;
+        int error;
+};
+
+/**
+ * Bounds for parsing untrusted input with sroc_parse_limited. A field left at
+ * 0 is not limited.
+ *
+ * max_bytes bounds the input length, max_depth how deeply arrays and objects
+ * nest and max_items the number of items, sections, array values and object
+ * fields together.
+ * max_string_length applies to each string after escapes are removed.
+ * max_alloc_bytes bounds the memory taken by the resulting tree, counted as
+ * the size of its nodes, keys, strings and indexes without allocator
+ * overhead. deadline_ns is a CLOCK_MONOTONIC time in nanoseconds after which
+ * the parse gives up
+ */
+struct sroc_limits {
+        size_t max_bytes;
+        size_t max_depth;
+        size_t max_items;
+        size_t max_string_length;
+        size_t max_alloc_bytes;
+        uint64_t deadline_ns;
+};
+
+/**
+ * Called by a job started with sroc_load_async once it has finished, on the
+ * thread which loaded the file. It may collect the result with
+ * sroc_load_poll but must not release the job
+ */
+typedef void (*sroc_load_callback)(struct sroc_load_job *job, void *data);
+
+/**
+ * Options for sroc_load_async, which may be NULL to use the defaults.
+ *
+ * limits are applied as by sroc_parse_limited and may be NULL. callback is
+ * called with data when the job finishes unless it was canceled, and may be
+ * NULL
+ */
+struct sroc_load_options {
+        const struct sroc_limits *limits;
+        sroc_load_callback callback;
+        void *data;
+};
+
+/**
+ * Called by sroc_diff for each changed key. section is NULL for items outside
+ * of a section. old_value is NULL for added keys and new_value is NULL for
+ * removed keys. Returning nonzero stops the diff
+ */
+typedef int (*sroc_diff_callback)(enum sroc_change change, const char *section,
+                                  const char *key,
+                                  const struct sroc_value *old_value,
+                                  const struct sroc_value *new_value,
+                                  void *data);
+
+/**
+ * Called by sroc_access_report for each item with the number of times it was
+ * read. section is NULL for items outside of a section. Returning nonzero
+ * stops the report
+ */
+typedef int (*sroc_access_callback)(const char *section, const char *key,
+                                    uint64_t count, void *data);
+
 struct sroc_root *sroc_parse_file(FILE *file);
 struct sroc_root *sroc_parse_string(const char *g);
+struct sroc_root *sroc_parse_buffer(const char *buffer, size_t length);
+int sroc_parse_limited(const char *buffer, size_t length,
+                       const struct sroc_limits *limits,
+                       struct sroc_root **dest);
+struct sroc_root *sroc_reparse(struct sroc_root *old_root, const char *buffer,
+                               size_t length);
+
+// Parse count files in parallel, one result per path
+int sroc_parse_many(const char *const *paths, size_t count, size_t nthreads,
+                    struct sroc_parse_result *results);
+
+// Load a file on a background thread, for programs driven by an event loop
+int sroc_load_async(const char *path, const struct sroc_load_options *options,
+                    struct sroc_load_job **dest);
+int sroc_load_fd(const struct sroc_load_job *job);
+int sroc_load_poll(struct sroc_load_job *job, struct sroc_root **dest);
+void sroc_load_cancel(struct sroc_load_job *job);
+void sroc_load_release(struct sroc_load_job *job);
+
+// Create a root which reads through to base until it is changed
+int sroc_derive(struct sroc_root *base, struct sroc_root **dest);
 
 struct sroc_root *sroc_create_root(void);
 struct sroc_table *sroc_create_table(char *key);
+struct sroc_array *sroc_create_array(enum sroc_type type);
+struct sroc_value *sroc_create_value(enum sroc_type type);
+
+// Add or replace values, taking ownership of value or array on success
+int sroc_root_set_value(struct sroc_root *root, const char *key,
+                        struct sroc_value *value);
+int sroc_table_set_value(struct sroc_table *table, const char *key,
+                         struct sroc_value *value);
+int sroc_table_set_array(struct sroc_table *table, const char *key,
+                         struct sroc_array *array);
+int sroc_table_set_bool(struct sroc_table *table, const char *key, bool value);
+int sroc_table_set_number(struct sroc_table *table, const char *key,
+                          int64_t value);
+int sroc_table_set_string(struct sroc_table *table, const char *key,
+                          const char *value);
+int sroc_root_add_section(struct sroc_root *root, const char *name,
+                          struct sroc_table **dest);
+int sroc_array_push(struct sroc_array *array, struct sroc_value *value);
+
+// Compact a built root into the layout parsing produces
+int sroc_freeze(struct sroc_root *root);
 
 // Get a single section from the root table
-int sroc_get_section(const struct sroc_table *root, const char *section,
+int sroc_get_section(const struct sroc_root *root, const char *section,
                      struct sroc_table **dest);
-int sroc_read_array(const struct sroc_table *root, const char *section,
+int sroc_read_array(const struct sroc_root *root, const char *section,
                     const char *key, struct sroc_array **dest, size_t *length);
-int sroc_read_bool(const struct sroc_table *root, const char *section,
+int sroc_read_bool(const struct sroc_root *root, const char *section,
                    const char *key, bool *dest);
-int sroc_read_number(const struct sroc_table *root, const char *section,
+int sroc_read_number(const struct sroc_root *root, const char *section,
                      const char *key, int64_t *dest);
-int sroc_read_string(const struct sroc_table *root, const char *section,
-                     const char *key, char **dest);
+// Strings may be shared with equal keys and strings of the root, so the one
+// read must not be changed
+int sroc_read_string(const struct sroc_root *root, const char *section,
+                     const char *key, const char **dest);
+int sroc_read_object(const struct sroc_root *root, const char *section,
+                     const char *key, struct sroc_object **dest);
+
+// Read a value by keys hashed beforehand
+uint64_t sroc_hash_key(const char *name, size_t length);
+int sroc_intern_key(const struct sroc_root *root, const char *name,
+                    struct sroc_key *dest);
+int sroc_read_value(const struct sroc_root *root,
+                    const struct sroc_key *section, const struct sroc_key *key,
+                    const struct sroc_value **dest);
+
+// Get a single field of an object
+int sroc_object_get(const struct sroc_object *object, const char *key,
+                    const struct sroc_value **dest);
+
+// Iterate over sections or keys starting with prefix in sorted order
+void sroc_iter_sections_prefix(const struct sroc_root *root,
+                               const char *prefix,
+                               struct sroc_section_cursor *cursor);
+struct sroc_table *sroc_next_section(struct sroc_section_cursor *cursor);
+void sroc_iter_keys_prefix(const struct sroc_table *table, const char *prefix,
+                           struct sroc_key_cursor *cursor);
+struct sroc_item *sroc_next_key(struct sroc_key_cursor *cursor);
+
+// Iterate over the fields of an object in file order
+void sroc_iter_fields(const struct sroc_object *object,
+                      struct sroc_field_cursor *cursor);
+const struct sroc_field *sroc_next_field(struct sroc_field_cursor *cursor);
+
+void sroc_init_buffer_sink(struct sroc_sink *sink);
+void sroc_init_file_sink(struct sroc_sink *sink, FILE *file);
+void sroc_init_fd_sink(struct sroc_sink *sink, int fd);
+void sroc_release_sink(struct sroc_sink *sink);
+
+// Write the canonical text form of root into sink
+int sroc_emit(const struct sroc_root *root, struct sroc_sink *sink);
+
+// Report every key which differs between two roots
+int sroc_diff(const struct sroc_root *old_root,
+              const struct sroc_root *new_root, sroc_diff_callback callback,
+              void *data);
+
+// Count the reads of every key, when built with SROC_WITH_ACCESS_TRACKING
+int sroc_track_access(struct sroc_root *root);
+int sroc_access_report(const struct sroc_root *root,
+                       sroc_access_callback callback, void *data);
 
 void sroc_destroy_root(struct sroc_root *root);
 void sroc_destroy_array(struct sroc_array *array);
 void sroc_destroy_item(struct sroc_item *item);
 void sroc_destroy_value(struct sroc_value *value);
+void sroc_destroy_object(struct sroc_object *object);
 void sroc_destroy_table(struct sroc_table *table);
+
+#if defined(__cplusplus)
+}
+#endif
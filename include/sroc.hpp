@@ -0,0 +1,338 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "sroc.h"
+
+// Literal keys must be hashed by the compiler, not at run time, wherever the
+// standard allows to insist on it
+#if defined(__cpp_consteval)
+#define SROC_CONSTEVAL consteval
+#else
+#define SROC_CONSTEVAL constexpr
+#endif
+
+namespace sroc {
+
+namespace detail {
+
+// The constants of hash_bytes in src/hash.c, which this has to match
+constexpr std::uint64_t hash_seed = 0x5ca1ab1e0ddba11ULL;
+constexpr std::uint64_t hash_multiplier = 0xc6a4a7935bd1e995ULL;
+constexpr int hash_shift = 47;
+
+/**
+ * Little endian load of count bytes of name starting at offset
+ */
+constexpr std::uint64_t load_le(std::string_view name, std::size_t offset,
+                                std::size_t count) noexcept
+{
+        std::uint64_t value = 0;
+
+        for (std::size_t i = 0; i < count; ++i) {
+                value |= static_cast<std::uint64_t>(
+                                 static_cast<unsigned char>(name[offset + i]))
+                         << (8 * i);
+        }
+
+        return value;
+}
+
+/**
+ * MurmurHash64A exactly as hash_bytes computes it, usable in constant
+ * expressions
+ */
+constexpr std::uint64_t hash_bytes(std::string_view name) noexcept
+{
+        std::size_t length = name.size();
+        std::size_t offset = 0;
+        std::uint64_t hash = hash_seed ^ (length * hash_multiplier);
+
+        while (length - offset >= 8) {
+                std::uint64_t block = load_le(name, offset, 8);
+
+                block *= hash_multiplier;
+                block ^= block >> hash_shift;
+                block *= hash_multiplier;
+
+                hash ^= block;
+                hash *= hash_multiplier;
+                offset += 8;
+        }
+
+        if (length > offset) {
+                hash ^= load_le(name, offset, length - offset);
+                hash *= hash_multiplier;
+        }
+
+        hash ^= hash >> hash_shift;
+        hash *= hash_multiplier;
+        hash ^= hash >> hash_shift;
+
+        return hash;
+}
+
+/**
+ * Converts value into dest when it holds a T. Returns 0 or SROC_ERRTYPE
+ */
+template <typename T>
+int convert(const sroc_value *value, T &dest) noexcept
+{
+        if constexpr (std::is_same_v<T, bool>) {
+                if (value->type != SROC_BOOL) {
+                        return SROC_ERRTYPE;
+                }
+
+                dest = value->boolean;
+        } else if constexpr (std::is_same_v<T, std::int64_t>) {
+                if (value->type != SROC_NUMBER) {
+                        return SROC_ERRTYPE;
+                }
+
+                dest = value->number;
+        } else if constexpr (std::is_same_v<T, std::string_view>) {
+                if (value->type != SROC_STRING) {
+                        return SROC_ERRTYPE;
+                }
+
+                dest = std::string_view(value->string);
+        } else if constexpr (std::is_same_v<T, const sroc_array *>) {
+                if (value->type != SROC_ARRAY) {
+                        return SROC_ERRTYPE;
+                }
+
+                dest = value->array;
+        } else if constexpr (std::is_same_v<T, const sroc_object *>) {
+                if (value->type != SROC_OBJECT) {
+                        return SROC_ERRTYPE;
+                }
+
+                dest = value->object;
+        } else {
+                static_assert(!std::is_same_v<T, T>,
+                              "sroc values are read as bool, std::int64_t, "
+                              "std::string_view, const sroc_array * or "
+                              "const sroc_object *");
+        }
+
+        return 0;
+}
+
+/**
+ * A name along with its hash. Tag keeps section names and key names apart so
+ * they cannot be passed in the wrong order
+ */
+template <typename Tag>
+class basic_key {
+public:
+        /**
+         * Hashes a null terminated name, at compile time when name is a
+         * constant
+         */
+        constexpr explicit basic_key(const char *name) noexcept
+                : value_{name, hash_bytes(std::string_view(name))}
+        {
+        }
+
+        constexpr std::string_view name() const noexcept
+        {
+                return value_.name;
+        }
+
+        constexpr std::uint64_t hash() const noexcept
+        {
+                return value_.hash;
+        }
+
+        constexpr const sroc_key *get() const noexcept
+        {
+                return &value_;
+        }
+
+private:
+        sroc_key value_;
+};
+
+struct section_tag {};
+struct key_tag {};
+
+} // namespace detail
+
+// A section name and a key name, hashed once
+using section = detail::basic_key<detail::section_tag>;
+using key = detail::basic_key<detail::key_tag>;
+
+/**
+ * Owns a sroc_root and destroys it with sroc_destroy_root. A root can be
+ * moved but not copied, so it is destroyed exactly once.
+ *
+ * Values are read with keys hashed beforehand, which for the _sec and _key
+ * literals happens at compile time, so a read costs the lookups alone.
+ * Strings are returned as std::string_view into the tree and stay valid as
+ * long as the root does
+ */
+class root {
+public:
+        root() noexcept = default;
+
+        explicit root(sroc_root *handle) noexcept : handle_(handle)
+        {
+        }
+
+        root(const root &) = delete;
+        root &operator=(const root &) = delete;
+
+        root(root &&other) noexcept : handle_(other.release())
+        {
+        }
+
+        root &operator=(root &&other) noexcept
+        {
+                if (this != &other) {
+                        sroc_destroy_root(handle_);
+                        handle_ = other.release();
+                }
+
+                return *this;
+        }
+
+        ~root()
+        {
+                sroc_destroy_root(handle_);
+        }
+
+        /**
+         * Parses text with sroc_parse_limited. On failure the root is empty
+         * and error, when given, is set to the negative sroc_error
+         */
+        static root parse(std::string_view text,
+                          const sroc_limits *limits = nullptr,
+                          int *error = nullptr) noexcept
+        {
+                sroc_root *handle = nullptr;
+                int result = sroc_parse_limited(
+                        text.data(), text.size(), limits, &handle);
+
+                if (error != nullptr) {
+                        *error = result;
+                }
+
+                return root(handle);
+        }
+
+        explicit operator bool() const noexcept
+        {
+                return handle_ != nullptr;
+        }
+
+        sroc_root *handle() const noexcept
+        {
+                return handle_;
+        }
+
+        /**
+         * Gives up ownership of the handle, which the caller must destroy
+         */
+        sroc_root *release() noexcept
+        {
+                return std::exchange(handle_, nullptr);
+        }
+
+        /**
+         * Reads name in section in into dest. Returns 0 or the negative
+         * sroc_error of the C API, SROC_ERRINVAL when the root is empty
+         */
+        template <typename T>
+        int read(const section &in, const key &name, T &dest) const noexcept
+        {
+                return read_value(in.get(), name, dest);
+        }
+
+        /**
+         * Reads name outside of any section into dest
+         */
+        template <typename T>
+        int read(const key &name, T &dest) const noexcept
+        {
+                return read_value(nullptr, name, dest);
+        }
+
+        /**
+         * Returns the value of name in section in, or nothing when it is
+         * missing or not a T
+         */
+        template <typename T>
+        std::optional<T> get(const section &in, const key &name) const
+                noexcept
+        {
+                T value{};
+
+                if (read(in, name, value) != 0) {
+                        return std::nullopt;
+                }
+
+                return value;
+        }
+
+        template <typename T>
+        std::optional<T> get(const key &name) const noexcept
+        {
+                T value{};
+
+                if (read(name, value) != 0) {
+                        return std::nullopt;
+                }
+
+                return value;
+        }
+
+private:
+        template <typename T>
+        int read_value(const sroc_key *in, const key &name, T &dest) const
+                noexcept
+        {
+                const sroc_value *value;
+
+                if (handle_ == nullptr) {
+                        return SROC_ERRINVAL;
+                }
+
+                int result = sroc_read_value(handle_, in, name.get(), &value);
+
+                if (result != 0) {
+                        return result;
+                }
+
+                return detail::convert(value, dest);
+        }
+
+        sroc_root *handle_ = nullptr;
+};
+
+namespace literals {
+
+// The length is ignored: lookups compare names up to the terminating null,
+// so the hash has to stop there too
+SROC_CONSTEVAL section operator""_sec(const char *name, std::size_t) noexcept
+{
+        return section(name);
+}
+
+SROC_CONSTEVAL key operator""_key(const char *name, std::size_t) noexcept
+{
+        return key(name);
+}
+
+} // namespace literals
+
+} // namespace sroc
@@ -0,0 +1,180 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "access.h"
+#include "sroc.h"
+
+#if defined(SROC_TRACK_ACCESS)
+#define CACHE_LINE 64
+#define COUNTERS_PER_LINE (CACHE_LINE / sizeof(uint64_t))
+
+_Thread_local size_t access_thread_shard;
+
+static atomic_size_t next_shard;
+
+/**
+ * Hands threads their shard round robin, in the order they first read, so up
+ * to ACCESS_SHARDS threads never share one
+ */
+size_t access_assign_shard(void)
+{
+        size_t shard = atomic_fetch_add_explicit(
+                &next_shard, 1, memory_order_relaxed);
+
+        access_thread_shard = (shard & (ACCESS_SHARDS - 1)) + 1;
+
+        return access_thread_shard;
+}
+
+static int create_access(const struct sroc_root *root,
+                         struct sroc_access **dest)
+{
+        struct sroc_access *access = malloc(sizeof(struct sroc_access));
+        size_t tables = root->sections_length + 1;
+        size_t *offsets = malloc((tables + 1) * sizeof(size_t));
+
+        if (access == NULL || offsets == NULL) {
+                goto free_and_err;
+        }
+
+        offsets[0] = 0;
+        offsets[1] = root->items_length;
+
+        for (size_t i = 0; i < root->sections_length; ++i) {
+                offsets[i + 2] = offsets[i + 1] + root->sections[i]->size;
+        }
+
+        // Each shard starts on its own cache line
+        size_t stride = (offsets[tables] / COUNTERS_PER_LINE + 1)
+                        * COUNTERS_PER_LINE;
+        size_t count = stride * ACCESS_SHARDS;
+
+        access->tables = tables;
+        access->offsets = offsets;
+        access->stride = stride;
+        access->counters = aligned_alloc(CACHE_LINE, count * sizeof(uint64_t));
+
+        if (access->counters == NULL) {
+                goto free_and_err;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+                atomic_init(&access->counters[i], 0);
+        }
+
+        *dest = access;
+
+        return 0;
+
+free_and_err:
+        free(offsets);
+        free(access);
+
+        return SROC_ERRNOMEM;
+}
+
+static uint64_t sum_shards(const struct sroc_access *access, size_t slot)
+{
+        uint64_t total = 0;
+
+        for (size_t shard = 0; shard < ACCESS_SHARDS; ++shard) {
+                total += atomic_load_explicit(
+                        &access->counters[shard * access->stride + slot],
+                        memory_order_relaxed);
+        }
+
+        return total;
+}
+#endif
+
+/**
+ * Starts counting how often sroc_read_* finds each item of root. Counting
+ * covers the items root holds now, so it should be started once loading and
+ * building are done and before root is shared between threads. A root made by
+ * sroc_reparse starts without counters. Reads through a derived root are
+ * counted for its base wherever they are served by the base.
+ *
+ * Returns 0, SROC_ERRNOMEM, or SROC_ERRINVAL when the library was built
+ * without SROC_WITH_ACCESS_TRACKING or root is derived
+ */
+int sroc_track_access(struct sroc_root *root)
+{
+#if defined(SROC_TRACK_ACCESS)
+        if (root->base != NULL) {
+                return SROC_ERRINVAL;
+        }
+
+        if (root->access != NULL) {
+                return 0;
+        }
+
+        return create_access(root, &root->access);
+#else
+        return SROC_ERRINVAL;
+#endif
+}
+
+/**
+ * Calls callback once for every counted item, in file order, with the number
+ * of times it was read so far. Keys reported with a count of 0 were never
+ * read. Reads still in flight on other threads may be missed.
+ *
+ * Returns 0 once every item has been reported, the nonzero value returned by
+ * callback if it stopped the report, or SROC_ERRINVAL when root is not being
+ * tracked
+ */
+int sroc_access_report(const struct sroc_root *root,
+                       sroc_access_callback callback, void *data)
+{
+#if defined(SROC_TRACK_ACCESS)
+        const struct sroc_access *access = root->access;
+
+        if (access == NULL) {
+                return SROC_ERRINVAL;
+        }
+
+        for (size_t table = 0; table < access->tables; ++table) {
+                const char *section = NULL;
+                struct sroc_item **items = root->items;
+                size_t start = access->offsets[table];
+                size_t length = access->offsets[table + 1] - start;
+
+                if (table > 0) {
+                        section = root->sections[table - 1]->key;
+                        items = root->sections[table - 1]->items;
+                }
+
+                for (size_t i = 0; i < length; ++i) {
+                        int result = callback(section,
+                                              items[i]->key,
+                                              sum_shards(access, start + i),
+                                              data);
+
+                        if (result != 0) {
+                                return result;
+                        }
+                }
+        }
+
+        return 0;
+#else
+        return SROC_ERRINVAL;
+#endif
+}
+
+void access_destroy(struct sroc_access *access)
+{
+#if defined(SROC_TRACK_ACCESS)
+        if (access == NULL) {
+                return;
+        }
+
+        free(access->counters);
+        free(access->offsets);
+#endif
+        free(access);
+}
@@ -0,0 +1,72 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sroc.h"
+
+#if defined(SROC_TRACK_ACCESS)
+#include <stdatomic.h>
+
+// Power of two so a thread's shard is picked with a mask
+#define ACCESS_SHARDS 16
+
+/**
+ * Read counters for every item a root held when sroc_track_access was called.
+ * Table 0 is the root items and table i + 1 is section i, whose counters start
+ * at offsets[i + 1]. Each shard holds a full set of counters and threads are
+ * spread over the shards, so threads reading the same hot key increment
+ * different cache lines
+ */
+struct sroc_access {
+        size_t tables;
+        size_t *offsets;
+        size_t stride;
+        _Atomic uint64_t *counters;
+};
+
+// Shard of the calling thread plus one, or 0 until it reads for the first time
+extern _Thread_local size_t access_thread_shard;
+
+size_t access_assign_shard(void);
+
+static inline size_t access_shard(void)
+{
+        size_t shard = access_thread_shard;
+
+        if (shard == 0) {
+                shard = access_assign_shard();
+        }
+
+        return shard - 1;
+}
+
+/**
+ * Counts a read of the item at position in table. Items and sections added
+ * after tracking started have no counter and are not counted
+ */
+static inline void access_count(struct sroc_access *access, size_t table,
+                                size_t position)
+{
+        if (table >= access->tables) {
+                return;
+        }
+
+        size_t start = access->offsets[table];
+
+        if (position >= access->offsets[table + 1] - start) {
+                return;
+        }
+
+        size_t slot = access_shard() * access->stride + start + position;
+
+        atomic_fetch_add_explicit(
+                &access->counters[slot], 1, memory_order_relaxed);
+}
+#endif
+
+void access_destroy(struct sroc_access *access);
@@ -0,0 +1,774 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "build.h"
+#include "derive.h"
+#include "hash.h"
+#include "index.h"
+#include "parse_helper.h"
+#include "sroc.h"
+#include "string_helper.h"
+
+/**
+ * The fields of a table or of the root which change when an item is added, so
+ * both can share one insert path. base_items and base_length describe the
+ * list this one was copied from by a derived root, whose items must be
+ * replaced rather than changed, and are NULL and 0 otherwise
+ */
+struct item_list {
+        struct sroc_item ***items;
+        size_t *length;
+        size_t *capacity;
+        size_t **index;
+        struct sroc_lookup *lookup;
+        uint64_t *hash;
+        struct sroc_item *const *base_items;
+        size_t base_length;
+};
+
+/**
+ * Grows a pointer array geometrically so that pushing n items costs O(n)
+ * reallocations in total rather than one per item
+ */
+void *build_grow_array(void *array, size_t *capacity, size_t element_size)
+{
+        size_t new_capacity = (*capacity == 0) ? 8 : *capacity * 2;
+        void *new_array = realloc(array, new_capacity * element_size);
+
+        if (new_array == NULL) {
+                errno = ENOMEM;
+
+                return NULL;
+        }
+
+        *capacity = new_capacity;
+
+        return new_array;
+}
+
+/**
+ * Makes room for one more entry in entries. The index is grown first so that
+ * it always has room for capacity positions, even when growing entries fails.
+ * Returns the possibly moved entries or NULL
+ */
+static void *reserve_entry(void *entries, size_t length, size_t *capacity,
+                           size_t element_size, size_t **index)
+{
+        if (length < *capacity) {
+                return entries;
+        }
+
+        if (*index != NULL) {
+                size_t index_capacity = *capacity;
+                size_t *grown = build_grow_array(
+                        *index, &index_capacity, sizeof(size_t));
+
+                if (grown == NULL) {
+                        return NULL;
+                }
+
+                *index = grown;
+        }
+
+        return build_grow_array(entries, capacity, element_size);
+}
+
+/**
+ * Adds the last of length entries to index and lookup. On failure neither is
+ * changed and the entry has to be removed again by the caller. Returns 0 or a
+ * negative sroc_error
+ */
+static int index_entry(const void *entries, size_t length, size_t capacity,
+                       index_key_getter key_at, size_t **index,
+                       struct sroc_lookup *lookup)
+{
+        if (*index != NULL) {
+                if (index_insert_lookup(entries, length, key_at, lookup)
+                    != 0) {
+                        return SROC_ERRNOMEM;
+                }
+
+                index_insert(entries, length, key_at, *index);
+
+                return 0;
+        }
+
+        if (index_build(entries, length, capacity, key_at, index) != 0) {
+                return SROC_ERRNOMEM;
+        }
+
+        if (index_insert_lookup(entries, length, key_at, lookup) != 0) {
+                free(*index);
+                *index = NULL;
+
+                return SROC_ERRNOMEM;
+        }
+
+        return 0;
+}
+
+/**
+ * Creates an item holding a copy of key and value. Returns the item or NULL
+ */
+static struct sroc_item *create_item(const char *key, struct sroc_value *value,
+                                     uint64_t value_hash)
+{
+        struct sroc_span span;
+        struct sroc_item *item = malloc(sizeof(struct sroc_item));
+
+        if (item == NULL) {
+                return NULL;
+        }
+
+        span_from_string(&span, key);
+        item->key = span_dup(&span);
+
+        if (item->key == NULL) {
+                free(item);
+
+                return NULL;
+        }
+
+        item->value = value;
+        item->value_hash = value_hash;
+        item->interned = false;
+
+        return item;
+}
+
+/**
+ * Stores value under key, replacing and destroying the value of the first
+ * item with an equal key or adding a new item at the end. An item shared with
+ * a base is replaced by a new one, leaving the base untouched
+ */
+static int set_item(struct item_list *list, const char *key,
+                    struct sroc_value *value)
+{
+        if (!parser_is_valid_key(key, false)) {
+                return SROC_ERRINVAL;
+        }
+
+        // The content of an array can still change after it is set, so its
+        // hash is left unknown until sroc_freeze
+        uint64_t value_hash
+                = (value->type == SROC_ARRAY) ? 0 : hash_value(value);
+        int64_t position = index_search(*list->items,
+                                        *list->index,
+                                        list->lookup,
+                                        *list->length,
+                                        index_item_key,
+                                        key);
+
+        if (position >= 0
+            && derive_shares_item(*list->items,
+                                  list->base_items,
+                                  list->base_length,
+                                  (size_t)position)) {
+                struct sroc_item *item = create_item(key, value, value_hash);
+
+                if (item == NULL) {
+                        return SROC_ERRNOMEM;
+                }
+
+                (*list->items)[position] = item;
+                *list->hash = 0;
+
+                return 0;
+        }
+
+        if (position >= 0) {
+                struct sroc_item *item = (*list->items)[position];
+
+                sroc_destroy_value(item->value);
+                item->value = value;
+                item->value_hash = value_hash;
+                *list->hash = 0;
+
+                return 0;
+        }
+
+        struct sroc_item *item = create_item(key, value, value_hash);
+
+        if (item == NULL) {
+                return SROC_ERRNOMEM;
+        }
+
+        struct sroc_item **items = reserve_entry(*list->items,
+                                                 *list->length,
+                                                 list->capacity,
+                                                 sizeof(struct sroc_item *),
+                                                 list->index);
+
+        if (items == NULL) {
+                free(item->key);
+                free(item);
+
+                return SROC_ERRNOMEM;
+        }
+
+        *list->items = items;
+        items[(*list->length)++] = item;
+
+        if (index_entry(items,
+                        *list->length,
+                        *list->capacity,
+                        index_item_key,
+                        list->index,
+                        list->lookup)
+            != 0) {
+                --*list->length;
+                free(item->key);
+                free(item);
+
+                return SROC_ERRNOMEM;
+        }
+
+        *list->hash = 0;
+
+        return 0;
+}
+
+static void init_root_list(struct sroc_root *root, struct item_list *list)
+{
+        list->items = &root->items;
+        list->length = &root->items_length;
+        list->capacity = &root->items_capacity;
+        list->index = &root->items_index;
+        list->lookup = &root->items_lookup;
+        list->hash = &root->items_hash;
+        list->base_items = NULL;
+        list->base_length = 0;
+
+        if (root->base != NULL) {
+                list->base_items = root->base->items;
+                list->base_length = root->base->items_length;
+        }
+}
+
+static void init_table_list(struct sroc_table *table, struct item_list *list)
+{
+        list->items = &table->items;
+        list->length = &table->size;
+        list->capacity = &table->capacity;
+        list->index = &table->index;
+        list->lookup = &table->lookup;
+        list->hash = &table->hash;
+        list->base_items = NULL;
+        list->base_length = 0;
+
+        if (table->base != NULL) {
+                list->base_items = table->base->items;
+                list->base_length = table->base->size;
+        }
+}
+
+/**
+ * Copies the pointers of length items into a new array with an index and
+ * lookup of its own, so the copy can grow without touching the original.
+ * Nothing is set on failure. Returns 0 or SROC_ERRNOMEM
+ */
+static int copy_items(struct sroc_item *const *items, size_t length,
+                      struct sroc_item ***dest, size_t **index,
+                      struct sroc_lookup *lookup)
+{
+        struct sroc_item **copy = NULL;
+        size_t *copy_index = NULL;
+        struct sroc_lookup copy_lookup;
+
+        index_init_lookup(&copy_lookup);
+
+        if (length > 0) {
+                copy = malloc(length * sizeof(struct sroc_item *));
+
+                if (copy == NULL) {
+                        return SROC_ERRNOMEM;
+                }
+
+                memcpy(copy, items, length * sizeof(struct sroc_item *));
+
+                if (index_build(copy,
+                                length,
+                                length,
+                                index_item_key,
+                                &copy_index)
+                            != 0
+                    || index_build_lookup(
+                               copy, length, index_item_key, &copy_lookup)
+                               != 0) {
+                        free(copy_index);
+                        free(copy);
+
+                        return SROC_ERRNOMEM;
+                }
+        }
+
+        *dest = copy;
+        *index = copy_index;
+        *lookup = copy_lookup;
+
+        return 0;
+}
+
+/**
+ * Gives a derived root a copy of the root items it shares with its base
+ */
+static int copy_root_items(struct sroc_root *root)
+{
+        const struct sroc_root *base = root->base;
+
+        if (copy_items(base->items,
+                       base->items_length,
+                       &root->items,
+                       &root->items_index,
+                       &root->items_lookup)
+            != 0) {
+                return SROC_ERRNOMEM;
+        }
+
+        root->items_capacity = base->items_length;
+
+        return 0;
+}
+
+/**
+ * Stores value under key outside of any section. On success the root owns
+ * value, on failure the caller still does. Returns 0 or a negative sroc_error
+ */
+int sroc_root_set_value(struct sroc_root *root, const char *key,
+                        struct sroc_value *value)
+{
+        struct item_list list;
+
+        if (derive_shares_root_items(root) && copy_root_items(root) != 0) {
+                return SROC_ERRNOMEM;
+        }
+
+        init_root_list(root, &list);
+
+        return set_item(&list, key, value);
+}
+
+/**
+ * Stores value under key in table, replacing the value of an existing item
+ * with that key. On success the table owns value, on failure the caller still
+ * does. Returns 0 or a negative sroc_error
+ */
+int sroc_table_set_value(struct sroc_table *table, const char *key,
+                         struct sroc_value *value)
+{
+        struct item_list list;
+
+        init_table_list(table, &list);
+
+        return set_item(&list, key, value);
+}
+
+/**
+ * Stores array under key in table. On success the table owns array, on
+ * failure the caller still does
+ */
+int sroc_table_set_array(struct sroc_table *table, const char *key,
+                         struct sroc_array *array)
+{
+        struct sroc_value *value = sroc_create_value(SROC_ARRAY);
+
+        if (value == NULL) {
+                return SROC_ERRNOMEM;
+        }
+
+        value->array = array;
+
+        int result = sroc_table_set_value(table, key, value);
+
+        if (result != 0) {
+                free(value);
+        }
+
+        return result;
+}
+
+int sroc_table_set_bool(struct sroc_table *table, const char *key, bool value)
+{
+        struct sroc_value *boolean = sroc_create_value(SROC_BOOL);
+
+        if (boolean == NULL) {
+                return SROC_ERRNOMEM;
+        }
+
+        boolean->boolean = value;
+
+        int result = sroc_table_set_value(table, key, boolean);
+
+        if (result != 0) {
+                sroc_destroy_value(boolean);
+        }
+
+        return result;
+}
+
+int sroc_table_set_number(struct sroc_table *table, const char *key,
+                          int64_t value)
+{
+        struct sroc_value *number = sroc_create_value(SROC_NUMBER);
+
+        if (number == NULL) {
+                return SROC_ERRNOMEM;
+        }
+
+        number->number = value;
+
+        int result = sroc_table_set_value(table, key, number);
+
+        if (result != 0) {
+                sroc_destroy_value(number);
+        }
+
+        return result;
+}
+
+/**
+ * Stores a copy of the string value under key in table
+ */
+int sroc_table_set_string(struct sroc_table *table, const char *key,
+                          const char *value)
+{
+        struct sroc_span span;
+        struct sroc_value *string = sroc_create_value(SROC_STRING);
+
+        if (string == NULL) {
+                return SROC_ERRNOMEM;
+        }
+
+        span_from_string(&span, value);
+        string->string = span_dup(&span);
+
+        if (string->string == NULL) {
+                free(string);
+
+                return SROC_ERRNOMEM;
+        }
+
+        int result = sroc_table_set_value(table, key, string);
+
+        if (result != 0) {
+                sroc_destroy_value(string);
+        }
+
+        return result;
+}
+
+/**
+ * Creates the copy of base a derived root changes in its place. The copy
+ * shares every item with base. Returns the copy or NULL
+ */
+static struct sroc_table *copy_section(const struct sroc_table *base,
+                                       char *key)
+{
+        struct sroc_table *table = sroc_create_table(key);
+
+        if (table == NULL) {
+                return NULL;
+        }
+
+        if (copy_items(base->items,
+                       base->size,
+                       &table->items,
+                       &table->index,
+                       &table->lookup)
+            != 0) {
+                free(table);
+
+                return NULL;
+        }
+
+        table->size = base->size;
+        table->capacity = base->size;
+        table->hash = base->hash;
+        table->base = base;
+
+        return table;
+}
+
+/**
+ * Finds the section called name, adding an empty one at the end if there is
+ * none. The section stays owned by root. A derived root gets its own copy of
+ * a section it only reads from its base. Returns 0 or a negative sroc_error
+ */
+int sroc_root_add_section(struct sroc_root *root, const char *name,
+                          struct sroc_table **dest)
+{
+        if (!parser_is_valid_key(name, true)) {
+                return SROC_ERRINVAL;
+        }
+
+        int64_t position = derive_find_own_section(root, name);
+
+        if (position >= 0) {
+                *dest = root->sections[position];
+
+                return 0;
+        }
+
+        int64_t base_position = -1;
+
+        if (root->base != NULL) {
+                base_position = derive_find_own_section(root->base, name);
+        }
+
+        struct sroc_span span;
+
+        span_from_string(&span, name);
+
+        char *key = span_dup(&span);
+
+        if (key == NULL) {
+                return SROC_ERRNOMEM;
+        }
+
+        struct sroc_table *table
+                = (base_position < 0)
+                          ? sroc_create_table(key)
+                          : copy_section(root->base->sections[base_position],
+                                         key);
+
+        if (table == NULL) {
+                free(key);
+
+                return SROC_ERRNOMEM;
+        }
+
+        struct sroc_table **sections
+                = reserve_entry(root->sections,
+                                root->sections_length,
+                                &root->sections_capacity,
+                                sizeof(struct sroc_table *),
+                                &root->sections_index);
+
+        if (sections == NULL) {
+                sroc_destroy_table(table);
+
+                return SROC_ERRNOMEM;
+        }
+
+        root->sections = sections;
+        sections[root->sections_length++] = table;
+
+        if (index_entry(sections,
+                        root->sections_length,
+                        root->sections_capacity,
+                        index_table_key,
+                        &root->sections_index,
+                        &root->sections_lookup)
+            != 0) {
+                --root->sections_length;
+                sroc_destroy_table(table);
+
+                return SROC_ERRNOMEM;
+        }
+
+        *dest = table;
+
+        return 0;
+}
+
+/**
+ * Appends value to array, which takes ownership of it on success. The first
+ * value pushed onto an empty array sets its type and every later value has
+ * to match it. Frozen arrays are rejected with SROC_ERRINVAL, since the hash
+ * of the item holding them would go stale. Returns 0 or a negative sroc_error
+ */
+int sroc_array_push(struct sroc_array *array, struct sroc_value *value)
+{
+        if (array->frozen) {
+                return SROC_ERRINVAL;
+        }
+
+        if (array->length > 0 && value->type != array->type) {
+                return SROC_ERRTYPE;
+        }
+
+        if (array->length == array->capacity) {
+                struct sroc_value **items
+                        = build_grow_array(array->items,
+                                           &array->capacity,
+                                           sizeof(struct sroc_value *));
+
+                if (items == NULL) {
+                        return SROC_ERRNOMEM;
+                }
+
+                array->items = items;
+        }
+
+        array->type = value->type;
+        array->items[array->length++] = value;
+
+        return 0;
+}
+
+/**
+ * Gives back the unused end of a pointer array. Failing to shrink only wastes
+ * memory, so the old array is kept when realloc fails
+ */
+static void *shrink_array(void *array, size_t length, size_t *capacity,
+                          size_t element_size)
+{
+        if (length == *capacity || length == 0) {
+                return array;
+        }
+
+        void *shrunk = realloc(array, length * element_size);
+
+        if (shrunk == NULL) {
+                return array;
+        }
+
+        *capacity = length;
+
+        return shrunk;
+}
+
+static void freeze_value(struct sroc_value *value)
+{
+        if (value->type != SROC_ARRAY) {
+                return;
+        }
+
+        struct sroc_array *array = value->array;
+
+        for (size_t i = 0; i < array->length; ++i) {
+                freeze_value(array->items[i]);
+        }
+
+        array->items = shrink_array(array->items,
+                                    array->length,
+                                    &array->capacity,
+                                    sizeof(struct sroc_value *));
+        array->frozen = true;
+}
+
+/**
+ * Replaces index and lookup with ones built for the first length entries at
+ * their smallest size. The new ones are built before the old ones are freed,
+ * so on failure index and lookup are left as they were and still usable.
+ * Returns 0 or SROC_ERRNOMEM
+ */
+static int rebuild_index(const void *entries, size_t length, size_t capacity,
+                         index_key_getter key_at, size_t **index,
+                         struct sroc_lookup *lookup)
+{
+        size_t *new_index;
+        struct sroc_lookup new_lookup;
+
+        if (index_build(entries, length, capacity, key_at, &new_index) != 0) {
+                return SROC_ERRNOMEM;
+        }
+
+        if (index_build_lookup(entries, length, key_at, &new_lookup) != 0) {
+                free(new_index);
+
+                return SROC_ERRNOMEM;
+        }
+
+        free(*index);
+        index_destroy_lookup(lookup);
+        *index = new_index;
+        *lookup = new_lookup;
+
+        return 0;
+}
+
+/**
+ * Compacts one list of items and rebuilds its index and lookup at the size a
+ * parse of the same items would give them. The fingerprint of the list is
+ * dropped, as the items may no longer match the text it was taken from
+ */
+static int freeze_items(struct item_list *list)
+{
+        size_t length = *list->length;
+
+        for (size_t i = 0; i < length; ++i) {
+                struct sroc_item *item = (*list->items)[i];
+
+                // Items shared with a base are already frozen with it
+                if (derive_shares_item(*list->items,
+                                       list->base_items,
+                                       list->base_length,
+                                       i)) {
+                        continue;
+                }
+
+                freeze_value(item->value);
+                item->value_hash = hash_value(item->value);
+        }
+
+        *list->hash = 0;
+
+        *list->items = shrink_array(*list->items,
+                                    length,
+                                    list->capacity,
+                                    sizeof(struct sroc_item *));
+
+        return rebuild_index(*list->items,
+                             length,
+                             *list->capacity,
+                             index_item_key,
+                             list->index,
+                             list->lookup);
+}
+
+/**
+ * Finishes building root: every array and item list is shrunk to its length,
+ * indexes and lookups are rebuilt at their smallest size and the value hashes
+ * used by sroc_diff are recomputed, since arrays may have changed after they
+ * were set. Arrays cannot be pushed onto afterwards, but the root can still
+ * be changed, which grows it again.
+ *
+ * Roots generated by sroc-compile live in static storage and must never be
+ * passed to this or any of the set functions. A root which is the base of
+ * derived roots cannot be frozen. Running out of memory leaves the root
+ * readable and changeable, only partly compacted. Returns 0, SROC_ERRNOMEM or
+ * SROC_ERRINVAL
+ */
+int sroc_freeze(struct sroc_root *root)
+{
+        struct item_list list;
+
+        if (__atomic_load_n(&root->references, __ATOMIC_RELAXED) != 0) {
+                return SROC_ERRINVAL;
+        }
+
+        init_root_list(root, &list);
+        root->items_hash = 0;
+
+        if (!derive_shares_root_items(root) && freeze_items(&list) != 0) {
+                return SROC_ERRNOMEM;
+        }
+
+        for (size_t i = 0; i < root->sections_length; ++i) {
+                init_table_list(root->sections[i], &list);
+
+                if (freeze_items(&list) != 0) {
+                        return SROC_ERRNOMEM;
+                }
+        }
+
+        root->sections = shrink_array(root->sections,
+                                      root->sections_length,
+                                      &root->sections_capacity,
+                                      sizeof(struct sroc_table *));
+
+        return rebuild_index(root->sections,
+                             root->sections_length,
+                             root->sections_capacity,
+                             index_table_key,
+                             &root->sections_index,
+                             &root->sections_lookup);
+}
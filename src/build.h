@@ -0,0 +1,9 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#pragma once
+
+#include <stddef.h>
+
+void *build_grow_array(void *array, size_t *capacity, size_t element_size);
@@ -0,0 +1,191 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "derive.h"
+#include "index.h"
+#include "sroc.h"
+
+/**
+ * Creates a root which reads as a copy of base but costs only what is changed
+ * in it. Sections are read from the derived root when it has its own copy
+ * and from base otherwise, which is one extra lookup at most. The items
+ * outside of sections are shared with base as a whole.
+ *
+ * Changes are copy on write per table. The first sroc_root_add_section or
+ * sroc_root_set_value touching a section or the root items of the derived
+ * root copies that table, sharing its items with base, and later changes
+ * replace items rather than the values they share with base. Memory of a
+ * derived root is therefore one table per changed section plus the new items.
+ *
+ * base stays alive as long as any root derived from it, whatever order they
+ * are destroyed in, and must not be changed while it has derived roots.
+ * Tables of base reached through a derived root by sroc_get_section or a
+ * section cursor belong to base and must not be changed either. Deriving
+ * from the same base on several threads at once is safe.
+ *
+ * Roots generated by sroc-compile are never freed, so they can be a base
+ * without being counted, for example to layer per tenant overrides over
+ * defaults built into the program.
+ *
+ * Returns 0 and sets dest, SROC_ERRNOMEM, or SROC_ERRINVAL when base was
+ * itself derived
+ */
+int sroc_derive(struct sroc_root *base, struct sroc_root **dest)
+{
+        if (base->base != NULL) {
+                return SROC_ERRINVAL;
+        }
+
+        struct sroc_root *root = sroc_create_root();
+
+        if (root == NULL) {
+                return SROC_ERRNOMEM;
+        }
+
+        root->items_length = base->items_length;
+        root->items_capacity = base->items_length;
+        root->items = base->items;
+        root->items_index = base->items_index;
+        root->items_lookup = base->items_lookup;
+        root->items_hash = base->items_hash;
+        root->base = base;
+
+        if (base->references != SROC_STATIC_ROOT) {
+                __atomic_fetch_add(&base->references, 1, __ATOMIC_RELAXED);
+        }
+
+        *dest = root;
+
+        return 0;
+}
+
+/**
+ * Drops one reference to root. Returns true when it was the last one and the
+ * root has to be freed, which a root generated by sroc-compile never is
+ */
+bool derive_release(struct sroc_root *root)
+{
+        if (root->references == SROC_STATIC_ROOT) {
+                return false;
+        }
+
+        return __atomic_fetch_sub(&root->references, 1, __ATOMIC_ACQ_REL)
+               == 0;
+}
+
+/**
+ * Returns whether the root items of root are still those of its base
+ */
+bool derive_shares_root_items(const struct sroc_root *root)
+{
+        return root->base != NULL && root->items == root->base->items;
+}
+
+/**
+ * Returns whether the item at position of a copied item list is still the
+ * one of the list it was copied from
+ */
+bool derive_shares_item(struct sroc_item *const *items,
+                        struct sroc_item *const *base_items,
+                        size_t base_length, size_t position)
+{
+        return position < base_length
+               && items[position] == base_items[position];
+}
+
+/**
+ * Returns the position of section name among the sections root holds itself,
+ * or -1
+ */
+int64_t derive_find_own_section(const struct sroc_root *root,
+                                const char *name)
+{
+        return index_search(root->sections,
+                            root->sections_index,
+                            &root->sections_lookup,
+                            root->sections_length,
+                            index_table_key,
+                            name);
+}
+
+static int64_t find_hashed_section(const struct sroc_root *root,
+                                   const struct sroc_key *name)
+{
+        return index_search_hashed(root->sections,
+                                   root->sections_index,
+                                   &root->sections_lookup,
+                                   root->sections_length,
+                                   index_table_key,
+                                   name->name,
+                                   name->hash);
+}
+
+/**
+ * Finds section name in root and then in its base, if it has one. owner and
+ * position are set to the root holding the section and its position there.
+ * Returns the section or NULL
+ */
+struct sroc_table *derive_find_section(const struct sroc_root *root,
+                                       const struct sroc_key *name,
+                                       const struct sroc_root **owner,
+                                       int64_t *position)
+{
+        *owner = root;
+        *position = find_hashed_section(root, name);
+
+        if (*position < 0 && root->base != NULL) {
+                *owner = root->base;
+                *position = find_hashed_section(root->base, name);
+        }
+
+        if (*position < 0) {
+                return NULL;
+        }
+
+        return (*owner)->sections[*position];
+}
+
+/**
+ * Lists the sections a derived root reads as: those of its base in their
+ * order, each replaced by the copy of the root where it has one, followed by
+ * the sections only the root has. Returns a new array the caller frees, or
+ * NULL
+ */
+struct sroc_table **derive_list_sections(const struct sroc_root *root,
+                                         size_t *length)
+{
+        const struct sroc_root *base = root->base;
+        size_t capacity = base->sections_length + root->sections_length;
+        struct sroc_table **sections
+                = malloc(((capacity > 0) ? capacity : 1)
+                         * sizeof(struct sroc_table *));
+
+        if (sections == NULL) {
+                return NULL;
+        }
+
+        *length = 0;
+
+        for (size_t i = 0; i < base->sections_length; ++i) {
+                struct sroc_table *table = base->sections[i];
+                int64_t position = derive_find_own_section(root, table->key);
+
+                sections[(*length)++]
+                        = (position < 0) ? table : root->sections[position];
+        }
+
+        for (size_t i = 0; i < root->sections_length; ++i) {
+                struct sroc_table *table = root->sections[i];
+
+                if (derive_find_own_section(base, table->key) < 0) {
+                        sections[(*length)++] = table;
+                }
+        }
+
+        return sections;
+}
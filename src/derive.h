@@ -0,0 +1,25 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sroc.h"
+
+int64_t derive_find_own_section(const struct sroc_root *root,
+                                const char *name);
+struct sroc_table *derive_find_section(const struct sroc_root *root,
+                                       const struct sroc_key *name,
+                                       const struct sroc_root **owner,
+                                       int64_t *position);
+struct sroc_table **derive_list_sections(const struct sroc_root *root,
+                                         size_t *length);
+bool derive_shares_item(struct sroc_item *const *items,
+                        struct sroc_item *const *base_items,
+                        size_t base_length, size_t position);
+bool derive_shares_root_items(const struct sroc_root *root);
+bool derive_release(struct sroc_root *root);
@@ -0,0 +1,488 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "derive.h"
+#include "hash.h"
+#include "index.h"
+#include "object.h"
+#include "sroc.h"
+
+#define EMPTY_SLOT SIZE_MAX
+
+/**
+ * Temporary open addressed index from key to position, used once the old and
+ * new entries stop lining up positionally
+ */
+struct key_index {
+        size_t mask;
+        size_t *slots;
+        bool *claimed;
+        const void *entries;
+        index_key_getter key_at;
+};
+
+/**
+ * Returns the first slot to probe for key, placed like the lookups of tables
+ */
+static size_t key_slot(const struct key_index *index, const char *key)
+{
+        return (size_t)hash_keyed(key, strlen(key)) & index->mask;
+}
+
+/**
+ * Indexes entries [start, length). Entries before start have already been
+ * matched positionally
+ */
+static int init_key_index(struct key_index *index, const void *entries,
+                          index_key_getter key_at, size_t start,
+                          size_t length)
+{
+        size_t capacity = 8;
+
+        while (capacity < (length - start) * 2) {
+                capacity *= 2;
+        }
+
+        index->mask = capacity - 1;
+        index->slots = malloc(capacity * sizeof(size_t));
+        index->claimed = calloc(length + 1, sizeof(bool));
+        index->entries = entries;
+        index->key_at = key_at;
+
+        if (index->slots == NULL || index->claimed == NULL) {
+                free(index->slots);
+                free(index->claimed);
+
+                return SROC_ERRNOMEM;
+        }
+
+        for (size_t i = 0; i < capacity; ++i) {
+                index->slots[i] = EMPTY_SLOT;
+        }
+
+        for (size_t i = start; i < length; ++i) {
+                size_t slot = key_slot(index, key_at(entries, i));
+
+                while (index->slots[slot] != EMPTY_SLOT) {
+                        slot = (slot + 1) & index->mask;
+                }
+
+                index->slots[slot] = i;
+        }
+
+        return 0;
+}
+
+static void destroy_key_index(struct key_index *index)
+{
+        free(index->slots);
+        free(index->claimed);
+}
+
+/**
+ * Claims the first unclaimed entry with the given key. Returns EMPTY_SLOT if
+ * there is none
+ */
+static size_t claim_key(struct key_index *index, const char *key)
+{
+        size_t slot = key_slot(index, key);
+
+        while (index->slots[slot] != EMPTY_SLOT) {
+                size_t position = index->slots[slot];
+
+                if (!index->claimed[position]
+                    && strcmp(index->key_at(index->entries, position), key)
+                               == 0) {
+                        index->claimed[position] = true;
+
+                        return position;
+                }
+
+                slot = (slot + 1) & index->mask;
+        }
+
+        return EMPTY_SLOT;
+}
+
+static bool values_equal(const struct sroc_value *a,
+                         const struct sroc_value *b);
+
+static bool arrays_equal(const struct sroc_array *a,
+                         const struct sroc_array *b)
+{
+        if (a->length != b->length) {
+                return false;
+        }
+
+        if (a->length > 0 && a->type == SROC_NUMBER && b->type == SROC_NUMBER) {
+                // Numeric arrays skip the per value dispatch
+                for (size_t i = 0; i < a->length; ++i) {
+                        if (a->items[i]->number != b->items[i]->number) {
+                                return false;
+                        }
+                }
+
+                return true;
+        }
+
+        for (size_t i = 0; i < a->length; ++i) {
+                if (!values_equal(a->items[i], b->items[i])) {
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+/**
+ * Objects are equal when they hold the same keys with equal values, in any
+ * order. Keys within an object are unique so matching each field of a is
+ * enough
+ */
+static bool objects_equal(const struct sroc_object *a,
+                          const struct sroc_object *b)
+{
+        if (a->length != b->length) {
+                return false;
+        }
+
+        for (size_t i = 0; i < a->length; ++i) {
+                int64_t position
+                        = object_find(b, a->fields[i].key, a->hashes[i]);
+
+                if (position < 0
+                    || !values_equal(&a->fields[i].value,
+                                     &b->fields[position].value)) {
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+static bool values_equal(const struct sroc_value *a,
+                         const struct sroc_value *b)
+{
+        if (a->type != b->type) {
+                return false;
+        }
+
+        switch (a->type) {
+        case SROC_ARRAY:
+                return arrays_equal(a->array, b->array);
+        case SROC_BOOL:
+                return a->boolean == b->boolean;
+        case SROC_NUMBER:
+                return a->number == b->number;
+        case SROC_STRING:
+                return strcmp(a->string, b->string) == 0;
+        case SROC_OBJECT:
+                return objects_equal(a->object, b->object);
+        }
+
+        return false;
+}
+
+/**
+ * Items with different value hashes are told apart without walking their
+ * values. Values can be written to share a hash, so equal hashes are only a
+ * hint and the values are compared then, as they are for items built without
+ * a hash
+ */
+static bool items_equal(const struct sroc_item *a, const struct sroc_item *b)
+{
+        if (a->value == b->value) {
+                return true;
+        }
+
+        if (a->value_hash != 0 && b->value_hash != 0
+            && a->value_hash != b->value_hash) {
+                return false;
+        }
+
+        return values_equal(a->value, b->value);
+}
+
+static int report_all(enum sroc_change change, const char *section,
+                      struct sroc_item **items, size_t length,
+                      sroc_diff_callback callback, void *data)
+{
+        for (size_t i = 0; i < length; ++i) {
+                const struct sroc_value *value = items[i]->value;
+                int result = callback(change,
+                                      section,
+                                      items[i]->key,
+                                      (change == SROC_REMOVED) ? value : NULL,
+                                      (change == SROC_ADDED) ? value : NULL,
+                                      data);
+
+                if (result != 0) {
+                        return result;
+                }
+        }
+
+        return 0;
+}
+
+static int diff_items(const char *section, struct sroc_item **old_items,
+                      size_t old_length, struct sroc_item **new_items,
+                      size_t new_length, sroc_diff_callback callback,
+                      void *data)
+{
+        size_t matched = 0;
+        int result;
+
+        // Most reloads keep keys in the same order, which needs no index
+        while (matched < old_length && matched < new_length
+               && strcmp(old_items[matched]->key, new_items[matched]->key)
+                          == 0) {
+                if (!items_equal(old_items[matched], new_items[matched])) {
+                        result = callback(SROC_MODIFIED,
+                                          section,
+                                          new_items[matched]->key,
+                                          old_items[matched]->value,
+                                          new_items[matched]->value,
+                                          data);
+
+                        if (result != 0) {
+                                return result;
+                        }
+                }
+
+                ++matched;
+        }
+
+        if (matched == old_length) {
+                return report_all(SROC_ADDED,
+                                  section,
+                                  new_items + matched,
+                                  new_length - matched,
+                                  callback,
+                                  data);
+        }
+
+        if (matched == new_length) {
+                return report_all(SROC_REMOVED,
+                                  section,
+                                  old_items + matched,
+                                  old_length - matched,
+                                  callback,
+                                  data);
+        }
+
+        struct key_index index;
+
+        result = init_key_index(
+                &index, old_items, index_item_key, matched, old_length);
+
+        if (result != 0) {
+                return result;
+        }
+
+        for (size_t i = matched; i < new_length && result == 0; ++i) {
+                const struct sroc_item *item = new_items[i];
+                size_t position = claim_key(&index, item->key);
+
+                if (position == EMPTY_SLOT) {
+                        result = callback(SROC_ADDED,
+                                          section,
+                                          item->key,
+                                          NULL,
+                                          item->value,
+                                          data);
+                } else if (!items_equal(old_items[position], item)) {
+                        result = callback(SROC_MODIFIED,
+                                          section,
+                                          item->key,
+                                          old_items[position]->value,
+                                          item->value,
+                                          data);
+                }
+        }
+
+        for (size_t i = matched; i < old_length && result == 0; ++i) {
+                if (!index.claimed[i]) {
+                        result = callback(SROC_REMOVED,
+                                          section,
+                                          old_items[i]->key,
+                                          old_items[i]->value,
+                                          NULL,
+                                          data);
+                }
+        }
+
+        destroy_key_index(&index);
+
+        return result;
+}
+
+static int diff_tables(const struct sroc_table *old_table,
+                       const struct sroc_table *new_table,
+                       sroc_diff_callback callback, void *data)
+{
+        // Sections shared between a derived root and its base are skipped
+        // outright. Any other pair is compared item by item even when their
+        // source text hashed alike, which finds nothing for equal sections
+        if (old_table == new_table) {
+                return 0;
+        }
+
+        return diff_items(new_table->key,
+                          old_table->items,
+                          old_table->size,
+                          new_table->items,
+                          new_table->size,
+                          callback,
+                          data);
+}
+
+/**
+ * Diffs two lists of sections, matching them by name
+ */
+static int diff_sections(struct sroc_table *const *old_sections,
+                         size_t old_length,
+                         struct sroc_table *const *new_sections,
+                         size_t new_length, sroc_diff_callback callback,
+                         void *data)
+{
+        size_t matched = 0;
+        int result;
+
+        while (matched < old_length && matched < new_length
+               && strcmp(old_sections[matched]->key,
+                         new_sections[matched]->key)
+                          == 0) {
+                result = diff_tables(old_sections[matched],
+                                     new_sections[matched],
+                                     callback,
+                                     data);
+
+                if (result != 0) {
+                        return result;
+                }
+
+                ++matched;
+        }
+
+        if (matched == old_length && matched == new_length) {
+                return 0;
+        }
+
+        struct key_index index;
+
+        result = init_key_index(
+                &index, old_sections, index_table_key, matched, old_length);
+
+        if (result != 0) {
+                return result;
+        }
+
+        for (size_t i = matched; i < new_length && result == 0; ++i) {
+                const struct sroc_table *table = new_sections[i];
+                size_t position = claim_key(&index, table->key);
+
+                if (position == EMPTY_SLOT) {
+                        result = report_all(SROC_ADDED,
+                                            table->key,
+                                            table->items,
+                                            table->size,
+                                            callback,
+                                            data);
+                } else {
+                        result = diff_tables(
+                                old_sections[position], table, callback, data);
+                }
+        }
+
+        for (size_t i = matched; i < old_length && result == 0; ++i) {
+                if (!index.claimed[i]) {
+                        result = report_all(SROC_REMOVED,
+                                            old_sections[i]->key,
+                                            old_sections[i]->items,
+                                            old_sections[i]->size,
+                                            callback,
+                                            data);
+                }
+        }
+
+        destroy_key_index(&index);
+
+        return result;
+}
+
+/**
+ * Calls callback for every (section, key) pair which was added, removed or
+ * modified between old_root and new_root. Sections are matched by name and
+ * items by key within their section.
+ *
+ * Returns 0 once every change has been reported, the nonzero value returned
+ * by callback if it stopped the diff, or a negative sroc_error
+ */
+int sroc_diff(const struct sroc_root *old_root,
+              const struct sroc_root *new_root, sroc_diff_callback callback,
+              void *data)
+{
+        int result = 0;
+
+        if (old_root->items != new_root->items
+            || old_root->items_length != new_root->items_length) {
+                result = diff_items(NULL,
+                                    old_root->items,
+                                    old_root->items_length,
+                                    new_root->items,
+                                    new_root->items_length,
+                                    callback,
+                                    data);
+
+                if (result != 0) {
+                        return result;
+                }
+        }
+
+        struct sroc_table **old_sections = old_root->sections;
+        struct sroc_table **new_sections = new_root->sections;
+        size_t old_length = old_root->sections_length;
+        size_t new_length = new_root->sections_length;
+
+        // Derived roots are compared as the sections they read as
+        if (old_root->base != NULL) {
+                old_sections = derive_list_sections(old_root, &old_length);
+
+                if (old_sections == NULL) {
+                        return SROC_ERRNOMEM;
+                }
+        }
+
+        if (new_root->base != NULL) {
+                new_sections = derive_list_sections(new_root, &new_length);
+
+                if (new_sections == NULL) {
+                        result = SROC_ERRNOMEM;
+                }
+        }
+
+        if (result == 0) {
+                result = diff_sections(old_sections,
+                                       old_length,
+                                       new_sections,
+                                       new_length,
+                                       callback,
+                                       data);
+        }
+
+        if (old_root->base != NULL) {
+                free(old_sections);
+        }
+
+        if (new_root->base != NULL) {
+                free(new_sections);
+        }
+
+        return result;
+}
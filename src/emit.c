@@ -0,0 +1,414 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "derive.h"
+#include "parse_helper.h"
+#include "sroc.h"
+
+// Size of the staging buffer used for file and fd sinks
+#define EMIT_BUFFER_SIZE (64 * 1024)
+
+// Largest fixed size token (an int64_t plus surrounding punctuation)
+#define EMIT_MAX_TOKEN 32
+
+static const char digit_pairs[] = "00010203040506070809"
+                                  "10111213141516171819"
+                                  "20212223242526272829"
+                                  "30313233343536373839"
+                                  "40414243444546474849"
+                                  "50515253545556575859"
+                                  "60616263646566676869"
+                                  "70717273747576777879"
+                                  "80818283848586878889"
+                                  "90919293949596979899";
+
+/**
+ * All output goes through a single buffer. For buffer sinks it is the sink's
+ * own storage which grows in place, for file and fd sinks it is a staging
+ * buffer which is flushed whenever it fills up
+ */
+struct emitter {
+        struct sroc_sink *sink;
+        char *buffer;
+        size_t used;
+        size_t capacity;
+        int error;
+};
+
+void sroc_init_buffer_sink(struct sroc_sink *sink)
+{
+        sink->type = SROC_SINK_BUFFER;
+        sink->buffer.data = NULL;
+        sink->buffer.length = 0;
+        sink->buffer.capacity = 0;
+}
+
+void sroc_init_file_sink(struct sroc_sink *sink, FILE *file)
+{
+        sink->type = SROC_SINK_FILE;
+        sink->file = file;
+}
+
+void sroc_init_fd_sink(struct sroc_sink *sink, int fd)
+{
+        sink->type = SROC_SINK_FD;
+        sink->fd = fd;
+}
+
+void sroc_release_sink(struct sroc_sink *sink)
+{
+        if (sink->type == SROC_SINK_BUFFER) {
+                free(sink->buffer.data);
+                sroc_init_buffer_sink(sink);
+        }
+}
+
+static int write_fd(int fd, const char *data, size_t length)
+{
+        while (length > 0) {
+                ssize_t written = write(fd, data, length);
+
+                if (written < 0) {
+                        if (errno == EINTR) {
+                                continue;
+                        }
+
+                        return -1;
+                }
+
+                data += written;
+                length -= (size_t)written;
+        }
+
+        return 0;
+}
+
+static int write_sink(struct sroc_sink *sink, const char *data, size_t length)
+{
+        if (sink->type == SROC_SINK_FILE) {
+                if (fwrite(data, 1, length, sink->file) != length) {
+                        return -1;
+                }
+
+                return 0;
+        }
+
+        return write_fd(sink->fd, data, length);
+}
+
+static void emit_flush(struct emitter *emitter)
+{
+        if (emitter->sink->type == SROC_SINK_BUFFER || emitter->used == 0) {
+                return;
+        }
+
+        if (write_sink(emitter->sink, emitter->buffer, emitter->used) != 0) {
+                emitter->error = SROC_ERRIO;
+        }
+
+        emitter->used = 0;
+}
+
+/**
+ * Makes room for at least length more bytes in the output buffer. Returns
+ * false if no room could be made, in which case the emitter holds the error
+ */
+static bool emit_reserve(struct emitter *emitter, size_t length)
+{
+        if (emitter->error != 0) {
+                return false;
+        }
+
+        if (emitter->capacity - emitter->used >= length) {
+                return true;
+        }
+
+        if (emitter->sink->type != SROC_SINK_BUFFER) {
+                emit_flush(emitter);
+
+                return emitter->error == 0 && emitter->capacity >= length;
+        }
+
+        size_t new_capacity = emitter->capacity * 2;
+
+        if (new_capacity < EMIT_BUFFER_SIZE) {
+                new_capacity = EMIT_BUFFER_SIZE;
+        }
+
+        if (new_capacity - emitter->used < length) {
+                new_capacity = emitter->used + length;
+        }
+
+        char *buffer = realloc(emitter->buffer, new_capacity);
+
+        if (buffer == NULL) {
+                emitter->error = SROC_ERRNOMEM;
+
+                return false;
+        }
+
+        emitter->buffer = buffer;
+        emitter->capacity = new_capacity;
+
+        return true;
+}
+
+static void emit_bytes(struct emitter *emitter, const char *data,
+                       size_t length)
+{
+        if (emit_reserve(emitter, length)) {
+                memcpy(emitter->buffer + emitter->used, data, length);
+                emitter->used += length;
+
+                return;
+        }
+
+        if (emitter->error != 0) {
+                return;
+        }
+
+        // Runs larger than the staging buffer skip it entirely
+        if (write_sink(emitter->sink, data, length) != 0) {
+                emitter->error = SROC_ERRIO;
+        }
+}
+
+static void emit_char(struct emitter *emitter, char ch)
+{
+        if (emit_reserve(emitter, 1)) {
+                emitter->buffer[emitter->used++] = ch;
+        }
+}
+
+/**
+ * Formats a number two digits at a time straight into the output buffer
+ */
+static void emit_number(struct emitter *emitter, int64_t number)
+{
+        if (!emit_reserve(emitter, EMIT_MAX_TOKEN)) {
+                return;
+        }
+
+        char digits[EMIT_MAX_TOKEN];
+        char *end = digits + sizeof(digits);
+        char *pos = end;
+        uint64_t magnitude = (number < 0) ? (uint64_t)0 - (uint64_t)number
+                                          : (uint64_t)number;
+
+        while (magnitude >= 100) {
+                size_t pair = (size_t)(magnitude % 100) * 2;
+
+                magnitude /= 100;
+                pos -= 2;
+                memcpy(pos, digit_pairs + pair, 2);
+        }
+
+        if (magnitude >= 10) {
+                pos -= 2;
+                memcpy(pos, digit_pairs + magnitude * 2, 2);
+        } else {
+                *--pos = (char)('0' + magnitude);
+        }
+
+        if (number < 0) {
+                *--pos = '-';
+        }
+
+        memcpy(emitter->buffer + emitter->used, pos, (size_t)(end - pos));
+        emitter->used += (size_t)(end - pos);
+}
+
+/**
+ * Writes a quoted string. Runs of characters which need no escaping are copied
+ * in bulk and only quotes, back slashes and new lines are escaped
+ */
+static void emit_string(struct emitter *emitter, const char *string)
+{
+        emit_char(emitter, '"');
+
+        for (;;) {
+                size_t run = strcspn(string, "\"\\\n");
+
+                emit_bytes(emitter, string, run);
+                string += run;
+
+                if (*string == '\0') {
+                        break;
+                }
+
+                if (emit_reserve(emitter, 2)) {
+                        emitter->buffer[emitter->used++] = '\\';
+                        emitter->buffer[emitter->used++] = *string;
+                }
+
+                ++string;
+        }
+
+        emit_char(emitter, '"');
+}
+
+static void emit_value(struct emitter *emitter, const struct sroc_value *value)
+{
+        switch (value->type) {
+        case SROC_ARRAY:
+                emit_char(emitter, '[');
+
+                for (size_t i = 0; i < value->array->length; ++i) {
+                        if (i != 0) {
+                                emit_bytes(emitter, ", ", 2);
+                        }
+
+                        emit_value(emitter, value->array->items[i]);
+                }
+
+                emit_char(emitter, ']');
+                break;
+        case SROC_BOOL:
+                if (value->boolean) {
+                        emit_bytes(emitter, "true", 4);
+                } else {
+                        emit_bytes(emitter, "false", 5);
+                }
+                break;
+        case SROC_NUMBER:
+                emit_number(emitter, value->number);
+                break;
+        case SROC_STRING:
+                emit_string(emitter, value->string);
+                break;
+        case SROC_OBJECT:
+                emit_char(emitter, '{');
+
+                for (size_t i = 0; i < value->object->length; ++i) {
+                        const struct sroc_field *field
+                                = &value->object->fields[i];
+
+                        if (i != 0) {
+                                emit_bytes(emitter, ", ", 2);
+                        }
+
+                        emit_bytes(emitter, field->key, strlen(field->key));
+                        emit_bytes(emitter, ": ", 2);
+                        emit_value(emitter, &field->value);
+                }
+
+                emit_char(emitter, '}');
+                break;
+        }
+}
+
+static void emit_items(struct emitter *emitter, struct sroc_item **items,
+                       size_t length)
+{
+        for (size_t i = 0; i < length && emitter->error == 0; ++i) {
+                if (!parser_is_valid_key(items[i]->key, false)) {
+                        emitter->error = SROC_ERRINVAL;
+
+                        return;
+                }
+
+                emit_bytes(emitter, items[i]->key, strlen(items[i]->key));
+                emit_bytes(emitter, " = ", 3);
+                emit_value(emitter, items[i]->value);
+                emit_char(emitter, '\n');
+        }
+}
+
+/**
+ * Writes root into sink in the canonical sroc form: root items first and then
+ * each section, separated by a blank line. Parsing the output with
+ * sroc_parse_string results in an identical tree.
+ *
+ * Returns 0 on success or a negative sroc_error. Buffer sinks are appended to
+ */
+int sroc_emit(const struct sroc_root *root, struct sroc_sink *sink)
+{
+        // A derived root is emitted as the sections it reads as
+        struct sroc_table **sections = root->sections;
+        struct sroc_table **listed = NULL;
+        size_t sections_length = root->sections_length;
+
+        if (root->base != NULL) {
+                listed = derive_list_sections(root, &sections_length);
+
+                if (listed == NULL) {
+                        return SROC_ERRNOMEM;
+                }
+
+                sections = listed;
+        }
+
+        struct emitter emitter = {
+                .sink = sink,
+                .buffer = NULL,
+                .used = 0,
+                .capacity = 0,
+                .error = 0,
+        };
+
+        if (sink->type == SROC_SINK_BUFFER) {
+                emitter.buffer = sink->buffer.data;
+                emitter.used = sink->buffer.length;
+                emitter.capacity = sink->buffer.capacity;
+        } else {
+                emitter.buffer = malloc(EMIT_BUFFER_SIZE);
+
+                if (emitter.buffer == NULL) {
+                        free(listed);
+
+                        return SROC_ERRNOMEM;
+                }
+
+                emitter.capacity = EMIT_BUFFER_SIZE;
+        }
+
+        emit_items(&emitter, root->items, root->items_length);
+
+        for (size_t i = 0; i < sections_length; ++i) {
+                const struct sroc_table *section = sections[i];
+
+                if (!parser_is_valid_key(section->key, true)) {
+                        emitter.error = SROC_ERRINVAL;
+
+                        break;
+                }
+
+                if (emitter.used != 0 || i != 0 || root->items_length != 0) {
+                        emit_char(&emitter, '\n');
+                }
+
+                emit_char(&emitter, '[');
+                emit_bytes(&emitter, section->key, strlen(section->key));
+                emit_bytes(&emitter, "]\n", 2);
+                emit_items(&emitter, section->items, section->size);
+        }
+
+        free(listed);
+
+        if (sink->type == SROC_SINK_BUFFER) {
+                if (emit_reserve(&emitter, 1)) {
+                        emitter.buffer[emitter.used] = '\0';
+                }
+
+                sink->buffer.data = emitter.buffer;
+                sink->buffer.length = emitter.used;
+                sink->buffer.capacity = emitter.capacity;
+        } else {
+                emit_flush(&emitter);
+                free(emitter.buffer);
+
+                if (sink->type == SROC_SINK_FILE && emitter.error == 0
+                    && fflush(sink->file) != 0) {
+                        emitter.error = SROC_ERRIO;
+                }
+        }
+
+        return emitter.error;
+}
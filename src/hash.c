@@ -0,0 +1,255 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hash.h"
+
+#define HASH_SEED 0x5ca1ab1e0ddba11ULL
+#define HASH_MULTIPLIER 0xc6a4a7935bd1e995ULL
+#define HASH_SHIFT 47
+
+// Salts which keep values of different types from hashing alike
+#define HASH_SALT_ARRAY 0x9e3779b97f4a7c15ULL
+#define HASH_SALT_BOOL 0xbf58476d1ce4e5b9ULL
+#define HASH_SALT_NUMBER 0x94d049bb133111ebULL
+#define HASH_SALT_STRING 0x2545f4914f6cdd1dULL
+#define HASH_SALT_OBJECT 0xd6e8feb86659fd93ULL
+
+/**
+ * Little endian load so hashes are identical on every host
+ */
+static inline uint64_t load_le64(const unsigned char *bytes)
+{
+        uint64_t value;
+
+        memcpy(&value, bytes, sizeof(value));
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        value = __builtin_bswap64(value);
+#endif
+
+        return value;
+}
+
+static inline uint64_t load_tail(const unsigned char *bytes, size_t length)
+{
+        uint64_t value = 0;
+
+        for (size_t i = 0; i < length; ++i) {
+                value |= (uint64_t)bytes[i] << (8 * i);
+        }
+
+        return value;
+}
+
+/**
+ * A 64-bit hash (MurmurHash64A) which consumes eight bytes per step. Used to
+ * fingerprint spans of the input as well as keys
+ */
+uint64_t hash_bytes(const void *data, size_t length)
+{
+        const unsigned char *bytes = data;
+        uint64_t hash = HASH_SEED ^ (length * HASH_MULTIPLIER);
+
+        while (length >= 8) {
+                uint64_t block = load_le64(bytes);
+
+                block *= HASH_MULTIPLIER;
+                block ^= block >> HASH_SHIFT;
+                block *= HASH_MULTIPLIER;
+
+                hash ^= block;
+                hash *= HASH_MULTIPLIER;
+
+                bytes += 8;
+                length -= 8;
+        }
+
+        if (length > 0) {
+                hash ^= load_tail(bytes, length);
+                hash *= HASH_MULTIPLIER;
+        }
+
+        hash ^= hash >> HASH_SHIFT;
+        hash *= HASH_MULTIPLIER;
+        hash ^= hash >> HASH_SHIFT;
+
+        return hash;
+}
+
+/**
+ * Scrambles a 64-bit value so every input bit affects every output bit. Used
+ * to place key hashes into lookup slots
+ */
+uint64_t hash_mix(uint64_t value)
+{
+        value ^= value >> 30;
+        value *= 0xbf58476d1ce4e5b9ULL;
+        value ^= value >> 27;
+        value *= 0x94d049bb133111ebULL;
+        value ^= value >> 31;
+
+        return value;
+}
+
+// The key of hash_keyed, picked when the library is loaded
+static uint64_t keyed_hash_key[2];
+
+/**
+ * Picks the key of hash_keyed. hash_bytes uses a fixed seed so compiled
+ * configs and sroc.hpp can hash keys ahead of time, which also lets anyone
+ * pick keys that share their whole hash under any seed mixed in afterwards
+ */
+__attribute__((constructor)) static void hash_init_key(void)
+{
+#if defined(__GLIBC__) && __GLIBC__ == 2 && __GLIBC_MINOR__ >= 25
+        if (getentropy(keyed_hash_key, sizeof(keyed_hash_key)) == 0) {
+                return;
+        }
+#endif
+
+        // Without a random source, the time, process id and the address the
+        // library was loaded at are still unknown to whoever wrote the input
+        struct timespec now;
+        uint64_t seed;
+
+        clock_gettime(CLOCK_REALTIME, &now);
+        seed = hash_mix((uint64_t)now.tv_sec ^ (uint64_t)now.tv_nsec);
+        keyed_hash_key[0] = hash_mix(seed ^ (uint64_t)getpid());
+        keyed_hash_key[1] = hash_mix(seed ^ (uint64_t)(uintptr_t)&seed);
+}
+
+static inline uint64_t rotate_left(uint64_t value, int bits)
+{
+        return (value << bits) | (value >> (64 - bits));
+}
+
+static inline void sip_round(uint64_t v[4])
+{
+        v[0] += v[1];
+        v[1] = rotate_left(v[1], 13) ^ v[0];
+        v[0] = rotate_left(v[0], 32);
+        v[2] += v[3];
+        v[3] = rotate_left(v[3], 16) ^ v[2];
+        v[0] += v[3];
+        v[3] = rotate_left(v[3], 21) ^ v[0];
+        v[2] += v[1];
+        v[1] = rotate_left(v[1], 17) ^ v[2];
+        v[2] = rotate_left(v[2], 32);
+}
+
+/**
+ * SipHash-1-3 under a key picked at random per process. Unlike hash_bytes,
+ * inputs sharing a hash cannot be found without the key, so it places
+ * whatever the input decides into the hash tables built at run time. Its
+ * values differ between processes and must never be stored
+ */
+uint64_t hash_keyed(const void *data, size_t length)
+{
+        const unsigned char *bytes = data;
+        uint64_t v[4] = {
+                keyed_hash_key[0] ^ 0x736f6d6570736575ULL,
+                keyed_hash_key[1] ^ 0x646f72616e646f6dULL,
+                keyed_hash_key[0] ^ 0x6c7967656e657261ULL,
+                keyed_hash_key[1] ^ 0x7465646279746573ULL,
+        };
+        uint64_t last = (uint64_t)length << 56;
+
+        while (length >= 8) {
+                uint64_t block = load_le64(bytes);
+
+                v[3] ^= block;
+                sip_round(v);
+                v[0] ^= block;
+
+                bytes += 8;
+                length -= 8;
+        }
+
+        last |= load_tail(bytes, length);
+        v[3] ^= last;
+        sip_round(v);
+        v[0] ^= last;
+
+        v[2] ^= 0xff;
+        sip_round(v);
+        sip_round(v);
+        sip_round(v);
+
+        return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
+
+static uint64_t hash_array(const struct sroc_array *array)
+{
+        uint64_t hash = hash_mix(HASH_SALT_ARRAY ^ array->length);
+
+        if (array->type == SROC_NUMBER) {
+                // Numeric arrays are hashed in a tight loop without going
+                // through the per value dispatch
+                for (size_t i = 0; i < array->length; ++i) {
+                        uint64_t number = (uint64_t)array->items[i]->number;
+
+                        hash = (hash ^ hash_mix(number ^ HASH_SALT_NUMBER))
+                               * HASH_MULTIPLIER;
+                }
+
+                return hash;
+        }
+
+        for (size_t i = 0; i < array->length; ++i) {
+                hash = (hash ^ hash_value(array->items[i])) * HASH_MULTIPLIER;
+        }
+
+        return hash;
+}
+
+/**
+ * The hashes of the fields are added up, so objects holding the same fields in
+ * another order hash alike
+ */
+static uint64_t hash_object(const struct sroc_object *object)
+{
+        uint64_t fields = 0;
+
+        for (size_t i = 0; i < object->length; ++i) {
+                fields += hash_mix(object->hashes[i]
+                                   ^ hash_value(&object->fields[i].value));
+        }
+
+        return hash_mix(HASH_SALT_OBJECT ^ object->length) ^ fields;
+}
+
+/**
+ * Hashes the content of a value, so equal values hash alike no matter how they
+ * were written. Never returns 0, which is reserved for an unknown hash
+ */
+uint64_t hash_value(const struct sroc_value *value)
+{
+        uint64_t hash = 0;
+
+        switch (value->type) {
+        case SROC_ARRAY:
+                hash = hash_array(value->array);
+                break;
+        case SROC_BOOL:
+                hash = hash_mix(HASH_SALT_BOOL ^ (value->boolean ? 1 : 0));
+                break;
+        case SROC_NUMBER:
+                hash = hash_mix(HASH_SALT_NUMBER ^ (uint64_t)value->number);
+                break;
+        case SROC_STRING:
+                hash = HASH_SALT_STRING
+                       ^ hash_bytes(value->string, strlen(value->string));
+                break;
+        case SROC_OBJECT:
+                hash = hash_object(value->object);
+                break;
+        }
+
+        return (hash == 0) ? 1 : hash;
+}
@@ -0,0 +1,15 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sroc.h"
+
+uint64_t hash_bytes(const void *data, size_t length);
+uint64_t hash_keyed(const void *data, size_t length);
+uint64_t hash_mix(uint64_t value);
+uint64_t hash_value(const struct sroc_value *value);
@@ -0,0 +1,499 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "index.h"
+#include "sroc.h"
+
+const char *index_item_key(const void *entries, size_t position)
+{
+        return ((struct sroc_item *const *)entries)[position]->key;
+}
+
+const char *index_table_key(const void *entries, size_t position)
+{
+        return ((struct sroc_table *const *)entries)[position]->key;
+}
+
+/**
+ * Interned keys are equal exactly when they are the same copy, so comparing
+ * the pointers first settles a match without reading the names
+ */
+static inline bool keys_equal(const char *a, const char *b)
+{
+        return a == b || strcmp(a, b) == 0;
+}
+
+/**
+ * Orders positions by key and then by position, so duplicate keys keep their
+ * file order and the result is the same on every run
+ */
+static int compare_positions(const void *entries, index_key_getter key_at,
+                             size_t a, size_t b)
+{
+        int result = strcmp(key_at(entries, a), key_at(entries, b));
+
+        if (result != 0) {
+                return result;
+        }
+
+        return (a < b) ? -1 : (a > b);
+}
+
+static void merge_sort(const void *entries, index_key_getter key_at,
+                       size_t *positions, size_t *scratch, size_t length)
+{
+        if (length < 2) {
+                return;
+        }
+
+        size_t middle = length / 2;
+
+        merge_sort(entries, key_at, positions, scratch, middle);
+        merge_sort(entries,
+                   key_at,
+                   positions + middle,
+                   scratch,
+                   length - middle);
+
+        size_t left = 0;
+        size_t right = middle;
+        size_t out = 0;
+
+        while (left < middle && right < length) {
+                if (compare_positions(
+                            entries, key_at, positions[left], positions[right])
+                    <= 0) {
+                        scratch[out++] = positions[left++];
+                } else {
+                        scratch[out++] = positions[right++];
+                }
+        }
+
+        while (left < middle) {
+                scratch[out++] = positions[left++];
+        }
+
+        while (right < length) {
+                scratch[out++] = positions[right++];
+        }
+
+        memcpy(positions, scratch, length * sizeof(size_t));
+}
+
+/**
+ * Builds a secondary index over entries: an array of positions sorted by key
+ * with room for capacity positions, so entries can be added with index_insert.
+ * dest is left NULL for an empty list. Returns 0 or a negative sroc_error
+ */
+int index_build(const void *entries, size_t length, size_t capacity,
+                index_key_getter key_at, size_t **dest)
+{
+        *dest = NULL;
+
+        if (length == 0) {
+                return 0;
+        }
+
+        if (capacity < length) {
+                capacity = length;
+        }
+
+        size_t *positions = malloc(capacity * sizeof(size_t));
+        size_t *scratch = malloc(length * sizeof(size_t));
+
+        if (positions == NULL || scratch == NULL) {
+                free(positions);
+                free(scratch);
+                errno = ENOMEM;
+
+                return SROC_ERRNOMEM;
+        }
+
+        for (size_t i = 0; i < length; ++i) {
+                positions[i] = i;
+        }
+
+        merge_sort(entries, key_at, positions, scratch, length);
+        free(scratch);
+
+        *dest = positions;
+
+        return 0;
+}
+
+void index_init_lookup(struct sroc_lookup *lookup)
+{
+        lookup->mask = 0;
+        lookup->slots = NULL;
+        lookup->seeds_mask = 0;
+        lookup->seeds = NULL;
+        lookup->hashes = NULL;
+}
+
+/**
+ * Returns the hash placing key into a lookup built at run time. It is keyed
+ * per process, so keys sharing a hash_bytes still spread over the slots
+ */
+static inline uint64_t keyed_key_hash(const char *key)
+{
+        return hash_keyed(key, strlen(key));
+}
+
+/**
+ * Builds a linear probing lookup over entries with room for twice as many
+ * keys, so probe sequences stay short. The keyed hashes of the keys share the
+ * allocation of the slots. Returns 0 or a negative sroc_error
+ */
+int index_build_lookup(const void *entries, size_t length,
+                       index_key_getter key_at, struct sroc_lookup *dest)
+{
+        index_init_lookup(dest);
+
+        if (length == 0) {
+                return 0;
+        }
+
+        size_t capacity = 8;
+
+        while (capacity < length * 2) {
+                capacity *= 2;
+        }
+
+        size_t *slots = malloc(capacity * (sizeof(size_t) + sizeof(uint64_t)));
+
+        if (slots == NULL) {
+                errno = ENOMEM;
+
+                return SROC_ERRNOMEM;
+        }
+
+        uint64_t *hashes = (uint64_t *)(slots + capacity);
+
+        for (size_t i = 0; i < capacity; ++i) {
+                slots[i] = SROC_EMPTY_SLOT;
+        }
+
+        dest->mask = capacity - 1;
+        dest->slots = slots;
+        dest->hashes = hashes;
+
+        for (size_t i = 0; i < length; ++i) {
+                const char *key = key_at(entries, i);
+                uint64_t hash = keyed_key_hash(key);
+                size_t slot = (size_t)hash & dest->mask;
+
+                // Only the first of several equal keys is ever looked up, so
+                // later ones are left out rather than piling up in one long
+                // probe sequence
+                while (slots[slot] != SROC_EMPTY_SLOT
+                       && (hashes[slot] != hash
+                           || !keys_equal(key_at(entries, slots[slot]), key))) {
+                        slot = (slot + 1) & dest->mask;
+                }
+
+                if (slots[slot] == SROC_EMPTY_SLOT) {
+                        slots[slot] = i;
+                        hashes[slot] = hash;
+                }
+        }
+
+        return 0;
+}
+
+/**
+ * Adds the last of length entries to index, which must have room for it. The
+ * new entry sorts after any entry with an equal key since its position is the
+ * largest
+ */
+void index_insert(const void *entries, size_t length, index_key_getter key_at,
+                  size_t *index)
+{
+        size_t position = length - 1;
+        const char *key = key_at(entries, position);
+        size_t low = 0;
+        size_t high = position;
+
+        while (low < high) {
+                size_t middle = low + (high - low) / 2;
+
+                if (strcmp(key_at(entries, index[middle]), key) <= 0) {
+                        low = middle + 1;
+                } else {
+                        high = middle;
+                }
+        }
+
+        memmove(index + low + 1,
+                index + low,
+                (position - low) * sizeof(size_t));
+        index[low] = position;
+}
+
+/**
+ * Adds the last of length entries to lookup. The lookup is rebuilt with twice
+ * the room once it would be more than half full, so each insert costs O(1)
+ * amortized. Returns 0 or a negative sroc_error
+ */
+int index_insert_lookup(const void *entries, size_t length,
+                        index_key_getter key_at, struct sroc_lookup *lookup)
+{
+        if (lookup->slots == NULL || length * 2 > lookup->mask + 1) {
+                struct sroc_lookup grown;
+
+                if (index_build_lookup(entries, length, key_at, &grown) != 0) {
+                        return SROC_ERRNOMEM;
+                }
+
+                index_destroy_lookup(lookup);
+                *lookup = grown;
+
+                return 0;
+        }
+
+        uint64_t hash = keyed_key_hash(key_at(entries, length - 1));
+        size_t slot = (size_t)hash & lookup->mask;
+
+        while (lookup->slots[slot] != SROC_EMPTY_SLOT) {
+                slot = (slot + 1) & lookup->mask;
+        }
+
+        lookup->slots[slot] = length - 1;
+        lookup->hashes[slot] = hash;
+
+        return 0;
+}
+
+/**
+ * Frees a lookup built by index_build_lookup. Lookups with seeds are generated
+ * by sroc-compile and live in static storage, so they are never freed
+ */
+void index_destroy_lookup(struct sroc_lookup *lookup)
+{
+        if (lookup->seeds == NULL) {
+                free(lookup->slots);
+        }
+
+        index_init_lookup(lookup);
+}
+
+/**
+ * Returns the position of the first entry with the given key, or -1 if there
+ * is none. hash must be hash_bytes of the key, which only the lookups
+ * generated by sroc-compile use
+ */
+int64_t index_lookup(const void *entries, const struct sroc_lookup *lookup,
+                     index_key_getter key_at, const char *key, uint64_t hash)
+{
+        if (lookup->seeds != NULL) {
+                uint64_t seed = lookup->seeds[hash & lookup->seeds_mask];
+                size_t position
+                        = lookup->slots[hash_mix(hash ^ seed) & lookup->mask];
+
+                if (position != SROC_EMPTY_SLOT
+                    && keys_equal(key_at(entries, position), key)) {
+                        return (int64_t)position;
+                }
+
+                return -1;
+        }
+
+        uint64_t keyed = keyed_key_hash(key);
+        size_t slot = (size_t)keyed & lookup->mask;
+        size_t position;
+
+        while ((position = lookup->slots[slot]) != SROC_EMPTY_SLOT) {
+                if (lookup->hashes[slot] == keyed
+                    && keys_equal(key_at(entries, position), key)) {
+                        return (int64_t)position;
+                }
+
+                slot = (slot + 1) & lookup->mask;
+        }
+
+        return -1;
+}
+
+/**
+ * Builds the indexes of the root items, the sections list and every section
+ * which does not have an index yet
+ */
+int index_build_root(struct sroc_root *root)
+{
+        for (size_t i = 0; i < root->sections_length; ++i) {
+                struct sroc_table *table = root->sections[i];
+
+                if (table->index != NULL || table->size == 0) {
+                        continue;
+                }
+
+                if (index_build(table->items,
+                                table->size,
+                                table->capacity,
+                                index_item_key,
+                                &table->index)
+                            != 0
+                    || index_build_lookup(table->items,
+                                          table->size,
+                                          index_item_key,
+                                          &table->lookup)
+                               != 0) {
+                        return SROC_ERRNOMEM;
+                }
+        }
+
+        free(root->items_index);
+        free(root->sections_index);
+        index_destroy_lookup(&root->items_lookup);
+        index_destroy_lookup(&root->sections_lookup);
+
+        if (index_build(root->items,
+                        root->items_length,
+                        root->items_capacity,
+                        index_item_key,
+                        &root->items_index)
+                    != 0
+            || index_build_lookup(root->items,
+                                  root->items_length,
+                                  index_item_key,
+                                  &root->items_lookup)
+                       != 0) {
+                return SROC_ERRNOMEM;
+        }
+
+        if (index_build(root->sections,
+                        root->sections_length,
+                        root->sections_capacity,
+                        index_table_key,
+                        &root->sections_index)
+                    != 0
+            || index_build_lookup(root->sections,
+                                  root->sections_length,
+                                  index_table_key,
+                                  &root->sections_lookup)
+                       != 0) {
+                return SROC_ERRNOMEM;
+        }
+
+        return 0;
+}
+
+/**
+ * Returns the first slot of index whose key is not less than key
+ */
+size_t index_lower_bound(const void *entries, const size_t *index,
+                         size_t length, index_key_getter key_at,
+                         const char *key)
+{
+        size_t low = 0;
+        size_t high = length;
+
+        while (low < high) {
+                size_t middle = low + (high - low) / 2;
+
+                if (strcmp(key_at(entries, index[middle]), key) < 0) {
+                        low = middle + 1;
+                } else {
+                        high = middle;
+                }
+        }
+
+        return low;
+}
+
+/**
+ * Returns the first slot at or after start whose key does not begin with
+ * prefix. Every key in [start, result) begins with prefix
+ */
+size_t index_prefix_end(const void *entries, const size_t *index,
+                        size_t start, size_t length, index_key_getter key_at,
+                        const char *prefix)
+{
+        size_t prefix_length = strlen(prefix);
+        size_t low = start;
+        size_t high = length;
+
+        while (low < high) {
+                size_t middle = low + (high - low) / 2;
+
+                if (strncmp(key_at(entries, index[middle]),
+                            prefix,
+                            prefix_length)
+                    == 0) {
+                        low = middle + 1;
+                } else {
+                        high = middle;
+                }
+        }
+
+        return low;
+}
+
+/**
+ * Returns the position of the first entry with the given key, or -1 if there
+ * is none. Entries without an index are searched linearly
+ */
+int64_t index_find(const void *entries, const size_t *index, size_t length,
+                   index_key_getter key_at, const char *key)
+{
+        if (index == NULL) {
+                for (size_t i = 0; i < length; ++i) {
+                        if (keys_equal(key_at(entries, i), key)) {
+                                return (int64_t)i;
+                        }
+                }
+
+                return -1;
+        }
+
+        size_t slot = index_lower_bound(entries, index, length, key_at, key);
+
+        if (slot < length && keys_equal(key_at(entries, index[slot]), key)) {
+                return (int64_t)index[slot];
+        }
+
+        return -1;
+}
+
+/**
+ * Finds the position of key like index_search, given the hash_bytes of key
+ * computed beforehand
+ */
+int64_t index_search_hashed(const void *entries, const size_t *index,
+                            const struct sroc_lookup *lookup, size_t length,
+                            index_key_getter key_at, const char *key,
+                            uint64_t hash)
+{
+        if (lookup->slots != NULL) {
+                return index_lookup(entries, lookup, key_at, key, hash);
+        }
+
+        return index_find(entries, index, length, key_at, key);
+}
+
+/**
+ * Finds the position of key using the hash lookup when there is one, falling
+ * back to the sorted index and finally to a linear search
+ */
+int64_t index_search(const void *entries, const size_t *index,
+                     const struct sroc_lookup *lookup, size_t length,
+                     index_key_getter key_at, const char *key)
+{
+        if (lookup->slots != NULL) {
+                // Lookups built at run time hash the key themselves
+                uint64_t hash = (lookup->seeds != NULL)
+                                        ? hash_bytes(key, strlen(key))
+                                        : 0;
+
+                return index_lookup(entries, lookup, key_at, key, hash);
+        }
+
+        return index_find(entries, index, length, key_at, key);
+}
@@ -0,0 +1,44 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sroc.h"
+
+typedef const char *(*index_key_getter)(const void *entries, size_t position);
+
+const char *index_item_key(const void *entries, size_t position);
+const char *index_table_key(const void *entries, size_t position);
+
+int index_build(const void *entries, size_t length, size_t capacity,
+                index_key_getter key_at, size_t **dest);
+void index_insert(const void *entries, size_t length, index_key_getter key_at,
+                  size_t *index);
+void index_init_lookup(struct sroc_lookup *lookup);
+int index_build_lookup(const void *entries, size_t length,
+                       index_key_getter key_at, struct sroc_lookup *dest);
+int index_insert_lookup(const void *entries, size_t length,
+                        index_key_getter key_at, struct sroc_lookup *lookup);
+void index_destroy_lookup(struct sroc_lookup *lookup);
+int64_t index_lookup(const void *entries, const struct sroc_lookup *lookup,
+                     index_key_getter key_at, const char *key, uint64_t hash);
+int index_build_root(struct sroc_root *root);
+size_t index_lower_bound(const void *entries, const size_t *index,
+                         size_t length, index_key_getter key_at,
+                         const char *key);
+size_t index_prefix_end(const void *entries, const size_t *index,
+                        size_t start, size_t length, index_key_getter key_at,
+                        const char *prefix);
+int64_t index_find(const void *entries, const size_t *index, size_t length,
+                   index_key_getter key_at, const char *key);
+int64_t index_search(const void *entries, const size_t *index,
+                     const struct sroc_lookup *lookup, size_t length,
+                     index_key_getter key_at, const char *key);
+int64_t index_search_hashed(const void *entries, const size_t *index,
+                            const struct sroc_lookup *lookup, size_t length,
+                            index_key_getter key_at, const char *key,
+                            uint64_t hash);
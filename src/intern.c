@@ -0,0 +1,215 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "intern.h"
+
+// Room for a few dozen short strings per allocation. Any string up to
+// INTERN_MAX_LENGTH fits into a new block
+#define INTERN_BLOCK_SIZE 4096
+#define INTERN_INITIAL_CAPACITY 64
+
+struct intern_block {
+        struct intern_block *next;
+        size_t used;
+        char data[INTERN_BLOCK_SIZE];
+};
+
+struct intern_entry {
+        char *string;
+        size_t length;
+        uint64_t hash;
+};
+
+struct sroc_intern *intern_create(void)
+{
+        struct sroc_intern *intern = malloc(sizeof(struct sroc_intern));
+        struct intern_entry *entries
+                = calloc(INTERN_INITIAL_CAPACITY, sizeof(struct intern_entry));
+
+        if (intern == NULL || entries == NULL) {
+                free(intern);
+                free(entries);
+                errno = ENOMEM;
+
+                return NULL;
+        }
+
+        intern->blocks = NULL;
+        intern->length = 0;
+        intern->mask = INTERN_INITIAL_CAPACITY - 1;
+        intern->entries = entries;
+
+        return intern;
+}
+
+void intern_destroy(struct sroc_intern *intern)
+{
+        if (intern == NULL) {
+                return;
+        }
+
+        struct intern_block *block = intern->blocks;
+
+        while (block != NULL) {
+                struct intern_block *next = block->next;
+
+                free(block);
+                block = next;
+        }
+
+        free(intern->entries);
+        free(intern);
+}
+
+/**
+ * Returns the slot holding data, or the empty slot where it would go. hash
+ * must be hash_keyed of data, since every key and short string of the input
+ * lands here
+ */
+static size_t find_slot(const struct sroc_intern *intern, const char *data,
+                        size_t length, uint64_t hash)
+{
+        size_t slot = (size_t)hash & intern->mask;
+        const struct intern_entry *entry;
+
+        while ((entry = &intern->entries[slot])->string != NULL) {
+                if (entry->hash == hash && entry->length == length
+                    && memcmp(entry->string, data, length) == 0) {
+                        break;
+                }
+
+                slot = (slot + 1) & intern->mask;
+        }
+
+        return slot;
+}
+
+/**
+ * Doubles the set once it would be more than half full, so probe sequences
+ * stay short
+ */
+static int grow_entries(struct sroc_intern *intern)
+{
+        size_t capacity = (intern->mask + 1) * 2;
+        struct intern_entry *old_entries = intern->entries;
+        size_t old_capacity = intern->mask + 1;
+        struct intern_entry *entries
+                = calloc(capacity, sizeof(struct intern_entry));
+
+        if (entries == NULL) {
+                errno = ENOMEM;
+
+                return -1;
+        }
+
+        intern->entries = entries;
+        intern->mask = capacity - 1;
+
+        for (size_t i = 0; i < old_capacity; ++i) {
+                if (old_entries[i].string != NULL) {
+                        size_t slot = (size_t)old_entries[i].hash
+                                      & intern->mask;
+
+                        while (entries[slot].string != NULL) {
+                                slot = (slot + 1) & intern->mask;
+                        }
+
+                        entries[slot] = old_entries[i];
+                }
+        }
+
+        free(old_entries);
+
+        return 0;
+}
+
+/**
+ * Copies length bytes of data and a null terminator into the newest block,
+ * starting a new one when it is full
+ */
+static char *store(struct sroc_intern *intern, const char *data,
+                   size_t length)
+{
+        struct intern_block *block = intern->blocks;
+
+        if (block == NULL || INTERN_BLOCK_SIZE - block->used < length + 1) {
+                block = malloc(sizeof(struct intern_block));
+
+                if (block == NULL) {
+                        errno = ENOMEM;
+
+                        return NULL;
+                }
+
+                block->next = intern->blocks;
+                block->used = 0;
+                intern->blocks = block;
+        }
+
+        char *string = block->data + block->used;
+
+        memcpy(string, data, length);
+        string[length] = '\0';
+        block->used += length + 1;
+
+        return string;
+}
+
+/**
+ * Returns the stored copy of length bytes of data, storing one first when
+ * there is none yet. length must not exceed INTERN_MAX_LENGTH. Returns NULL
+ * and sets errno to ENOMEM when memory runs out
+ */
+char *intern_span(struct sroc_intern *intern, const char *data,
+                  size_t length)
+{
+        uint64_t hash = hash_keyed(data, length);
+        size_t slot = find_slot(intern, data, length, hash);
+
+        if (intern->entries[slot].string != NULL) {
+                return intern->entries[slot].string;
+        }
+
+        if ((intern->length + 1) * 2 > intern->mask + 1) {
+                if (grow_entries(intern) != 0) {
+                        return NULL;
+                }
+
+                slot = find_slot(intern, data, length, hash);
+        }
+
+        char *string = store(intern, data, length);
+
+        if (string == NULL) {
+                return NULL;
+        }
+
+        intern->entries[slot].string = string;
+        intern->entries[slot].length = length;
+        intern->entries[slot].hash = hash;
+        ++intern->length;
+
+        return string;
+}
+
+/**
+ * Returns the stored copy of length bytes of data, or NULL when it was never
+ * interned
+ */
+const char *intern_find(const struct sroc_intern *intern, const char *data,
+                        size_t length)
+{
+        if (length > INTERN_MAX_LENGTH) {
+                return NULL;
+        }
+
+        size_t slot = find_slot(intern, data, length, hash_keyed(data, length));
+
+        return intern->entries[slot].string;
+}
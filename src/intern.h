@@ -0,0 +1,36 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sroc.h"
+
+// Longer strings are rarely repeated, so hashing them is not worth it and they
+// keep an allocation of their own
+#define INTERN_MAX_LENGTH 256
+
+struct intern_block;
+struct intern_entry;
+
+/**
+ * One stored copy of every distinct string a parse interned. The strings are
+ * packed into blocks which are only freed along with the table, and an open
+ * addressed set over them finds an existing copy by hash
+ */
+struct sroc_intern {
+        struct intern_block *blocks;
+        size_t length;
+        size_t mask;
+        struct intern_entry *entries;
+};
+
+struct sroc_intern *intern_create(void);
+void intern_destroy(struct sroc_intern *intern);
+char *intern_span(struct sroc_intern *intern, const char *data,
+                  size_t length);
+const char *intern_find(const struct sroc_intern *intern, const char *data,
+                        size_t length);
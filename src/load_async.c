@@ -0,0 +1,445 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+
+#include "parse_helper.h"
+#include "sroc.h"
+
+// Bytes read between two checks for cancellation
+#define READ_CHUNK (1024 * 1024)
+
+/**
+ * Where a job is in finishing. The descriptor is only written by a worker
+ * which moves a job from LOAD_DONE to LOAD_SIGNALING, and a result collected
+ * before that is never signaled at all, so the descriptor is drained exactly
+ * when it was written
+ */
+enum load_stage {
+        LOAD_RUNNING,
+        LOAD_DONE,
+        LOAD_SIGNALING,
+        LOAD_SIGNALED,
+        LOAD_COLLECTED,
+};
+
+/**
+ * A job is shared by the thread loading the file and the caller, and freed by
+ * whichever of the two lets go of it last. root and error are written by the
+ * worker before stage leaves LOAD_RUNNING and only read after that.
+ *
+ * Completion is signaled on an eventfd where there is one, otherwise on a
+ * pipe, and notify_fds holds the end the caller waits on followed by the end
+ * the worker writes to
+ */
+struct sroc_load_job {
+        char *path;
+        struct sroc_limits limits;
+        bool limited;
+        sroc_load_callback callback;
+        void *data;
+        int notify_fds[2];
+        _Atomic bool canceled;
+        _Atomic int stage;
+        _Atomic int references;
+        struct sroc_root *root;
+        int error;
+};
+
+static int open_notify(int fds[2])
+{
+#if defined(__linux__)
+        fds[0] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        fds[1] = fds[0];
+
+        return (fds[0] < 0) ? -1 : 0;
+#else
+        if (pipe(fds) != 0) {
+                return -1;
+        }
+
+        for (int i = 0; i < 2; ++i) {
+                fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+                fcntl(fds[i], F_SETFL, O_NONBLOCK);
+        }
+
+        return 0;
+#endif
+}
+
+static void signal_notify(const int fds[2])
+{
+#if defined(__linux__)
+        uint64_t one = 1;
+
+        while (write(fds[1], &one, sizeof(one)) < 0 && errno == EINTR) {
+        }
+#else
+        char one = 1;
+
+        while (write(fds[1], &one, 1) < 0 && errno == EINTR) {
+        }
+#endif
+}
+
+static void drain_notify(const int fds[2])
+{
+        uint64_t count;
+
+        while (read(fds[0], &count, sizeof(count)) < 0 && errno == EINTR) {
+        }
+}
+
+static void close_notify(const int fds[2])
+{
+        close(fds[0]);
+
+        if (fds[1] != fds[0]) {
+                close(fds[1]);
+        }
+}
+
+static void release_reference(struct sroc_load_job *job)
+{
+        if (atomic_fetch_sub_explicit(&job->references, 1, memory_order_acq_rel)
+            != 1) {
+                return;
+        }
+
+        if (job->root != NULL) {
+                sroc_destroy_root(job->root);
+        }
+
+        close_notify(job->notify_fds);
+        free(job->path);
+        free(job);
+}
+
+static bool is_canceled(struct sroc_load_job *job)
+{
+        return atomic_load_explicit(&job->canceled, memory_order_relaxed);
+}
+
+/**
+ * Reads the whole file at path into a new buffer, READ_CHUNK bytes at a time
+ * so a canceled job stops reading soon. Returns the number of bytes read or a
+ * negative sroc_error
+ */
+static int64_t read_file(struct sroc_load_job *job, char **dest)
+{
+        int fd = open(job->path, O_RDONLY | O_CLOEXEC);
+
+        if (fd < 0) {
+                return SROC_ERRIO;
+        }
+
+        struct stat info;
+
+        if (fstat(fd, &info) != 0 || info.st_size < 0) {
+                close(fd);
+
+                return SROC_ERRIO;
+        }
+
+        size_t size = (size_t)info.st_size;
+
+        if (job->limited && job->limits.max_bytes != 0
+            && size > job->limits.max_bytes) {
+                close(fd);
+
+                return SROC_ERRTOOBIG;
+        }
+
+        char *buffer = malloc((size > 0) ? size : 1);
+        size_t length = 0;
+
+        if (buffer == NULL) {
+                close(fd);
+
+                return SROC_ERRNOMEM;
+        }
+
+        while (length < size) {
+                if (is_canceled(job)) {
+                        free(buffer);
+                        close(fd);
+
+                        return SROC_ERRCANCELED;
+                }
+
+                size_t chunk = size - length;
+
+                if (chunk > READ_CHUNK) {
+                        chunk = READ_CHUNK;
+                }
+
+                ssize_t bytes = read(fd, buffer + length, chunk);
+
+                if (bytes < 0 && errno == EINTR) {
+                        continue;
+                }
+
+                if (bytes < 0) {
+                        free(buffer);
+                        close(fd);
+
+                        return SROC_ERRIO;
+                }
+
+                if (bytes == 0) {
+                        // The file shrank after fstat
+                        break;
+                }
+
+                length += (size_t)bytes;
+        }
+
+        close(fd);
+        *dest = buffer;
+
+        return (int64_t)length;
+}
+
+static int load_file(struct sroc_load_job *job, struct sroc_root **dest)
+{
+        struct parser_context *context = init_parser();
+        char *buffer = NULL;
+
+        if (context == NULL) {
+                return SROC_ERRNOMEM;
+        }
+
+        parser_set_limits(context, job->limited ? &job->limits : NULL);
+        context->canceled = &job->canceled;
+
+        int64_t length = read_file(job, &buffer);
+        int result = 0;
+
+        if (length < 0) {
+                result = (int)length;
+        } else {
+                *dest = parser_parse(context, buffer, (size_t)length);
+
+                if (*dest == NULL) {
+                        result = parser_error(context);
+                }
+        }
+
+        free(buffer);
+        destroy_parser_context(context);
+
+        return result;
+}
+
+static void *run_job(void *data)
+{
+        struct sroc_load_job *job = data;
+        struct sroc_root *root = NULL;
+        int error = load_file(job, &root);
+
+        // A job canceled late may still have parsed the whole file
+        if (error == 0 && is_canceled(job)) {
+                sroc_destroy_root(root);
+                root = NULL;
+                error = SROC_ERRCANCELED;
+        }
+
+        job->root = root;
+        job->error = error;
+        atomic_store_explicit(&job->stage, LOAD_DONE, memory_order_release);
+
+        if (job->callback != NULL && !is_canceled(job)) {
+                job->callback(job, job->data);
+        }
+
+        // Nothing is signaled once the result was collected, from the
+        // callback or by a poll which came before the descriptor was ready
+        int stage = LOAD_DONE;
+
+        if (atomic_compare_exchange_strong_explicit(&job->stage,
+                                                    &stage,
+                                                    LOAD_SIGNALING,
+                                                    memory_order_acq_rel,
+                                                    memory_order_acquire)) {
+                signal_notify(job->notify_fds);
+                atomic_store_explicit(
+                        &job->stage, LOAD_SIGNALED, memory_order_release);
+        }
+
+        release_reference(job);
+
+        return NULL;
+}
+
+/**
+ * Starts loading the file at path on a new thread, so a program driven by an
+ * event loop keeps running while the file is read and parsed.
+ *
+ * The descriptor returned by sroc_load_fd becomes readable once the job has
+ * finished and can be added to the program's own epoll or poll set. The
+ * result is then collected with sroc_load_poll. The job must be released with
+ * sroc_load_release whether or not it has finished.
+ *
+ * Returns 0 and sets dest, otherwise SROC_ERRNOMEM or SROC_ERRIO if the job
+ * could not be started
+ */
+int sroc_load_async(const char *path, const struct sroc_load_options *options,
+                    struct sroc_load_job **dest)
+{
+        struct sroc_load_job *job = calloc(1, sizeof(struct sroc_load_job));
+
+        if (job == NULL) {
+                return SROC_ERRNOMEM;
+        }
+
+        job->path = strdup(path);
+
+        if (job->path == NULL) {
+                free(job);
+
+                return SROC_ERRNOMEM;
+        }
+
+        if (options != NULL) {
+                if (options->limits != NULL) {
+                        job->limits = *options->limits;
+                        job->limited = true;
+                }
+
+                job->callback = options->callback;
+                job->data = options->data;
+        }
+
+        atomic_init(&job->canceled, false);
+        atomic_init(&job->stage, LOAD_RUNNING);
+        atomic_init(&job->references, 2);
+
+        if (open_notify(job->notify_fds) != 0) {
+                free(job->path);
+                free(job);
+
+                return SROC_ERRIO;
+        }
+
+        pthread_attr_t attributes;
+        pthread_t thread;
+        int started;
+
+        pthread_attr_init(&attributes);
+        pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+        started = pthread_create(&thread, &attributes, run_job, job);
+        pthread_attr_destroy(&attributes);
+
+        if (started != 0) {
+                close_notify(job->notify_fds);
+                free(job->path);
+                free(job);
+
+                return SROC_ERRNOMEM;
+        }
+
+        *dest = job;
+
+        return 0;
+}
+
+/**
+ * Returns the descriptor which becomes readable once job has finished
+ */
+int sroc_load_fd(const struct sroc_load_job *job)
+{
+        return job->notify_fds[0];
+}
+
+/**
+ * Collects the result of job without blocking. Returns SROC_ERRAGAIN while
+ * the job is still running. Once it has finished, returns 0 and hands the
+ * parsed root over to the caller through dest, or returns the sroc_error the
+ * load failed with: SROC_ERRIO, SROC_ERRCANCELED, or any error of
+ * sroc_parse_limited. A result can only be collected once, later calls
+ * return SROC_ERRINVAL. A result collected from the callback, or before the
+ * descriptor was ready, leaves the descriptor unsignaled
+ */
+int sroc_load_poll(struct sroc_load_job *job, struct sroc_root **dest)
+{
+        int stage = atomic_load_explicit(&job->stage, memory_order_acquire);
+
+        if (stage == LOAD_RUNNING) {
+                return SROC_ERRAGAIN;
+        }
+
+        if (stage != LOAD_DONE
+            || !atomic_compare_exchange_strong_explicit(&job->stage,
+                                                        &stage,
+                                                        LOAD_COLLECTED,
+                                                        memory_order_acq_rel,
+                                                        memory_order_acquire)) {
+                // The worker is at most one write away from signaling
+                while (stage == LOAD_SIGNALING) {
+                        sched_yield();
+                        stage = atomic_load_explicit(&job->stage,
+                                                     memory_order_acquire);
+                }
+
+                if (stage != LOAD_SIGNALED
+                    || !atomic_compare_exchange_strong_explicit(
+                            &job->stage,
+                            &stage,
+                            LOAD_COLLECTED,
+                            memory_order_acq_rel,
+                            memory_order_acquire)) {
+                        return SROC_ERRINVAL;
+                }
+
+                drain_notify(job->notify_fds);
+        }
+
+        if (job->error != 0) {
+                return job->error;
+        }
+
+        *dest = job->root;
+        job->root = NULL;
+
+        return 0;
+}
+
+/**
+ * Asks job to stop. Reading and parsing notice within a chunk of the file or
+ * a few dozen elements, and the job then finishes with SROC_ERRCANCELED
+ * without calling its callback
+ */
+void sroc_load_cancel(struct sroc_load_job *job)
+{
+        atomic_store_explicit(&job->canceled, true, memory_order_relaxed);
+}
+
+/**
+ * Lets go of job, canceling it if it is still running. Never blocks, a
+ * running job is freed by its thread once it notices. A root which was not
+ * collected is destroyed
+ */
+void sroc_load_release(struct sroc_load_job *job)
+{
+        if (job == NULL) {
+                return;
+        }
+
+        sroc_load_cancel(job);
+        release_reference(job);
+}
@@ -0,0 +1,292 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <errno.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "object.h"
+#include "scan.h"
+#include "sroc.h"
+#include "string_helper.h"
+
+// Smallest lookup of a large object, twice SROC_SMALL_OBJECT rounded up
+#define MIN_OBJECT_SLOTS 32
+
+static size_t align_up(size_t offset, size_t alignment)
+{
+        return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+/**
+ * Returns the first slot to probe for key in the lookup of a large object.
+ * Objects built at run time have a seed of 0 and place key by its keyed hash,
+ * objects generated by sroc-compile by hash, the hash_bytes of key
+ */
+static inline size_t first_slot(const struct sroc_object *object,
+                                const char *key, uint64_t hash)
+{
+        if (object->seed != 0) {
+                return (size_t)hash_mix(hash ^ object->seed) & object->mask;
+        }
+
+        return (size_t)hash_keyed(key, strlen(key)) & object->mask;
+}
+
+/**
+ * Returns the position of the field with the given key, or -1 if there is
+ * none. hash must be hash_bytes of the key
+ */
+int64_t object_find(const struct sroc_object *object, const char *key,
+                    uint64_t hash)
+{
+        if (object->slots == NULL) {
+                unsigned int matches
+                        = scan_kernels.small_matches(object->hashes, hash)
+                          & ((1u << object->length) - 1);
+
+                while (matches != 0) {
+                        size_t position = (size_t)__builtin_ctz(matches);
+
+                        if (strcmp(object->fields[position].key, key) == 0) {
+                                return (int64_t)position;
+                        }
+
+                        matches &= matches - 1;
+                }
+
+                return -1;
+        }
+
+        size_t slot = first_slot(object, key, hash);
+        size_t position;
+
+        while ((position = object->slots[slot]) != SROC_EMPTY_SLOT) {
+                if (object->hashes[position] == hash
+                    && strcmp(object->fields[position].key, key) == 0) {
+                        return (int64_t)position;
+                }
+
+                slot = (slot + 1) & object->mask;
+        }
+
+        return -1;
+}
+
+/**
+ * Places every field of a large object into its lookup. Returns false if two
+ * fields share a key
+ */
+static bool fill_slots(struct sroc_object *object)
+{
+        for (size_t i = 0; i <= object->mask; ++i) {
+                object->slots[i] = SROC_EMPTY_SLOT;
+        }
+
+        for (size_t i = 0; i < object->length; ++i) {
+                const char *key = object->fields[i].key;
+                size_t slot = first_slot(object, key, object->hashes[i]);
+                size_t position;
+
+                while ((position = object->slots[slot]) != SROC_EMPTY_SLOT) {
+                        if (object->hashes[position] == object->hashes[i]
+                            && strcmp(object->fields[position].key, key)
+                                       == 0) {
+                                return false;
+                        }
+
+                        slot = (slot + 1) & object->mask;
+                }
+
+                object->slots[slot] = i;
+        }
+
+        return true;
+}
+
+/**
+ * Returns true if two fields of a small object share a key
+ */
+static bool has_duplicate_keys(const struct sroc_object *object)
+{
+        for (size_t i = 1; i < object->length; ++i) {
+                int64_t first = object_find(
+                        object, object->fields[i].key, object->hashes[i]);
+
+                if (first != (int64_t)i) {
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+/**
+ * Builds an object out of the fields collected by the parser with a single
+ * allocation laid out as the object, its fields, the key hashes, the lookup
+ * of a large object and finally the text of the keys and string values.
+ *
+ * Nested arrays and objects are taken over by the new object. On failure
+ * NULL is returned, errno is EINVAL when two fields share a key and nothing
+ * is taken over
+ */
+struct sroc_object *object_create(const struct pending_field *fields,
+                                  size_t length)
+{
+        bool small = length <= SROC_SMALL_OBJECT;
+        size_t hash_count = small ? SROC_SMALL_OBJECT : length;
+        size_t slot_count = 0;
+        size_t text_length = 0;
+
+        if (!small) {
+                slot_count = MIN_OBJECT_SLOTS;
+
+                while (slot_count < length * 2) {
+                        slot_count *= 2;
+                }
+        }
+
+        for (size_t i = 0; i < length; ++i) {
+                text_length += fields[i].key.n + 1;
+
+                if (fields[i].value.type == SROC_STRING) {
+                        text_length += fields[i].string_length + 1;
+                }
+        }
+
+        size_t fields_offset = align_up(sizeof(struct sroc_object),
+                                        alignof(struct sroc_field));
+        size_t hashes_offset
+                = align_up(fields_offset + length * sizeof(struct sroc_field),
+                           alignof(uint64_t));
+        size_t slots_offset
+                = align_up(hashes_offset + hash_count * sizeof(uint64_t),
+                           alignof(size_t));
+        size_t text_offset = slots_offset + slot_count * sizeof(size_t);
+        char *block = malloc(text_offset + text_length);
+
+        if (block == NULL) {
+                errno = ENOMEM;
+
+                return NULL;
+        }
+
+        struct sroc_object *object = (struct sroc_object *)block;
+        char *text = block + text_offset;
+
+        object->length = length;
+        object->fields = (struct sroc_field *)(block + fields_offset);
+        object->hashes = (uint64_t *)(block + hashes_offset);
+        object->mask = small ? 0 : slot_count - 1;
+        object->slots = small ? NULL : (size_t *)(block + slots_offset);
+        object->seed = 0;
+
+        for (size_t i = 0; i < length; ++i) {
+                struct sroc_field *field = &object->fields[i];
+
+                field->key = text;
+                memcpy(text, fields[i].key.p, fields[i].key.n);
+                text[fields[i].key.n] = '\0';
+                text += fields[i].key.n + 1;
+
+                object->hashes[i] = hash_bytes(field->key, fields[i].key.n);
+                field->value = fields[i].value;
+
+                if (field->value.type == SROC_STRING) {
+                        field->value.string = text;
+                        text += span_unescape(&fields[i].string, text) + 1;
+                }
+        }
+
+        for (size_t i = length; i < hash_count; ++i) {
+                object->hashes[i] = 0;
+        }
+
+        if (small ? has_duplicate_keys(object) : !fill_slots(object)) {
+                free(block);
+                errno = EINVAL;
+
+                return NULL;
+        }
+
+        return object;
+}
+
+static void destroy_contents(const struct sroc_value *value)
+{
+        if (value->type == SROC_ARRAY) {
+                sroc_destroy_array(value->array);
+        } else if (value->type == SROC_OBJECT) {
+                sroc_destroy_object(value->object);
+        }
+}
+
+/**
+ * Destroys the nested arrays and objects of fields which never made it into
+ * an object
+ */
+void object_destroy_pending(const struct pending_field *fields,
+                            size_t length)
+{
+        for (size_t i = 0; i < length; ++i) {
+                destroy_contents(&fields[i].value);
+        }
+}
+
+/**
+ * Destroys an object along with everything nested in it. Keys and strings
+ * live in the allocation of the object itself
+ */
+void sroc_destroy_object(struct sroc_object *object)
+{
+        for (size_t i = 0; i < object->length; ++i) {
+                destroy_contents(&object->fields[i].value);
+        }
+
+        free(object);
+}
+
+/**
+ * Finds the value of the field with the given key
+ */
+int sroc_object_get(const struct sroc_object *object, const char *key,
+                    const struct sroc_value **dest)
+{
+        int64_t position
+                = object_find(object, key, hash_bytes(key, strlen(key)));
+
+        if (position < 0) {
+                return SROC_ERRNOKEY;
+        }
+
+        *dest = &object->fields[position].value;
+
+        return 0;
+}
+
+/**
+ * Points cursor at every field of object in file order
+ */
+void sroc_iter_fields(const struct sroc_object *object,
+                      struct sroc_field_cursor *cursor)
+{
+        cursor->next = object->fields;
+        cursor->end = object->fields + object->length;
+}
+
+/**
+ * Returns the next field of the cursor, or NULL once it is exhausted
+ */
+const struct sroc_field *sroc_next_field(struct sroc_field_cursor *cursor)
+{
+        if (cursor->next == cursor->end) {
+                return NULL;
+        }
+
+        return cursor->next++;
+}
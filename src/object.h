@@ -0,0 +1,31 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sroc.h"
+#include "string_helper.h"
+
+/**
+ * A field of an object which is still being parsed. key points into the parse
+ * buffer. String values are kept as their raw text and only decoded once the
+ * object is built, straight into its allocation, so value.string is unset
+ * until then
+ */
+struct pending_field {
+        struct sroc_span key;
+        struct sroc_span string;
+        size_t string_length;
+        struct sroc_value value;
+};
+
+struct sroc_object *object_create(const struct pending_field *fields,
+                                  size_t length);
+void object_destroy_pending(const struct pending_field *fields,
+                            size_t length);
+int64_t object_find(const struct sroc_object *object, const char *key,
+                    uint64_t hash);
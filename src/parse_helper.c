@@ -2,46 +2,106 @@
 // Licensed under BSD-3-Clause
 // Refer to the license.txt file included in the root of the project
 
-#include <ctype.h>
 #include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "parse_helper.h"
+#include "scan.h"
 #include "sroc.h"
 
+/**
+ * Classification of every byte value. Only ASCII is ever classified, so the
+ * result does not depend on the current locale and bytes of UTF-8 sequences
+ * are always UNKNOWN
+ */
+static const unsigned char token_table[256] = {
+        ['A'] = ALPHA_CHAR,
+        ['B'] = ALPHA_CHAR,
+        ['C'] = ALPHA_CHAR,
+        ['D'] = ALPHA_CHAR,
+        ['E'] = ALPHA_CHAR,
+        ['F'] = ALPHA_CHAR,
+        ['G'] = ALPHA_CHAR,
+        ['H'] = ALPHA_CHAR,
+        ['I'] = ALPHA_CHAR,
+        ['J'] = ALPHA_CHAR,
+        ['K'] = ALPHA_CHAR,
+        ['L'] = ALPHA_CHAR,
+        ['M'] = ALPHA_CHAR,
+        ['N'] = ALPHA_CHAR,
+        ['O'] = ALPHA_CHAR,
+        ['P'] = ALPHA_CHAR,
+        ['Q'] = ALPHA_CHAR,
+        ['R'] = ALPHA_CHAR,
+        ['S'] = ALPHA_CHAR,
+        ['T'] = ALPHA_CHAR,
+        ['U'] = ALPHA_CHAR,
+        ['V'] = ALPHA_CHAR,
+        ['W'] = ALPHA_CHAR,
+        ['X'] = ALPHA_CHAR,
+        ['Y'] = ALPHA_CHAR,
+        ['Z'] = ALPHA_CHAR,
+        ['a'] = ALPHA_CHAR,
+        ['b'] = ALPHA_CHAR,
+        ['c'] = ALPHA_CHAR,
+        ['d'] = ALPHA_CHAR,
+        ['e'] = ALPHA_CHAR,
+        ['f'] = ALPHA_CHAR,
+        ['g'] = ALPHA_CHAR,
+        ['h'] = ALPHA_CHAR,
+        ['i'] = ALPHA_CHAR,
+        ['j'] = ALPHA_CHAR,
+        ['k'] = ALPHA_CHAR,
+        ['l'] = ALPHA_CHAR,
+        ['m'] = ALPHA_CHAR,
+        ['n'] = ALPHA_CHAR,
+        ['o'] = ALPHA_CHAR,
+        ['p'] = ALPHA_CHAR,
+        ['q'] = ALPHA_CHAR,
+        ['r'] = ALPHA_CHAR,
+        ['s'] = ALPHA_CHAR,
+        ['t'] = ALPHA_CHAR,
+        ['u'] = ALPHA_CHAR,
+        ['v'] = ALPHA_CHAR,
+        ['w'] = ALPHA_CHAR,
+        ['x'] = ALPHA_CHAR,
+        ['y'] = ALPHA_CHAR,
+        ['z'] = ALPHA_CHAR,
+        ['0'] = NUMERIC_CHAR,
+        ['1'] = NUMERIC_CHAR,
+        ['2'] = NUMERIC_CHAR,
+        ['3'] = NUMERIC_CHAR,
+        ['4'] = NUMERIC_CHAR,
+        ['5'] = NUMERIC_CHAR,
+        ['6'] = NUMERIC_CHAR,
+        ['7'] = NUMERIC_CHAR,
+        ['8'] = NUMERIC_CHAR,
+        ['9'] = NUMERIC_CHAR,
+        [' '] = WHITESPACE,
+        ['\t'] = WHITESPACE,
+        ['\r'] = WHITESPACE,
+        ['\n'] = NEW_LINE,
+        [']'] = CLOSE_BRACKET,
+        ['{'] = OPEN_BRACE,
+        ['}'] = CLOSE_BRACE,
+        [':'] = COLON,
+        [';'] = COMMENT_START,
+        ['#'] = COMMENT_START,
+        [','] = COMMA,
+        ['='] = EQUAL,
+        ['\\'] = ESCAPE,
+        ['-'] = NEGATIVE,
+        ['['] = OPEN_BRACKET,
+        ['.'] = PERIOD,
+        ['"'] = QUOTE,
+        ['_'] = UNDERSCORE,
+};
+
 enum token_type char_to_token(char input)
 {
-        if (isalpha(input)) {
-                return ALPHA_CHAR;
-        }
-
-        if (isdigit(input)) {
-                return NUMERIC_CHAR;
-        }
-
-        switch (input) {
-        case ']':
-                return CLOSE_BRACKET;
-        case ';':
-        case '#':
-                return COMMENT_START;
-        case ',':
-                return COMMA;
-        case '=':
-                return EQUAL;
-        case '\\':
-                return ESCAPE;
-        case '-':
-                return NEGATIVE;
-        case '[':
-                return OPEN_BRACKET;
-        case '.':
-                return PERIOD;
-        case '"':
-                return QUOTE;
-        default:
-                return UNKNOWN;
-        }
+        return (enum token_type)token_table[(unsigned char)input];
 }
 
 struct parser_context *init_parser(void)
@@ -54,17 +114,321 @@ struct parser_context *init_parser(void)
                 return NULL;
         }
 
-        context->buffer = NULL;
+        context->fields = NULL;
+        context->fields_capacity = 0;
+        context->canceled = NULL;
+#if defined(SROC_NO_INTERN)
+        context->intern = false;
+#else
+        context->intern = true;
+#endif
+        context->strings = NULL;
+        parser_set_limits(context, NULL);
+        parser_reset(context, NULL, 0);
+
+        return context;
+}
+
+static size_t limit_or_max(size_t limit)
+{
+        return (limit == 0) ? SIZE_MAX : limit;
+}
+
+/**
+ * Sets the limits every following parse with context is held to. Fields of
+ * limits left at 0, or every field when limits is NULL, are not limited
+ */
+void parser_set_limits(struct parser_context *context,
+                       const struct sroc_limits *limits)
+{
+        struct sroc_limits none = {0};
+
+        if (limits == NULL) {
+                limits = &none;
+        }
+
+        context->limits.max_bytes = limit_or_max(limits->max_bytes);
+        context->limits.max_depth = limit_or_max(limits->max_depth);
+        context->limits.max_items = limit_or_max(limits->max_items);
+        context->limits.max_string_length
+                = limit_or_max(limits->max_string_length);
+        context->limits.max_alloc_bytes = limit_or_max(limits->max_alloc_bytes);
+        context->limits.deadline_ns = limits->deadline_ns;
+}
+
+/**
+ * Returns the sroc_error describing why the last parse with context failed
+ */
+int parser_error(const struct parser_context *context)
+{
+        if (context->error != 0) {
+                return context->error;
+        }
+
+        return (errno == ENOMEM) ? SROC_ERRNOMEM : SROC_ERRINVAL;
+}
+
+/**
+ * Points context at the start of a new buffer
+ */
+void parser_reset(struct parser_context *context, const char *buffer,
+                  size_t length)
+{
+        context->buffer = buffer;
+        context->length = length;
         context->pos = 0;
         context->line_num = 0;
         context->col_num = 0;
         context->current_value = NULL;
         context->current_table = NULL;
-
-        return context;
+        context->depth = 0;
+        context->elements = 0;
+        context->allocated = 0;
+        context->clock_countdown = 1;
+        context->error = 0;
+        context->fields_length = 0;
 }
 
 void destroy_parser_context(struct parser_context *context)
 {
+        free(context->fields);
         free(context);
 }
+
+bool parser_at_end(const struct parser_context *context)
+{
+        return context->pos >= context->length;
+}
+
+/**
+ * Returns the character under the cursor, or a null terminator once the end
+ * of the buffer has been reached
+ */
+char parser_peek(const struct parser_context *context)
+{
+        if (parser_at_end(context)) {
+                return '\0';
+        }
+
+        return context->buffer[context->pos];
+}
+
+/**
+ * Moves the cursor count characters forward while keeping the line and column
+ * numbers in sync with the buffer
+ */
+void parser_advance(struct parser_context *context, size_t count)
+{
+        size_t end = context->pos + count;
+
+        if (end > context->length) {
+                end = context->length;
+        }
+
+        while (context->pos < end) {
+                const char *newline = memchr(context->buffer + context->pos,
+                                             '\n',
+                                             end - context->pos);
+
+                if (newline == NULL) {
+                        context->col_num += end - context->pos;
+                        context->pos = end;
+
+                        break;
+                }
+
+                ++context->line_num;
+                context->col_num = 0;
+                context->pos = (size_t)(newline - context->buffer) + 1;
+        }
+}
+
+/**
+ * Skips spaces and tabs but stops at a new line, since new lines terminate
+ * items
+ */
+void parser_skip_whitespace(struct parser_context *context)
+{
+        size_t start = context->pos;
+
+        if (start < context->length
+            && char_to_token(context->buffer[start]) == WHITESPACE) {
+                context->pos += scan_kernels.skip_blanks(
+                        context->buffer + start, context->length - start);
+        }
+
+        context->col_num += context->pos - start;
+}
+
+/**
+ * Skips everything up to and including the next new line character
+ */
+void parser_skip_line(struct parser_context *context)
+{
+        const char *newline = memchr(context->buffer + context->pos,
+                                     '\n',
+                                     context->length - context->pos);
+
+        if (newline == NULL) {
+                context->col_num += context->length - context->pos;
+                context->pos = context->length;
+
+                return;
+        }
+
+        ++context->line_num;
+        context->col_num = 0;
+        context->pos = (size_t)(newline - context->buffer) + 1;
+}
+
+/**
+ * Skips whitespace, new lines and comments until the start of the next
+ * meaningful token
+ */
+void parser_skip_blank_lines(struct parser_context *context)
+{
+        while (!parser_at_end(context)) {
+                parser_skip_whitespace(context);
+
+                enum token_type token = char_to_token(parser_peek(context));
+
+                if (token == NEW_LINE || token == COMMENT_START) {
+                        parser_skip_line(context);
+                } else {
+                        break;
+                }
+        }
+}
+
+/**
+ * Returns the length of the key which starts at the cursor. Keys are made of
+ * letters, digits, underscores and dashes. Section names may also contain
+ * periods
+ */
+size_t parser_scan_key(const struct parser_context *context, bool allow_period)
+{
+        size_t end = context->pos;
+
+        while (end < context->length) {
+                enum token_type token = char_to_token(context->buffer[end]);
+
+                if (token != ALPHA_CHAR && token != NUMERIC_CHAR
+                    && token != UNDERSCORE && token != NEGATIVE
+                    && !(allow_period && token == PERIOD)) {
+                        break;
+                }
+
+                ++end;
+        }
+
+        return end - context->pos;
+}
+
+/**
+ * Checks that key is a whole key as parser_scan_key would read it, so that
+ * anything emitted or built from it can be parsed back
+ */
+bool parser_is_valid_key(const char *key, bool allow_period)
+{
+        if (key == NULL || *key == '\0') {
+                return false;
+        }
+
+        for (; *key != '\0'; ++key) {
+                enum token_type token = char_to_token(*key);
+
+                if (token != ALPHA_CHAR && token != NUMERIC_CHAR
+                    && token != UNDERSCORE && token != NEGATIVE
+                    && !(allow_period && token == PERIOD)) {
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+/**
+ * Returns the offset of the first section header line at or after from, or
+ * length if there is none. from must be the start of a line outside of any
+ * value. Strings, comments and the brackets and braces of array and object
+ * values are skipped so only real headers are found, without building any
+ * values
+ */
+size_t parser_find_section(const char *buffer, size_t length, size_t from)
+{
+        size_t pos = from;
+        size_t line_begin = from;
+        size_t depth = 0;
+        bool line_start = true;
+
+        while (pos < length) {
+                char ch = buffer[pos];
+
+                if (line_start) {
+                        if (char_to_token(ch) == WHITESPACE) {
+                                ++pos;
+
+                                continue;
+                        }
+
+                        line_start = false;
+
+                        if (ch == '[' && depth == 0) {
+                                return line_begin;
+                        }
+                }
+
+                pos += scan_kernels.find_section_stop(buffer + pos,
+                                                      length - pos);
+
+                if (pos == length) {
+                        return length;
+                }
+
+                ch = buffer[pos];
+
+                switch (ch) {
+                case '\n':
+                        line_start = true;
+                        line_begin = pos + 1;
+                        break;
+                case '"':
+                        for (++pos; pos < length && buffer[pos] != '"'; ++pos) {
+                                if (buffer[pos] == '\\') {
+                                        ++pos;
+                                }
+                        }
+                        break;
+                case '#':
+                case ';': {
+                        const char *newline
+                                = memchr(buffer + pos, '\n', length - pos);
+
+                        if (newline == NULL) {
+                                return length;
+                        }
+
+                        // Let the new line be handled by the next iteration
+                        pos = (size_t)(newline - buffer);
+
+                        continue;
+                }
+                case '[':
+                case '{':
+                        ++depth;
+                        break;
+                case ']':
+                case '}':
+                        if (depth > 0) {
+                                --depth;
+                        }
+                        break;
+                default:
+                        break;
+                }
+
+                ++pos;
+        }
+
+        return length;
+}
@@ -4,34 +4,92 @@
 
 #pragma once
 
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "object.h"
 #include "sroc.h"
 
+// UNKNOWN is zero so it is the default of the classification table
 enum token_type {
+        UNKNOWN,
         ALPHA_CHAR,
+        CLOSE_BRACE,
         CLOSE_BRACKET,
+        COLON,
         COMMENT_START,
         COMMA,
         EQUAL,
         ESCAPE,
         NEGATIVE,
+        NEW_LINE,
         NUMERIC_CHAR,
+        OPEN_BRACE,
         OPEN_BRACKET,
         PERIOD,
         QUOTE,
-        UNKNOWN,
+        UNDERSCORE,
+        WHITESPACE,
 };
 
+/**
+ * limits always holds real bounds, with the largest value standing in for a
+ * limit which is not set, so checking one is a single comparison. depth,
+ * elements and allocated count what the current parse has used so far and
+ * error is the sroc_error of the limit which stopped it, or 0
+ *
+ * fields collects the fields of the objects being parsed, with the innermost
+ * object at the end. It is kept between parses so it rarely has to grow
+ *
+ * canceled, when set, is checked along with the deadline and stops the parse
+ * with SROC_ERRCANCELED once it becomes true
+ *
+ * intern makes each parse give its root an intern table, which strings points
+ * to while the parse runs. It is on unless the library is built with
+ * SROC_NO_INTERN, which the benchmarks use for comparison
+ */
 struct parser_context {
         const char *buffer;
+        size_t length;
         size_t pos;
         size_t line_num;
         size_t col_num;
         const struct sroc_value *current_value;
         const struct sroc_table *current_table;
+        struct sroc_limits limits;
+        size_t depth;
+        size_t elements;
+        size_t allocated;
+        size_t clock_countdown;
+        int error;
+        struct pending_field *fields;
+        size_t fields_length;
+        size_t fields_capacity;
+        const _Atomic bool *canceled;
+        bool intern;
+        struct sroc_intern *strings;
 };
 
 enum token_type char_to_token(char input);
 
 struct parser_context *init_parser(void);
 void destroy_parser_context(struct parser_context *context);
+void parser_reset(struct parser_context *context, const char *buffer,
+                  size_t length);
+void parser_set_limits(struct parser_context *context,
+                       const struct sroc_limits *limits);
+int parser_error(const struct parser_context *context);
+
+// Implemented in sroc.c
+struct sroc_root *parser_parse(struct parser_context *context,
+                               const char *buffer, size_t length);
 
+bool parser_at_end(const struct parser_context *context);
+char parser_peek(const struct parser_context *context);
+void parser_advance(struct parser_context *context, size_t count);
+void parser_skip_whitespace(struct parser_context *context);
+void parser_skip_line(struct parser_context *context);
+void parser_skip_blank_lines(struct parser_context *context);
+size_t parser_scan_key(const struct parser_context *context, bool allow_period);
+bool parser_is_valid_key(const char *key, bool allow_period);
+size_t parser_find_section(const char *buffer, size_t length, size_t from);
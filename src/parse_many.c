@@ -0,0 +1,308 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "parse_helper.h"
+#include "sroc.h"
+
+/**
+ * Range of paths [next, end) owned by one worker. The owner takes paths from
+ * the front one at a time and idle workers steal half of what is left from the
+ * back
+ */
+struct work_queue {
+        pthread_mutex_t lock;
+        size_t next;
+        size_t end;
+};
+
+struct batch {
+        const char *const *paths;
+        struct sroc_parse_result *results;
+        struct work_queue *queues;
+        size_t nthreads;
+};
+
+/**
+ * Everything a worker reuses from one file to the next. The read buffer only
+ * ever grows, so once it fits the largest file no more allocations are made
+ * for reading
+ */
+struct worker {
+        struct batch *batch;
+        size_t id;
+        pthread_t thread;
+        char *buffer;
+        size_t capacity;
+        struct parser_context *context;
+};
+
+static bool take_own(struct work_queue *queue, size_t *position)
+{
+        bool found = false;
+
+        pthread_mutex_lock(&queue->lock);
+
+        if (queue->next < queue->end) {
+                *position = queue->next++;
+                found = true;
+        }
+
+        pthread_mutex_unlock(&queue->lock);
+
+        return found;
+}
+
+/**
+ * Moves the back half of the next non empty range into the thief's queue and
+ * hands out its first position. Returns false once every queue is empty
+ */
+static bool steal(struct batch *batch, size_t thief, size_t *position)
+{
+        for (size_t i = 1; i < batch->nthreads; ++i) {
+                struct work_queue *victim
+                        = &batch->queues[(thief + i) % batch->nthreads];
+                size_t start = 0;
+                size_t end = 0;
+
+                pthread_mutex_lock(&victim->lock);
+
+                if (victim->next < victim->end) {
+                        size_t remaining = victim->end - victim->next;
+
+                        end = victim->end;
+                        start = end - (remaining + 1) / 2;
+                        victim->end = start;
+                }
+
+                pthread_mutex_unlock(&victim->lock);
+
+                if (start == end) {
+                        continue;
+                }
+
+                struct work_queue *own = &batch->queues[thief];
+
+                pthread_mutex_lock(&own->lock);
+                own->next = start + 1;
+                own->end = end;
+                pthread_mutex_unlock(&own->lock);
+
+                *position = start;
+
+                return true;
+        }
+
+        return false;
+}
+
+/**
+ * Reads the whole file at path into the worker's buffer. Returns the number
+ * of bytes read or a negative sroc_error
+ */
+static int64_t read_path(struct worker *worker, const char *path)
+{
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+        if (fd < 0) {
+                return SROC_ERRIO;
+        }
+
+        struct stat info;
+
+        if (fstat(fd, &info) != 0 || info.st_size < 0) {
+                close(fd);
+
+                return SROC_ERRIO;
+        }
+
+        size_t size = (size_t)info.st_size;
+
+        if (size > worker->capacity) {
+                char *buffer = realloc(worker->buffer, size);
+
+                if (buffer == NULL) {
+                        close(fd);
+
+                        return SROC_ERRNOMEM;
+                }
+
+                worker->buffer = buffer;
+                worker->capacity = size;
+        }
+
+        size_t length = 0;
+
+        while (length < size) {
+                ssize_t bytes
+                        = read(fd, worker->buffer + length, size - length);
+
+                if (bytes < 0 && errno == EINTR) {
+                        continue;
+                }
+
+                if (bytes < 0) {
+                        close(fd);
+
+                        return SROC_ERRIO;
+                }
+
+                if (bytes == 0) {
+                        // The file shrank after fstat
+                        break;
+                }
+
+                length += (size_t)bytes;
+        }
+
+        close(fd);
+
+        return (int64_t)length;
+}
+
+static void parse_path(struct worker *worker, size_t position)
+{
+        struct sroc_parse_result *result = &worker->batch->results[position];
+        int64_t length = read_path(worker, worker->batch->paths[position]);
+
+        result->root = NULL;
+
+        if (length < 0) {
+                result->error = (int)length;
+
+                return;
+        }
+
+        result->root
+                = parser_parse(worker->context, worker->buffer, (size_t)length);
+
+        result->error = (result->root != NULL) ? 0
+                                               : parser_error(worker->context);
+}
+
+static void *run_worker(void *data)
+{
+        struct worker *worker = data;
+        struct batch *batch = worker->batch;
+        size_t position;
+
+        while (take_own(&batch->queues[worker->id], &position)
+               || steal(batch, worker->id, &position)) {
+                parse_path(worker, position);
+        }
+
+        return NULL;
+}
+
+static size_t default_thread_count(void)
+{
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+
+        return (online > 0) ? (size_t)online : 1;
+}
+
+/**
+ * Parses the files at paths[0..count) on nthreads threads, including the
+ * calling one. Passing 0 for nthreads uses one thread per online CPU.
+ *
+ * Every path gets a result in the same position of results, so a file which
+ * fails to open, read or parse does not stop the rest of the batch. Each
+ * worker reads into a buffer it reuses for all of its files and keeps a
+ * single parser context, and idle workers steal from busy ones so a few large
+ * files do not leave cores idle.
+ *
+ * Returns the number of files which failed, or SROC_ERRNOMEM if the batch
+ * could not be started at all
+ */
+int sroc_parse_many(const char *const *paths, size_t count, size_t nthreads,
+                    struct sroc_parse_result *results)
+{
+        if (nthreads == 0) {
+                nthreads = default_thread_count();
+        }
+
+        if (nthreads > count) {
+                nthreads = (count > 0) ? count : 1;
+        }
+
+        struct work_queue *queues = calloc(nthreads, sizeof(struct work_queue));
+        struct worker *workers = calloc(nthreads, sizeof(struct worker));
+        struct batch batch = {
+                .paths = paths,
+                .results = results,
+                .queues = queues,
+                .nthreads = nthreads,
+        };
+        size_t contexts = 0;
+        int result = SROC_ERRNOMEM;
+
+        if (queues == NULL || workers == NULL) {
+                goto cleanup;
+        }
+
+        for (; contexts < nthreads; ++contexts) {
+                workers[contexts].context = init_parser();
+
+                if (workers[contexts].context == NULL) {
+                        goto cleanup;
+                }
+        }
+
+        // Every worker starts with an even share, stealing evens out the rest
+        for (size_t i = 0; i < nthreads; ++i) {
+                pthread_mutex_init(&queues[i].lock, NULL);
+                queues[i].next = count * i / nthreads;
+                queues[i].end = count * (i + 1) / nthreads;
+                workers[i].batch = &batch;
+                workers[i].id = i;
+        }
+
+        size_t started = 1;
+
+        for (; started < nthreads; ++started) {
+                // A worker which cannot be started just has its share stolen
+                if (pthread_create(&workers[started].thread,
+                                   NULL,
+                                   run_worker,
+                                   &workers[started])
+                    != 0) {
+                        break;
+                }
+        }
+
+        run_worker(&workers[0]);
+
+        for (size_t i = 1; i < started; ++i) {
+                pthread_join(workers[i].thread, NULL);
+        }
+
+        for (size_t i = 0; i < nthreads; ++i) {
+                pthread_mutex_destroy(&queues[i].lock);
+                free(workers[i].buffer);
+        }
+
+        result = 0;
+
+        for (size_t i = 0; i < count; ++i) {
+                if (results[i].error != 0) {
+                        ++result;
+                }
+        }
+
+cleanup:
+        for (size_t i = 0; i < contexts; ++i) {
+                destroy_parser_context(workers[i].context);
+        }
+
+        free(workers);
+        free(queues);
+
+        return result;
+}
@@ -0,0 +1,379 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "access.h"
+#include "derive.h"
+#include "hash.h"
+#include "index.h"
+#include "intern.h"
+#include "sroc.h"
+
+/**
+ * Hashes name as sroc_hash_key does. Returns key, or NULL when name is NULL
+ */
+static const struct sroc_key *make_key(struct sroc_key *key, const char *name)
+{
+        if (name == NULL) {
+                return NULL;
+        }
+
+        key->name = name;
+        key->hash = hash_bytes(name, strlen(name));
+
+        return key;
+}
+
+/**
+ * Finds the value stored under key. If section is NULL the items outside of
+ * any section are searched. Sections a derived root does not hold itself are
+ * read from its base
+ */
+static int find_value(const struct sroc_root *root,
+                      const struct sroc_key *section,
+                      const struct sroc_key *key, struct sroc_value **dest)
+{
+        const struct sroc_root *owner = root;
+        struct sroc_item *const *items = root->items;
+        const size_t *index = root->items_index;
+        const struct sroc_lookup *lookup = &root->items_lookup;
+        size_t length = root->items_length;
+        int64_t table_position = -1;
+
+        if (section != NULL) {
+                struct sroc_table *table = derive_find_section(
+                        root, section, &owner, &table_position);
+
+                if (table == NULL) {
+                        return SROC_ERRNOSECTION;
+                }
+
+                items = table->items;
+                index = table->index;
+                lookup = &table->lookup;
+                length = table->size;
+        }
+
+        int64_t position = index_search_hashed(items,
+                                               index,
+                                               lookup,
+                                               length,
+                                               index_item_key,
+                                               key->name,
+                                               key->hash);
+
+        if (position < 0) {
+                return SROC_ERRNOKEY;
+        }
+
+#if defined(SROC_TRACK_ACCESS)
+        // Root items a derived root still shares are counted for its base
+        if (section == NULL && derive_shares_root_items(root)) {
+                owner = root->base;
+        }
+
+        if (owner->access != NULL) {
+                access_count(owner->access,
+                             (size_t)(table_position + 1),
+                             (size_t)position);
+        }
+#endif
+
+        *dest = items[position]->value;
+
+        return 0;
+}
+
+static int find_typed_value(const struct sroc_root *root, const char *section,
+                            const char *key, enum sroc_type type,
+                            struct sroc_value **dest)
+{
+        struct sroc_key section_key;
+        struct sroc_key item_key;
+        int result = find_value(root,
+                                make_key(&section_key, section),
+                                make_key(&item_key, key),
+                                dest);
+
+        if (result != 0) {
+                return result;
+        }
+
+        if ((*dest)->type != type) {
+                return SROC_ERRTYPE;
+        }
+
+        return 0;
+}
+
+int sroc_get_section(const struct sroc_root *root, const char *section,
+                     struct sroc_table **dest)
+{
+        const struct sroc_root *owner;
+        int64_t position;
+        struct sroc_key key;
+        struct sroc_table *table = derive_find_section(
+                root, make_key(&key, section), &owner, &position);
+
+        if (table == NULL) {
+                return SROC_ERRNOSECTION;
+        }
+
+        *dest = table;
+
+        return 0;
+}
+
+/**
+ * Hashes name the way the lookups of the library do, so a key can be hashed
+ * once and passed to sroc_read_value any number of times
+ */
+uint64_t sroc_hash_key(const char *name, size_t length)
+{
+        return hash_bytes(name, length);
+}
+
+/**
+ * Fills dest like sroc_hash_key, but points it at the copy of name interned by
+ * root when there is one. Lookups find interned keys by comparing pointers, so
+ * reading with such a key skips comparing the names. dest stays valid only as
+ * long as root does.
+ *
+ * Returns 0, or SROC_ERRNOKEY when root has no interned copy of name, in
+ * which case dest holds name itself and can still be read with
+ */
+int sroc_intern_key(const struct sroc_root *root, const char *name,
+                    struct sroc_key *dest)
+{
+        size_t length = strlen(name);
+        const struct sroc_intern *strings = root->strings;
+        const char *interned = NULL;
+
+        // Derived roots hold no interned strings of their own
+        if (strings == NULL && root->base != NULL) {
+                strings = root->base->strings;
+        }
+
+        if (strings != NULL) {
+                interned = intern_find(strings, name, length);
+        }
+
+        dest->name = (interned != NULL) ? interned : name;
+        dest->hash = hash_bytes(name, length);
+
+        return (interned != NULL) ? 0 : SROC_ERRNOKEY;
+}
+
+/**
+ * Finds the value of key in section, or outside of any section when section
+ * is NULL, using the hashes stored in the keys instead of hashing the names.
+ * Returns 0 and sets dest, SROC_ERRNOSECTION or SROC_ERRNOKEY
+ */
+int sroc_read_value(const struct sroc_root *root,
+                    const struct sroc_key *section, const struct sroc_key *key,
+                    const struct sroc_value **dest)
+{
+        struct sroc_value *value;
+        int result = find_value(root, section, key, &value);
+
+        if (result == 0) {
+                *dest = value;
+        }
+
+        return result;
+}
+
+int sroc_read_array(const struct sroc_root *root, const char *section,
+                    const char *key, struct sroc_array **dest, size_t *length)
+{
+        struct sroc_value *value;
+        int result = find_typed_value(root, section, key, SROC_ARRAY, &value);
+
+        if (result != 0) {
+                return result;
+        }
+
+        *dest = value->array;
+        *length = value->array->length;
+
+        return 0;
+}
+
+int sroc_read_bool(const struct sroc_root *root, const char *section,
+                   const char *key, bool *dest)
+{
+        struct sroc_value *value;
+        int result = find_typed_value(root, section, key, SROC_BOOL, &value);
+
+        if (result != 0) {
+                return result;
+        }
+
+        *dest = value->boolean;
+
+        return 0;
+}
+
+int sroc_read_number(const struct sroc_root *root, const char *section,
+                     const char *key, int64_t *dest)
+{
+        struct sroc_value *value;
+        int result = find_typed_value(root, section, key, SROC_NUMBER, &value);
+
+        if (result != 0) {
+                return result;
+        }
+
+        *dest = value->number;
+
+        return 0;
+}
+
+int sroc_read_string(const struct sroc_root *root, const char *section,
+                     const char *key, const char **dest)
+{
+        struct sroc_value *value;
+        int result = find_typed_value(root, section, key, SROC_STRING, &value);
+
+        if (result != 0) {
+                return result;
+        }
+
+        *dest = value->string;
+
+        return 0;
+}
+
+int sroc_read_object(const struct sroc_root *root, const char *section,
+                     const char *key, struct sroc_object **dest)
+{
+        struct sroc_value *value;
+        int result = find_typed_value(root, section, key, SROC_OBJECT, &value);
+
+        if (result != 0) {
+                return result;
+        }
+
+        *dest = value->object;
+
+        return 0;
+}
+
+/**
+ * Points next and end at the range of the section index of root whose names
+ * begin with prefix
+ */
+static void find_prefix_range(const struct sroc_root *root, const char *prefix,
+                              const size_t **next, const size_t **end)
+{
+        const size_t *index = root->sections_index;
+        size_t length = (index == NULL) ? 0 : root->sections_length;
+        size_t start = index_lower_bound(
+                root->sections, index, length, index_table_key, prefix);
+        size_t stop = index_prefix_end(
+                root->sections, index, start, length, index_table_key, prefix);
+
+        *next = (index == NULL) ? NULL : index + start;
+        *end = (index == NULL) ? NULL : index + stop;
+}
+
+/**
+ * Points cursor at every section whose name begins with prefix, in sorted
+ * order. Finding the range takes two binary searches over the section index,
+ * and two more over the index of the base of a derived root
+ */
+void sroc_iter_sections_prefix(const struct sroc_root *root,
+                               const char *prefix,
+                               struct sroc_section_cursor *cursor)
+{
+        cursor->sections = root->sections;
+        find_prefix_range(root, prefix, &cursor->next, &cursor->end);
+        cursor->base_sections = NULL;
+        cursor->base_next = NULL;
+        cursor->base_end = NULL;
+
+        if (root->base != NULL) {
+                cursor->base_sections = root->base->sections;
+                find_prefix_range(root->base,
+                                  prefix,
+                                  &cursor->base_next,
+                                  &cursor->base_end);
+        }
+}
+
+/**
+ * Returns the next section of the cursor, or NULL once it is exhausted. The
+ * ranges of a derived root and its base are merged, and a section both hold
+ * is returned once, as the copy of the derived root
+ */
+struct sroc_table *sroc_next_section(struct sroc_section_cursor *cursor)
+{
+        if (cursor->base_next == cursor->base_end) {
+                if (cursor->next == cursor->end) {
+                        return NULL;
+                }
+
+                return cursor->sections[*cursor->next++];
+        }
+
+        struct sroc_table *base = cursor->base_sections[*cursor->base_next];
+
+        if (cursor->next == cursor->end) {
+                ++cursor->base_next;
+
+                return base;
+        }
+
+        struct sroc_table *own = cursor->sections[*cursor->next];
+        int order = strcmp(own->key, base->key);
+
+        if (order > 0) {
+                ++cursor->base_next;
+
+                return base;
+        }
+
+        if (order == 0) {
+                ++cursor->base_next;
+        }
+
+        ++cursor->next;
+
+        return own;
+}
+
+/**
+ * Points cursor at every item of table whose key begins with prefix, in sorted
+ * order
+ */
+void sroc_iter_keys_prefix(const struct sroc_table *table, const char *prefix,
+                           struct sroc_key_cursor *cursor)
+{
+        const size_t *index = table->index;
+        size_t length = (index == NULL) ? 0 : table->size;
+        size_t start = index_lower_bound(
+                table->items, index, length, index_item_key, prefix);
+        size_t end = index_prefix_end(
+                table->items, index, start, length, index_item_key, prefix);
+
+        cursor->items = table->items;
+        cursor->next = (index == NULL) ? NULL : index + start;
+        cursor->end = (index == NULL) ? NULL : index + end;
+}
+
+/**
+ * Returns the next item of the cursor, or NULL once it is exhausted
+ */
+struct sroc_item *sroc_next_key(struct sroc_key_cursor *cursor)
+{
+        if (cursor->next == cursor->end) {
+                return NULL;
+        }
+
+        return cursor->items[*cursor->next++];
+}
@@ -0,0 +1,367 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "index.h"
+#include "parse_helper.h"
+#include "sroc.h"
+
+#define EMPTY_SLOT SIZE_MAX
+
+/**
+ * Open addressed index from span hash to the position of a section inside of
+ * the old root
+ */
+struct section_index {
+        size_t mask;
+        size_t *slots;
+        bool *taken;
+};
+
+/**
+ * Returns the first slot to probe for a section whose text hashed to hash.
+ * Span fingerprints are keyed per process, so their low bits spread alone
+ */
+static size_t section_slot(const struct section_index *index, uint64_t hash)
+{
+        return (size_t)hash & index->mask;
+}
+
+static int init_section_index(struct section_index *index,
+                              const struct sroc_root *root)
+{
+        size_t capacity = 8;
+
+        while (capacity < root->sections_length * 2) {
+                capacity *= 2;
+        }
+
+        index->mask = capacity - 1;
+        index->slots = malloc(capacity * sizeof(size_t));
+        index->taken = calloc(root->sections_length + 1, sizeof(bool));
+
+        if (index->slots == NULL || index->taken == NULL) {
+                free(index->slots);
+                free(index->taken);
+                errno = ENOMEM;
+
+                return -1;
+        }
+
+        for (size_t i = 0; i < capacity; ++i) {
+                index->slots[i] = EMPTY_SLOT;
+        }
+
+        for (size_t i = 0; i < root->sections_length; ++i) {
+                size_t slot = section_slot(index, root->sections[i]->hash);
+
+                while (index->slots[slot] != EMPTY_SLOT) {
+                        slot = (slot + 1) & index->mask;
+                }
+
+                index->slots[slot] = i;
+        }
+
+        return 0;
+}
+
+static void destroy_section_index(struct section_index *index)
+{
+        free(index->slots);
+        free(index->taken);
+}
+
+/**
+ * Finds an old section whose source text hashed to hash and which has not
+ * already been claimed by an earlier span. Returns EMPTY_SLOT if none exists
+ */
+static size_t claim_section(struct section_index *index,
+                            const struct sroc_root *root, uint64_t hash)
+{
+        size_t slot = section_slot(index, hash);
+
+        while (index->slots[slot] != EMPTY_SLOT) {
+                size_t position = index->slots[slot];
+
+                if (!index->taken[position]
+                    && root->sections[position]->hash == hash) {
+                        index->taken[position] = true;
+
+                        return position;
+                }
+
+                slot = (slot + 1) & index->mask;
+        }
+
+        return EMPTY_SLOT;
+}
+
+/**
+ * Splits the buffer into section spans. starts receives the offset of every
+ * section header line and must be freed by the caller
+ */
+static int64_t find_section_starts(const char *buffer, size_t length,
+                                   size_t **starts)
+{
+        size_t count = 0;
+        size_t capacity = 64;
+        size_t pos = parser_find_section(buffer, length, 0);
+
+        *starts = malloc(capacity * sizeof(size_t));
+
+        if (*starts == NULL) {
+                errno = ENOMEM;
+
+                return -1;
+        }
+
+        while (pos < length) {
+                if (count == capacity) {
+                        size_t *grown = realloc(
+                                *starts, capacity * 2 * sizeof(size_t));
+
+                        if (grown == NULL) {
+                                free(*starts);
+                                errno = ENOMEM;
+
+                                return -1;
+                        }
+
+                        *starts = grown;
+                        capacity *= 2;
+                }
+
+                (*starts)[count++] = pos;
+
+                // Headers never span lines so scanning resumes on the next
+                const char *newline = memchr(buffer + pos, '\n', length - pos);
+
+                if (newline == NULL) {
+                        break;
+                }
+
+                pos = parser_find_section(
+                        buffer, length, (size_t)(newline - buffer) + 1);
+        }
+
+        return (int64_t)count;
+}
+
+/**
+ * Parses a single changed span into a temporary root which the caller steals
+ * the items or section out of. sections is the number of sections the span
+ * holds, 0 for the items before the first section and 1 for any other span
+ */
+static struct sroc_root *parse_span(const char *span, size_t length,
+                                    size_t sections)
+{
+        struct parser_context *context = init_parser();
+
+        if (context == NULL) {
+                return NULL;
+        }
+
+        // Changed spans keep their own copies. The new root only takes over
+        // the intern table of the old one, so reloads never grow it
+        context->intern = false;
+
+        struct sroc_root *root = parser_parse(context, span, length);
+
+        destroy_parser_context(context);
+
+        if (root != NULL && root->sections_length != sections) {
+                // The span did not hold the sections the scanner found, which
+                // means the scanner and the parser disagree on the input
+                sroc_destroy_root(root);
+                errno = EINVAL;
+
+                return NULL;
+        }
+
+        return root;
+}
+
+/**
+ * Parses buffer into a new root, reusing every section of old_root whose source
+ * text is unchanged. Each section span is fingerprinted and only the spans
+ * whose fingerprint is not found in old_root are parsed, so the cost of a
+ * reload is a single scan of the buffer plus the cost of parsing the changes.
+ *
+ * On success old_root is consumed: unchanged sections are moved into the new
+ * root and the rest are destroyed. On failure NULL is returned and old_root is
+ * left untouched. Derived roots and the bases of derived roots cannot be
+ * reparsed and fail with EINVAL.
+ *
+ * Keys and strings of the changed spans are not interned, only those parsed
+ * along with old_root are
+ */
+struct sroc_root *sroc_reparse(struct sroc_root *old_root, const char *buffer,
+                               size_t length)
+{
+        if (old_root == NULL) {
+                return sroc_parse_buffer(buffer, length);
+        }
+
+        if (old_root->base != NULL
+            || __atomic_load_n(&old_root->references, __ATOMIC_RELAXED) != 0) {
+                errno = EINVAL;
+
+                return NULL;
+        }
+
+        size_t *starts;
+        int64_t count = find_section_starts(buffer, length, &starts);
+
+        if (count < 0) {
+                return NULL;
+        }
+
+        size_t sections_length = (size_t)count;
+        size_t root_end = (sections_length > 0) ? starts[0] : length;
+        struct section_index index;
+        struct sroc_root *root = sroc_create_root();
+
+        if (root == NULL) {
+                free(starts);
+
+                return NULL;
+        }
+
+        if (init_section_index(&index, old_root) != 0) {
+                free(starts);
+                free(root);
+
+                return NULL;
+        }
+
+        // Tracks which of the new sections were parsed here rather than
+        // moved, so a failure only destroys what this call created
+        bool *parsed_here = calloc(sections_length + 1, sizeof(bool));
+
+        root->sections
+                = calloc(sections_length + 1, sizeof(struct sroc_table *));
+        root->sections_capacity = sections_length + 1;
+
+        if (root->sections == NULL || parsed_here == NULL) {
+                errno = ENOMEM;
+
+                goto cleanup_and_err;
+        }
+
+        struct sroc_root *root_items = NULL;
+        uint64_t items_hash = hash_keyed(buffer, root_end);
+
+        if (items_hash != old_root->items_hash) {
+                root_items = parse_span(buffer, root_end, 0);
+
+                if (root_items == NULL) {
+                        goto cleanup_and_err;
+                }
+        }
+
+        for (size_t i = 0; i < sections_length; ++i) {
+                size_t start = starts[i];
+                size_t end = (i + 1 < sections_length) ? starts[i + 1] : length;
+                uint64_t hash = hash_keyed(buffer + start, end - start);
+                size_t position = claim_section(&index, old_root, hash);
+
+                if (position != EMPTY_SLOT) {
+                        root->sections[root->sections_length++]
+                                = old_root->sections[position];
+
+                        continue;
+                }
+
+                struct sroc_root *parsed
+                        = parse_span(buffer + start, end - start, 1);
+
+                if (parsed == NULL) {
+                        sroc_destroy_root(root_items);
+
+                        goto cleanup_and_err;
+                }
+
+                parsed_here[root->sections_length] = true;
+                root->sections[root->sections_length++] = parsed->sections[0];
+                parsed->sections_length = 0;
+                sroc_destroy_root(parsed);
+        }
+
+        // The moved and parsed sections are already indexed, so this only
+        // indexes the list of sections
+        if (index_build(root->sections,
+                        root->sections_length,
+                        root->sections_capacity,
+                        index_table_key,
+                        &root->sections_index)
+                    != 0
+            || index_build_lookup(root->sections,
+                                  root->sections_length,
+                                  index_table_key,
+                                  &root->sections_lookup)
+                       != 0) {
+                sroc_destroy_root(root_items);
+
+                goto cleanup_and_err;
+        }
+
+        // Nothing can fail from here on, so ownership moves over
+        struct sroc_root *items_owner
+                = (root_items == NULL) ? old_root : root_items;
+
+        root->items = items_owner->items;
+        root->items_index = items_owner->items_index;
+        root->items_lookup = items_owner->items_lookup;
+        root->items_length = items_owner->items_length;
+        root->items_capacity = items_owner->items_capacity;
+        root->items_hash = items_hash;
+        items_owner->items = NULL;
+        items_owner->items_index = NULL;
+        index_init_lookup(&items_owner->items_lookup);
+        items_owner->items_length = 0;
+        items_owner->items_capacity = 0;
+        sroc_destroy_root(root_items);
+
+        size_t remaining = 0;
+
+        for (size_t i = 0; i < old_root->sections_length; ++i) {
+                if (!index.taken[i]) {
+                        old_root->sections[remaining++] = old_root->sections[i];
+                }
+        }
+
+        old_root->sections_length = remaining;
+        root->strings = old_root->strings;
+        old_root->strings = NULL;
+        sroc_destroy_root(old_root);
+
+        destroy_section_index(&index);
+        free(parsed_here);
+        free(starts);
+
+        return root;
+
+cleanup_and_err:
+        for (size_t i = 0; i < root->sections_length; ++i) {
+                if (parsed_here[i]) {
+                        sroc_destroy_table(root->sections[i]);
+                }
+        }
+
+        free(parsed_here);
+        free(root->sections);
+        free(root->sections_index);
+        index_destroy_lookup(&root->sections_lookup);
+        free(root);
+        destroy_section_index(&index);
+        free(starts);
+
+        return NULL;
+}
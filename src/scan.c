@@ -0,0 +1,721 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scan.h"
+#include "sroc.h"
+
+#if defined(SCAN_X86)
+#include <immintrin.h>
+#endif
+
+#include "utf8.h"
+
+// Names a tier to use instead of the best one the CPU runs
+#define SCAN_TIER_ENV "SROC_SIMD"
+
+enum scan_kind {
+        SKIP_BLANKS,
+        SKIP_SPACE,
+        COUNT_DIGITS,
+        FIND_STRING_STOP,
+        FIND_SECTION_STOP,
+};
+
+/**
+ * Whether a scan of kind stops at ch. The vector kernels below test the same
+ * characters a block at a time
+ */
+static inline bool scan_stops_at(unsigned char ch, enum scan_kind kind)
+{
+        switch (kind) {
+        case SKIP_BLANKS:
+                return ch != ' ' && ch != '\t' && ch != '\r';
+        case SKIP_SPACE:
+                return ch != ' ' && (ch < '\t' || ch > '\r');
+        case COUNT_DIGITS:
+                return ch < '0' || ch > '9';
+        case FIND_STRING_STOP:
+                return ch == '"' || ch == '\\' || ch == '\n';
+        default:
+                return ch == '\n' || ch == '"' || ch == '#' || ch == ';'
+                       || ch == '[' || ch == ']' || ch == '{' || ch == '}';
+        }
+}
+
+static inline size_t scan_scalar(const char *buffer, size_t length,
+                                 enum scan_kind kind)
+{
+        size_t pos = 0;
+
+        while (pos < length
+               && !scan_stops_at((unsigned char)buffer[pos], kind)) {
+                ++pos;
+        }
+
+        return pos;
+}
+
+/**
+ * Returns the length of buffer without the trailing run a scan of kind
+ * accepts
+ */
+static inline size_t scan_back_scalar(const char *buffer, size_t length,
+                                      enum scan_kind kind)
+{
+        while (length > 0
+               && !scan_stops_at((unsigned char)buffer[length - 1], kind)) {
+                --length;
+        }
+
+        return length;
+}
+
+static size_t skip_blanks_scalar(const char *buffer, size_t length)
+{
+        return scan_scalar(buffer, length, SKIP_BLANKS);
+}
+
+static size_t skip_space_scalar(const char *buffer, size_t length)
+{
+        return scan_scalar(buffer, length, SKIP_SPACE);
+}
+
+static size_t skip_space_back_scalar(const char *buffer, size_t length)
+{
+        return scan_back_scalar(buffer, length, SKIP_SPACE);
+}
+
+static size_t count_digits_scalar(const char *buffer, size_t length)
+{
+        return scan_scalar(buffer, length, COUNT_DIGITS);
+}
+
+static size_t find_string_stop_scalar(const char *buffer, size_t length)
+{
+        return scan_scalar(buffer, length, FIND_STRING_STOP);
+}
+
+static size_t find_section_stop_scalar(const char *buffer, size_t length)
+{
+        return scan_scalar(buffer, length, FIND_SECTION_STOP);
+}
+
+static unsigned int small_matches_scalar(const uint64_t *hashes, uint64_t hash)
+{
+        unsigned int matches = 0;
+
+        for (unsigned int i = 0; i < SROC_SMALL_OBJECT; ++i) {
+                matches |= (unsigned int)(hashes[i] == hash) << i;
+        }
+
+        return matches;
+}
+
+#if defined(SCAN_X86)
+
+/*
+ * Every vector kernel turns a block into a bit mask of the bytes the scan
+ * stops at and returns the position of the lowest set bit, or of the highest
+ * one when scanning back. The SSE2 and AVX2 kernels finish the last partial
+ * block with the scalar loop, the AVX-512 ones with a masked load, which
+ * never touches the bytes past the end
+ */
+
+SSE2_TARGET static inline __m128i sse2_eq(__m128i block, char ch)
+{
+        return _mm_cmpeq_epi8(block, _mm_set1_epi8(ch));
+}
+
+SSE2_TARGET static inline unsigned sse2_stops(__m128i block,
+                                              enum scan_kind kind)
+{
+        __m128i hits;
+
+        switch (kind) {
+        case SKIP_BLANKS:
+                hits = _mm_or_si128(
+                        _mm_or_si128(sse2_eq(block, ' '), sse2_eq(block, '\t')),
+                        sse2_eq(block, '\r'));
+
+                return ~(unsigned)_mm_movemask_epi8(hits) & 0xFFFF;
+        case SKIP_SPACE: {
+                // Tab to carriage return are the bytes at most 4 above '\t'
+                __m128i offset = _mm_sub_epi8(block, _mm_set1_epi8('\t'));
+
+                hits = _mm_or_si128(
+                        _mm_cmpeq_epi8(_mm_min_epu8(offset,
+                                                    _mm_set1_epi8('\r' - '\t')),
+                                       offset),
+                        sse2_eq(block, ' '));
+
+                return ~(unsigned)_mm_movemask_epi8(hits) & 0xFFFF;
+        }
+        case COUNT_DIGITS: {
+                // Digits are the bytes at most 9 above '0' once it wraps
+                __m128i offset = _mm_sub_epi8(block, _mm_set1_epi8('0'));
+
+                hits = _mm_cmpeq_epi8(
+                        _mm_min_epu8(offset, _mm_set1_epi8(9)), offset);
+
+                return ~(unsigned)_mm_movemask_epi8(hits) & 0xFFFF;
+        }
+        case FIND_STRING_STOP:
+                hits = _mm_or_si128(
+                        _mm_or_si128(sse2_eq(block, '"'), sse2_eq(block, '\\')),
+                        sse2_eq(block, '\n'));
+
+                return (unsigned)_mm_movemask_epi8(hits);
+        default:
+                hits = _mm_or_si128(
+                        _mm_or_si128(
+                                _mm_or_si128(sse2_eq(block, '\n'),
+                                             sse2_eq(block, '"')),
+                                _mm_or_si128(sse2_eq(block, '#'),
+                                             sse2_eq(block, ';'))),
+                        _mm_or_si128(
+                                _mm_or_si128(sse2_eq(block, '['),
+                                             sse2_eq(block, ']')),
+                                _mm_or_si128(sse2_eq(block, '{'),
+                                             sse2_eq(block, '}'))));
+
+                return (unsigned)_mm_movemask_epi8(hits);
+        }
+}
+
+SSE2_TARGET static inline size_t scan_sse2(const char *buffer, size_t length,
+                                           enum scan_kind kind)
+{
+        size_t pos = 0;
+
+        for (; length - pos >= 16; pos += 16) {
+                unsigned stops = sse2_stops(
+                        _mm_loadu_si128((const __m128i *)(buffer + pos)), kind);
+
+                if (stops != 0) {
+                        return pos + (size_t)__builtin_ctz(stops);
+                }
+        }
+
+        return pos + scan_scalar(buffer + pos, length - pos, kind);
+}
+
+SSE2_TARGET static inline size_t scan_back_sse2(const char *buffer,
+                                                size_t length,
+                                                enum scan_kind kind)
+{
+        for (; length >= 16; length -= 16) {
+                const __m128i *block = (const __m128i *)(buffer + length - 16);
+                unsigned stops = sse2_stops(_mm_loadu_si128(block), kind);
+
+                if (stops != 0) {
+                        return length - 16 + 32 - (size_t)__builtin_clz(stops);
+                }
+        }
+
+        return scan_back_scalar(buffer, length, kind);
+}
+
+SSE2_TARGET static size_t skip_blanks_sse2(const char *buffer, size_t length)
+{
+        return scan_sse2(buffer, length, SKIP_BLANKS);
+}
+
+SSE2_TARGET static size_t skip_space_sse2(const char *buffer, size_t length)
+{
+        return scan_sse2(buffer, length, SKIP_SPACE);
+}
+
+SSE2_TARGET static size_t skip_space_back_sse2(const char *buffer,
+                                               size_t length)
+{
+        return scan_back_sse2(buffer, length, SKIP_SPACE);
+}
+
+SSE2_TARGET static size_t count_digits_sse2(const char *buffer, size_t length)
+{
+        return scan_sse2(buffer, length, COUNT_DIGITS);
+}
+
+SSE2_TARGET static size_t find_string_stop_sse2(const char *buffer,
+                                                size_t length)
+{
+        return scan_sse2(buffer, length, FIND_STRING_STOP);
+}
+
+SSE2_TARGET static size_t find_section_stop_sse2(const char *buffer,
+                                                 size_t length)
+{
+        return scan_sse2(buffer, length, FIND_SECTION_STOP);
+}
+
+/**
+ * SSE2 has no 64 bit compare, so the halves are compared and each is anded
+ * with the other, leaving a hash all ones only when both of them are equal
+ */
+SSE2_TARGET static unsigned int small_matches_sse2(const uint64_t *hashes,
+                                                   uint64_t hash)
+{
+        __m128i needle = _mm_set1_epi64x((long long)hash);
+        unsigned int matches = 0;
+
+        for (unsigned int i = 0; i < SROC_SMALL_OBJECT / 2; ++i) {
+                __m128i block = _mm_loadu_si128((const __m128i *)hashes + i);
+                __m128i equal = _mm_cmpeq_epi32(block, needle);
+
+                // 0xB1 swaps the two halves of each hash
+                equal = _mm_and_si128(equal,
+                                      _mm_shuffle_epi32(equal, 0xB1));
+                matches |= (unsigned int)_mm_movemask_pd(
+                                   _mm_castsi128_pd(equal))
+                           << (2 * i);
+        }
+
+        return matches;
+}
+
+AVX2_TARGET static inline __m256i avx2_eq(__m256i block, char ch)
+{
+        return _mm256_cmpeq_epi8(block, _mm256_set1_epi8(ch));
+}
+
+AVX2_TARGET static inline uint32_t avx2_stops(__m256i block,
+                                              enum scan_kind kind)
+{
+        __m256i hits;
+
+        switch (kind) {
+        case SKIP_BLANKS:
+                hits = _mm256_or_si256(_mm256_or_si256(avx2_eq(block, ' '),
+                                                       avx2_eq(block, '\t')),
+                                       avx2_eq(block, '\r'));
+
+                return ~(uint32_t)_mm256_movemask_epi8(hits);
+        case SKIP_SPACE: {
+                __m256i offset = _mm256_sub_epi8(block, _mm256_set1_epi8('\t'));
+
+                hits = _mm256_or_si256(
+                        _mm256_cmpeq_epi8(
+                                _mm256_min_epu8(offset,
+                                                _mm256_set1_epi8('\r' - '\t')),
+                                offset),
+                        avx2_eq(block, ' '));
+
+                return ~(uint32_t)_mm256_movemask_epi8(hits);
+        }
+        case COUNT_DIGITS: {
+                __m256i offset = _mm256_sub_epi8(block, _mm256_set1_epi8('0'));
+
+                hits = _mm256_cmpeq_epi8(
+                        _mm256_min_epu8(offset, _mm256_set1_epi8(9)), offset);
+
+                return ~(uint32_t)_mm256_movemask_epi8(hits);
+        }
+        case FIND_STRING_STOP:
+                hits = _mm256_or_si256(_mm256_or_si256(avx2_eq(block, '"'),
+                                                       avx2_eq(block, '\\')),
+                                       avx2_eq(block, '\n'));
+
+                return (uint32_t)_mm256_movemask_epi8(hits);
+        default:
+                hits = _mm256_or_si256(
+                        _mm256_or_si256(
+                                _mm256_or_si256(avx2_eq(block, '\n'),
+                                                avx2_eq(block, '"')),
+                                _mm256_or_si256(avx2_eq(block, '#'),
+                                                avx2_eq(block, ';'))),
+                        _mm256_or_si256(
+                                _mm256_or_si256(avx2_eq(block, '['),
+                                                avx2_eq(block, ']')),
+                                _mm256_or_si256(avx2_eq(block, '{'),
+                                                avx2_eq(block, '}'))));
+
+                return (uint32_t)_mm256_movemask_epi8(hits);
+        }
+}
+
+AVX2_TARGET static inline size_t scan_avx2(const char *buffer, size_t length,
+                                           enum scan_kind kind)
+{
+        size_t pos = 0;
+
+        for (; length - pos >= 32; pos += 32) {
+                uint32_t stops = avx2_stops(
+                        _mm256_loadu_si256((const __m256i *)(buffer + pos)),
+                        kind);
+
+                if (stops != 0) {
+                        return pos + (size_t)__builtin_ctz(stops);
+                }
+        }
+
+        return pos + scan_scalar(buffer + pos, length - pos, kind);
+}
+
+AVX2_TARGET static inline size_t scan_back_avx2(const char *buffer,
+                                                size_t length,
+                                                enum scan_kind kind)
+{
+        for (; length >= 32; length -= 32) {
+                uint32_t stops = avx2_stops(
+                        _mm256_loadu_si256(
+                                (const __m256i *)(buffer + length - 32)),
+                        kind);
+
+                if (stops != 0) {
+                        return length - (size_t)__builtin_clz(stops);
+                }
+        }
+
+        return scan_back_scalar(buffer, length, kind);
+}
+
+AVX2_TARGET static size_t skip_blanks_avx2(const char *buffer, size_t length)
+{
+        return scan_avx2(buffer, length, SKIP_BLANKS);
+}
+
+AVX2_TARGET static size_t skip_space_avx2(const char *buffer, size_t length)
+{
+        return scan_avx2(buffer, length, SKIP_SPACE);
+}
+
+AVX2_TARGET static size_t skip_space_back_avx2(const char *buffer,
+                                               size_t length)
+{
+        return scan_back_avx2(buffer, length, SKIP_SPACE);
+}
+
+AVX2_TARGET static size_t count_digits_avx2(const char *buffer, size_t length)
+{
+        return scan_avx2(buffer, length, COUNT_DIGITS);
+}
+
+AVX2_TARGET static size_t find_string_stop_avx2(const char *buffer,
+                                                size_t length)
+{
+        return scan_avx2(buffer, length, FIND_STRING_STOP);
+}
+
+AVX2_TARGET static size_t find_section_stop_avx2(const char *buffer,
+                                                 size_t length)
+{
+        return scan_avx2(buffer, length, FIND_SECTION_STOP);
+}
+
+AVX2_TARGET static unsigned int small_matches_avx2(const uint64_t *hashes,
+                                                   uint64_t hash)
+{
+        __m256i needle = _mm256_set1_epi64x((long long)hash);
+        unsigned int matches = 0;
+
+        for (unsigned int i = 0; i < SROC_SMALL_OBJECT / 4; ++i) {
+                __m256i block
+                        = _mm256_loadu_si256((const __m256i *)hashes + i);
+                __m256i equal = _mm256_cmpeq_epi64(block, needle);
+
+                matches |= (unsigned int)_mm256_movemask_pd(
+                                   _mm256_castsi256_pd(equal))
+                           << (4 * i);
+        }
+
+        return matches;
+}
+
+AVX512_TARGET static inline __mmask64 avx512_eq(__m512i block, char ch)
+{
+        return _mm512_cmpeq_epi8_mask(block, _mm512_set1_epi8(ch));
+}
+
+AVX512_TARGET static inline uint64_t avx512_stops(__m512i block,
+                                                  enum scan_kind kind)
+{
+        switch (kind) {
+        case SKIP_BLANKS:
+                return ~(uint64_t)(avx512_eq(block, ' ')
+                                   | avx512_eq(block, '\t')
+                                   | avx512_eq(block, '\r'));
+        case SKIP_SPACE:
+                return ~(uint64_t)(_mm512_cmple_epu8_mask(
+                                           _mm512_sub_epi8(
+                                                   block,
+                                                   _mm512_set1_epi8('\t')),
+                                           _mm512_set1_epi8('\r' - '\t'))
+                                   | avx512_eq(block, ' '));
+        case COUNT_DIGITS:
+                return ~(uint64_t)_mm512_cmple_epu8_mask(
+                        _mm512_sub_epi8(block, _mm512_set1_epi8('0')),
+                        _mm512_set1_epi8(9));
+        case FIND_STRING_STOP:
+                return avx512_eq(block, '"') | avx512_eq(block, '\\')
+                       | avx512_eq(block, '\n');
+        default:
+                return avx512_eq(block, '\n') | avx512_eq(block, '"')
+                       | avx512_eq(block, '#') | avx512_eq(block, ';')
+                       | avx512_eq(block, '[') | avx512_eq(block, ']')
+                       | avx512_eq(block, '{') | avx512_eq(block, '}');
+        }
+}
+
+AVX512_TARGET static inline size_t scan_avx512(const char *buffer,
+                                               size_t length,
+                                               enum scan_kind kind)
+{
+        size_t pos = 0;
+
+        for (; length - pos >= 64; pos += 64) {
+                uint64_t stops = avx512_stops(
+                        _mm512_loadu_si512((const void *)(buffer + pos)), kind);
+
+                if (stops != 0) {
+                        return pos + (size_t)__builtin_ctzll(stops);
+                }
+        }
+
+        if (pos == length) {
+                return length;
+        }
+
+        uint64_t rest = (UINT64_C(1) << (length - pos)) - 1;
+        uint64_t stops
+                = avx512_stops(_mm512_maskz_loadu_epi8(rest, buffer + pos),
+                               kind)
+                  & rest;
+
+        if (stops != 0) {
+                return pos + (size_t)__builtin_ctzll(stops);
+        }
+
+        return length;
+}
+
+AVX512_TARGET static inline size_t scan_back_avx512(const char *buffer,
+                                                    size_t length,
+                                                    enum scan_kind kind)
+{
+        for (; length >= 64; length -= 64) {
+                const void *block = buffer + length - 64;
+                uint64_t stops
+                        = avx512_stops(_mm512_loadu_si512(block), kind);
+
+                if (stops != 0) {
+                        return length - (size_t)__builtin_clzll(stops);
+                }
+        }
+
+        if (length == 0) {
+                return 0;
+        }
+
+        uint64_t rest = (UINT64_C(1) << length) - 1;
+        uint64_t stops = avx512_stops(_mm512_maskz_loadu_epi8(rest, buffer),
+                                      kind)
+                         & rest;
+
+        if (stops != 0) {
+                return 64 - (size_t)__builtin_clzll(stops);
+        }
+
+        return 0;
+}
+
+AVX512_TARGET static size_t skip_blanks_avx512(const char *buffer,
+                                               size_t length)
+{
+        return scan_avx512(buffer, length, SKIP_BLANKS);
+}
+
+AVX512_TARGET static size_t skip_space_avx512(const char *buffer,
+                                              size_t length)
+{
+        return scan_avx512(buffer, length, SKIP_SPACE);
+}
+
+AVX512_TARGET static size_t skip_space_back_avx512(const char *buffer,
+                                                   size_t length)
+{
+        return scan_back_avx512(buffer, length, SKIP_SPACE);
+}
+
+AVX512_TARGET static size_t count_digits_avx512(const char *buffer,
+                                                size_t length)
+{
+        return scan_avx512(buffer, length, COUNT_DIGITS);
+}
+
+AVX512_TARGET static size_t find_string_stop_avx512(const char *buffer,
+                                                    size_t length)
+{
+        return scan_avx512(buffer, length, FIND_STRING_STOP);
+}
+
+AVX512_TARGET static size_t find_section_stop_avx512(const char *buffer,
+                                                     size_t length)
+{
+        return scan_avx512(buffer, length, FIND_SECTION_STOP);
+}
+
+AVX512_TARGET static unsigned int small_matches_avx512(const uint64_t *hashes,
+                                                       uint64_t hash)
+{
+        __m512i needle = _mm512_set1_epi64((long long)hash);
+        unsigned int matches = 0;
+
+        for (unsigned int i = 0; i < SROC_SMALL_OBJECT / 8; ++i) {
+                matches |= (unsigned int)_mm512_cmpeq_epi64_mask(
+                                   _mm512_loadu_si512((const void *)(hashes
+                                                                     + 8 * i)),
+                                   needle)
+                           << (8 * i);
+        }
+
+        return matches;
+}
+
+#endif
+
+static const struct scan_kernels tier_kernels[] = {
+        [SCAN_SCALAR] = {skip_blanks_scalar,
+                         skip_space_scalar,
+                         skip_space_back_scalar,
+                         count_digits_scalar,
+                         find_string_stop_scalar,
+                         find_section_stop_scalar,
+                         utf8_validate_scalar,
+                         small_matches_scalar},
+#if defined(SCAN_X86)
+        [SCAN_SSE2] = {skip_blanks_sse2,
+                       skip_space_sse2,
+                       skip_space_back_sse2,
+                       count_digits_sse2,
+                       find_string_stop_sse2,
+                       find_section_stop_sse2,
+                       utf8_validate_ssse3,
+                       small_matches_sse2},
+        [SCAN_AVX2] = {skip_blanks_avx2,
+                       skip_space_avx2,
+                       skip_space_back_avx2,
+                       count_digits_avx2,
+                       find_string_stop_avx2,
+                       find_section_stop_avx2,
+                       utf8_validate_avx2,
+                       small_matches_avx2},
+        [SCAN_AVX512] = {skip_blanks_avx512,
+                         skip_space_avx512,
+                         skip_space_back_avx512,
+                         count_digits_avx512,
+                         find_string_stop_avx512,
+                         find_section_stop_avx512,
+                         utf8_validate_avx512,
+                         small_matches_avx512},
+#endif
+};
+
+static const char *const tier_names[] = {
+        [SCAN_SCALAR] = "scalar",
+        [SCAN_SSE2] = "sse2",
+        [SCAN_AVX2] = "avx2",
+        [SCAN_AVX512] = "avx512",
+};
+
+// Scalar until the library is loaded, so the kernels always work
+struct scan_kernels scan_kernels = {skip_blanks_scalar,
+                                    skip_space_scalar,
+                                    skip_space_back_scalar,
+                                    count_digits_scalar,
+                                    find_string_stop_scalar,
+                                    find_section_stop_scalar,
+                                    utf8_validate_scalar,
+                                    small_matches_scalar};
+
+static enum scan_tier active_tier = SCAN_SCALAR;
+
+/**
+ * Returns the highest tier the CPU and operating system can run, asked of
+ * cpuid through the compiler
+ */
+enum scan_tier scan_supported_tier(void)
+{
+#if defined(SCAN_X86)
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx512f")
+            && __builtin_cpu_supports("avx512bw")) {
+                return SCAN_AVX512;
+        }
+
+        if (__builtin_cpu_supports("avx2")) {
+                return SCAN_AVX2;
+        }
+
+        if (__builtin_cpu_supports("sse2")) {
+                return SCAN_SSE2;
+        }
+#endif
+
+        return SCAN_SCALAR;
+}
+
+enum scan_tier scan_active_tier(void)
+{
+        return active_tier;
+}
+
+/**
+ * Switches every kernel to the variant of tier. Returns 0, or -1 when the CPU
+ * cannot run tier. This must not happen while another thread parses, so it is
+ * only done when the library is loaded and by the tests
+ */
+int scan_use_tier(enum scan_tier tier)
+{
+        if (tier > scan_supported_tier()) {
+                return -1;
+        }
+
+        struct scan_kernels kernels = tier_kernels[tier];
+
+#if defined(SCAN_X86)
+        // The 128 bit UTF-8 kernel looks bytes up with SSSE3 shuffles, which
+        // a few early x86-64 CPUs lack
+        if (tier == SCAN_SSE2 && !__builtin_cpu_supports("ssse3")) {
+                kernels.utf8_validate = utf8_validate_scalar;
+        }
+#endif
+
+        scan_kernels = kernels;
+        active_tier = tier;
+
+        return 0;
+}
+
+const char *scan_tier_name(enum scan_tier tier)
+{
+        return tier_names[tier];
+}
+
+/**
+ * Picks the highest tier the CPU runs once the library is loaded. SROC_SIMD
+ * set to the name of a lower tier picks that one instead, and a tier the CPU
+ * cannot run is ignored rather than crashing on the first parse
+ */
+__attribute__((constructor)) static void scan_init(void)
+{
+        enum scan_tier tier = scan_supported_tier();
+        const char *forced = getenv(SCAN_TIER_ENV);
+
+        if (forced != NULL) {
+                for (int i = SCAN_SCALAR; i <= (int)tier; ++i) {
+                        if (strcmp(forced, tier_names[i]) == 0) {
+                                tier = (enum scan_tier)i;
+
+                                break;
+                        }
+                }
+        }
+
+        scan_use_tier(tier);
+}
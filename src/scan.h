@@ -0,0 +1,67 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Vector code is only built for x86 compilers which can target single
+// functions at instruction sets beyond the baseline
+#if (defined(__x86_64__) || defined(__i386__))                                 \
+        && (defined(__GNUC__) || defined(__clang__))
+#define SCAN_X86 1
+
+#define SSE2_TARGET __attribute__((target("sse2")))
+#define SSSE3_TARGET __attribute__((target("ssse3")))
+#define AVX2_TARGET __attribute__((target("avx2")))
+#define AVX512_TARGET __attribute__((target("avx512f,avx512bw")))
+#endif
+
+/**
+ * Instruction set tiers the kernels are built for, in increasing
+ * order. Each tier needs everything the tiers before it need
+ */
+enum scan_tier {
+        SCAN_SCALAR,
+        SCAN_SSE2,
+        SCAN_AVX2,
+        SCAN_AVX512,
+};
+
+/**
+ * The kernels of one tier. Each scan returns the length of the leading run of
+ * buffer it accepts:
+ *
+ * - skip_blanks the spaces, tabs and carriage returns
+ * - skip_space the whitespace isspace accepts in the C locale
+ * - count_digits the decimal digits
+ * - find_string_stop everything but quotes, back slashes and new lines
+ * - find_section_stop everything parser_find_section can skip
+ * - utf8_validate the valid UTF-8, as utf8_validate_scalar does
+ *
+ * skip_space_back instead returns the length of buffer once its trailing
+ * whitespace is dropped. small_matches compares hash against the
+ * SROC_SMALL_OBJECT hashes of a small object and sets bit i of its result
+ * when hashes[i] is equal to it
+ */
+struct scan_kernels {
+        size_t (*skip_blanks)(const char *buffer, size_t length);
+        size_t (*skip_space)(const char *buffer, size_t length);
+        size_t (*skip_space_back)(const char *buffer, size_t length);
+        size_t (*count_digits)(const char *buffer, size_t length);
+        size_t (*find_string_stop)(const char *buffer, size_t length);
+        size_t (*find_section_stop)(const char *buffer, size_t length);
+        size_t (*utf8_validate)(const char *buffer, size_t length);
+        unsigned int (*small_matches)(const uint64_t *hashes, uint64_t hash);
+};
+
+// The kernels of the active tier, picked once when the library is loaded
+extern struct scan_kernels scan_kernels;
+
+enum scan_tier scan_supported_tier(void);
+enum scan_tier scan_active_tier(void);
+int scan_use_tier(enum scan_tier tier);
+const char *scan_tier_name(enum scan_tier tier);
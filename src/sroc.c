@@ -3,13 +3,24 @@
 // Refer to the license.txt file included in the root of the project
 
 #include <errno.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#include "access.h"
+#include "build.h"
+#include "derive.h"
+#include "hash.h"
+#include "index.h"
+#include "intern.h"
+#include "object.h"
 #include "parse_helper.h"
+#include "scan.h"
 #include "sroc.h"
 #include "string_helper.h"
+#include "utf8.h"
 
 static int64_t get_file_size(FILE *file)
 {
@@ -73,23 +84,890 @@ free_and_err:
         return -1;
 }
 
+static int push_root_item(struct sroc_root *root, struct sroc_item *item)
+{
+        if (root->items_length == root->items_capacity) {
+                struct sroc_item **items = build_grow_array(
+                        root->items,
+                        &root->items_capacity,
+                        sizeof(struct sroc_item *));
+
+                if (items == NULL) {
+                        return -1;
+                }
+
+                root->items = items;
+        }
+
+        root->items[root->items_length++] = item;
+
+        return 0;
+}
+
+static int push_root_section(struct sroc_root *root,
+                             struct sroc_table *section)
+{
+        if (root->sections_length == root->sections_capacity) {
+                struct sroc_table **sections = build_grow_array(
+                        root->sections,
+                        &root->sections_capacity,
+                        sizeof(struct sroc_table *));
+
+                if (sections == NULL) {
+                        return -1;
+                }
+
+                root->sections = sections;
+        }
+
+        root->sections[root->sections_length++] = section;
+
+        return 0;
+}
+
+static int push_table_item(struct sroc_table *table, struct sroc_item *item)
+{
+        if (table->size == table->capacity) {
+                struct sroc_item **items = build_grow_array(
+                        table->items,
+                        &table->capacity,
+                        sizeof(struct sroc_item *));
+
+                if (items == NULL) {
+                        return -1;
+                }
+
+                table->items = items;
+        }
+
+        table->items[table->size++] = item;
+
+        return 0;
+}
+
+static int push_array_value(struct sroc_array *array,
+                            struct sroc_value *value)
+{
+        if (array->length == array->capacity) {
+                struct sroc_value **items = build_grow_array(
+                        array->items,
+                        &array->capacity,
+                        sizeof(struct sroc_value *));
+
+                if (items == NULL) {
+                        return -1;
+                }
+
+                array->items = items;
+        }
+
+        array->items[array->length++] = value;
+
+        return 0;
+}
+
+/**
+ * Copies a key out of the parse buffer. The buffer is not required to be null
+ * terminated so the length must be known up front
+ */
+static char *copy_key(const char *start, size_t length)
+{
+        struct sroc_span key;
+
+        span_init(&key, start, length);
+
+        return span_dup(&key);
+}
+
+/**
+ * Stores length bytes of data as a key or string of the root being parsed.
+ * Short ones are interned so equal ones share a single copy, and interned
+ * tells which of the two happened
+ */
+static char *store_string(struct parser_context *context, const char *data,
+                          size_t length, bool *interned)
+{
+        *interned = context->strings != NULL && length <= INTERN_MAX_LENGTH;
+
+        if (*interned) {
+                return intern_span(context->strings, data, length);
+        }
+
+        return copy_key(data, length);
+}
+
+static int parse_error(void)
+{
+        errno = EINVAL;
+
+        return -1;
+}
+
+// Elements parsed between two reads of the clock when a deadline is set
+#define DEADLINE_INTERVAL 64
+
+// Memory an item or section adds to its list, sorted index and lookup
+#define ENTRY_OVERHEAD (sizeof(void *) + 3 * sizeof(size_t))
+
+// Memory an object field takes besides its key and string, counting its hash
+// and up to four lookup slots
+#define FIELD_OVERHEAD \
+        (sizeof(struct sroc_field) + sizeof(uint64_t) + 4 * sizeof(size_t))
+
+/**
+ * Fails the parse because a limit was exceeded. errno is EINVAL like for any
+ * other rejected input and the limit is kept for parser_error
+ */
+static int limit_error(struct parser_context *context, int error)
+{
+        context->error = error;
+        errno = EINVAL;
+
+        return -1;
+}
+
+static uint64_t monotonic_ns(void)
+{
+        struct timespec now;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * Adds bytes to the memory the tree is known to take. allocated never exceeds
+ * the limit, so the subtraction cannot wrap
+ */
+static int charge_bytes(struct parser_context *context, size_t bytes)
+{
+        if (bytes > context->limits.max_alloc_bytes - context->allocated) {
+                return limit_error(context, SROC_ERRMEMLIMIT);
+        }
+
+        context->allocated += bytes;
+
+        return 0;
+}
+
+/**
+ * Accounts for one more item, section or array value and the bytes it needs.
+ * Limits are checked once per element rather than per byte, and the deadline
+ * and cancellation only every DEADLINE_INTERVAL elements so the clock is
+ * rarely read
+ */
+static int charge_element(struct parser_context *context, size_t bytes)
+{
+        if (context->elements == context->limits.max_items) {
+                return limit_error(context, SROC_ERRITEMS);
+        }
+
+        ++context->elements;
+
+        if (--context->clock_countdown == 0) {
+                context->clock_countdown = DEADLINE_INTERVAL;
+
+                if (context->limits.deadline_ns != 0
+                    && monotonic_ns() >= context->limits.deadline_ns) {
+                        return limit_error(context, SROC_ERRTIMEOUT);
+                }
+
+                if (context->canceled != NULL
+                    && atomic_load_explicit(context->canceled,
+                                            memory_order_relaxed)) {
+                        return limit_error(context, SROC_ERRCANCELED);
+                }
+        }
+
+        return charge_bytes(context, bytes);
+}
+
+/**
+ * After an item or section header only whitespace and a comment may follow
+ * before the end of the line
+ */
+static int parse_end_of_line(struct parser_context *context)
+{
+        parser_skip_whitespace(context);
+
+        if (parser_at_end(context)) {
+                return 0;
+        }
+
+        enum token_type token = char_to_token(parser_peek(context));
+
+        if (token != NEW_LINE && token != COMMENT_START) {
+                return parse_error();
+        }
+
+        parser_skip_line(context);
+
+        return 0;
+}
+
+/**
+ * Scans a quoted string starting at the opening quote without decoding it.
+ * raw is set to the text between the quotes and length to the length of the
+ * string once escapes are removed. Anything following an escape character is
+ * taken literally, which allows quotes, back slashes and new lines inside of
+ * a string
+ */
+static int scan_string(struct parser_context *context, struct sroc_span *raw,
+                       size_t *length)
+{
+        size_t start = context->pos + 1;
+        size_t end = start;
+        size_t escapes = 0;
+
+        while (end < context->length) {
+                end += scan_kernels.find_string_stop(context->buffer + end,
+                                                     context->length - end);
+
+                if (end == context->length) {
+                        break;
+                }
+
+                char ch = context->buffer[end];
+
+                if (ch == '"') {
+                        break;
+                }
+
+                if (ch == '\\') {
+                        end += 2;
+                        ++escapes;
+                } else {
+                        // A new line
+                        return parse_error();
+                }
+        }
+
+        if (end >= context->length) {
+                // Unterminated string
+                return parse_error();
+        }
+
+        if (utf8_validate(context->buffer + start, end - start)
+            != end - start) {
+                return parse_error();
+        }
+
+        size_t decoded_length = end - start - escapes;
+
+        if (decoded_length > context->limits.max_string_length) {
+                return limit_error(context, SROC_ERRSTRLEN);
+        }
+
+        if (charge_bytes(context, decoded_length + 1) != 0) {
+                return -1;
+        }
+
+        span_init(raw, context->buffer + start, end - start);
+        *length = decoded_length;
+
+        parser_advance(context, end - context->pos + 1);
+
+        return 0;
+}
+
+/**
+ * Parses a quoted string starting at the opening quote into a new string, or
+ * into the interned copy of an equal one when it is short
+ */
+static int parse_string(struct parser_context *context, char **dest,
+                        bool *interned)
+{
+        struct sroc_span raw;
+        size_t length;
+
+        if (scan_string(context, &raw, &length) != 0) {
+                return -1;
+        }
+
+        if (context->strings != NULL && length <= INTERN_MAX_LENGTH) {
+                char decoded[INTERN_MAX_LENGTH + 1];
+                const char *data = raw.p;
+
+                // Only strings with escapes need decoding before the lookup
+                if (length != raw.n) {
+                        span_unescape(&raw, decoded);
+                        data = decoded;
+                }
+
+                *dest = store_string(context, data, length, interned);
+
+                return (*dest != NULL) ? 0 : -1;
+        }
+
+        *interned = false;
+
+        char *string = malloc(length + 1);
+
+        if (string == NULL) {
+                errno = ENOMEM;
+
+                return -1;
+        }
+
+        span_unescape(&raw, string);
+        *dest = string;
+
+        return 0;
+}
+
+/**
+ * Parses a whole number. Commas between digits are ignored outside of arrays
+ * and any fractional part is dropped since all numbers are stored as int64_t
+ */
+static int parse_number(struct parser_context *context, bool allow_grouping,
+                        int64_t *dest)
+{
+        const char *buffer = context->buffer;
+        size_t pos = context->pos;
+        bool negative = false;
+        uint64_t magnitude = 0;
+
+        if (buffer[pos] == '-') {
+                negative = true;
+                ++pos;
+        }
+
+        if (pos >= context->length
+            || char_to_token(buffer[pos]) != NUMERIC_CHAR) {
+                return parse_error();
+        }
+
+        for (;;) {
+                size_t end = pos + scan_kernels.count_digits(
+                                           buffer + pos, context->length - pos);
+
+                for (; pos < end; ++pos) {
+                        uint64_t digit = (uint64_t)(buffer[pos] - '0');
+
+                        if (magnitude > (UINT64_MAX - digit) / 10) {
+                                return parse_error();
+                        }
+
+                        magnitude = magnitude * 10 + digit;
+                }
+
+                // Grouping commas between digits are skipped
+                if (!allow_grouping || pos + 1 >= context->length
+                    || buffer[pos] != ','
+                    || char_to_token(buffer[pos + 1]) != NUMERIC_CHAR) {
+                        break;
+                }
+
+                ++pos;
+        }
+
+        if (pos + 1 < context->length && buffer[pos] == '.'
+            && char_to_token(buffer[pos + 1]) == NUMERIC_CHAR) {
+                ++pos;
+                pos += scan_kernels.count_digits(buffer + pos,
+                                                 context->length - pos);
+        }
+
+        uint64_t limit = (uint64_t)INT64_MAX + (negative ? 1 : 0);
+
+        if (magnitude > limit) {
+                return parse_error();
+        }
+
+        if (negative) {
+                *dest = (magnitude == limit) ? INT64_MIN
+                                             : -(int64_t)magnitude;
+        } else {
+                *dest = (int64_t)magnitude;
+        }
+
+        parser_advance(context, pos - context->pos);
+
+        return 0;
+}
+
+static int parse_bool(struct parser_context *context, bool *dest)
+{
+        size_t length = parser_scan_key(context, false);
+        const char *word = context->buffer + context->pos;
+
+        if (length == 4 && memcmp(word, "true", 4) == 0) {
+                *dest = true;
+        } else if (length == 5 && memcmp(word, "false", 5) == 0) {
+                *dest = false;
+        } else {
+                return parse_error();
+        }
+
+        parser_advance(context, length);
+
+        return 0;
+}
+
+static int parse_value(struct parser_context *context, bool in_array,
+                       struct sroc_value **dest);
+static int parse_value_into(struct parser_context *context,
+                            bool allow_grouping, struct sroc_value *value);
+
+/**
+ * Parses an array starting at the opening bracket. New lines and comments are
+ * allowed between values and a trailing comma is ignored
+ */
+static int parse_array(struct parser_context *context,
+                       struct sroc_array **dest)
+{
+        if (context->depth == context->limits.max_depth) {
+                return limit_error(context, SROC_ERRDEPTH);
+        }
+
+        if (charge_bytes(context, sizeof(struct sroc_array)) != 0) {
+                return -1;
+        }
+
+        struct sroc_array *array = sroc_create_array(SROC_ARRAY);
+
+        if (array == NULL) {
+                return -1;
+        }
+
+        ++context->depth;
+        parser_advance(context, 1);
+
+        for (;;) {
+                parser_skip_blank_lines(context);
+
+                if (parser_at_end(context)) {
+                        goto destroy_and_err;
+                }
+
+                if (char_to_token(parser_peek(context)) == CLOSE_BRACKET) {
+                        break;
+                }
+
+                struct sroc_value *value;
+
+                if (parse_value(context, true, &value) != 0) {
+                        goto destroy_and_err;
+                }
+
+                if (array->length == 0) {
+                        array->type = value->type;
+                } else if (value->type != array->type) {
+                        sroc_destroy_value(value);
+                        errno = EINVAL;
+
+                        goto destroy_and_err;
+                }
+
+                if (push_array_value(array, value) != 0) {
+                        sroc_destroy_value(value);
+
+                        goto destroy_and_err;
+                }
+
+                parser_skip_blank_lines(context);
+
+                enum token_type token = char_to_token(parser_peek(context));
+
+                if (token == COMMA) {
+                        parser_advance(context, 1);
+                } else if (token != CLOSE_BRACKET) {
+                        errno = EINVAL;
+
+                        goto destroy_and_err;
+                }
+        }
+
+        parser_advance(context, 1);
+        --context->depth;
+
+        array->frozen = true;
+        *dest = array;
+
+        return 0;
+
+destroy_and_err:
+        sroc_destroy_array(array);
+
+        return -1;
+}
+
+static int push_pending_field(struct parser_context *context,
+                              const struct pending_field *field)
+{
+        if (context->fields_length == context->fields_capacity) {
+                struct pending_field *fields = build_grow_array(
+                        context->fields,
+                        &context->fields_capacity,
+                        sizeof(struct pending_field));
+
+                if (fields == NULL) {
+                        return -1;
+                }
+
+                context->fields = fields;
+        }
+
+        context->fields[context->fields_length++] = *field;
+
+        return 0;
+}
+
+/**
+ * Parses a single `key: value` field of an object and adds it to the fields
+ * of the context. String values are only scanned here, they are copied into
+ * the object once it is built
+ */
+static int parse_field(struct parser_context *context)
+{
+        struct pending_field field;
+        size_t key_length = parser_scan_key(context, false);
+
+        if (key_length == 0) {
+                return parse_error();
+        }
+
+        if (charge_element(context, FIELD_OVERHEAD + key_length + 1) != 0) {
+                return -1;
+        }
+
+        span_init(&field.key, context->buffer + context->pos, key_length);
+        parser_advance(context, key_length);
+        parser_skip_whitespace(context);
+
+        if (char_to_token(parser_peek(context)) != COLON) {
+                return parse_error();
+        }
+
+        parser_advance(context, 1);
+        parser_skip_whitespace(context);
+
+        if (char_to_token(parser_peek(context)) == QUOTE) {
+                field.value.type = SROC_STRING;
+                field.value.interned = false;
+                field.value.string = NULL;
+
+                if (scan_string(context, &field.string, &field.string_length)
+                    != 0) {
+                        return -1;
+                }
+        } else if (parse_value_into(context, false, &field.value) != 0) {
+                return -1;
+        }
+
+        if (push_pending_field(context, &field) != 0) {
+                object_destroy_pending(&field, 1);
+
+                return -1;
+        }
+
+        return 0;
+}
+
 /**
- * Update the parsing context after a single character iteration through the
- * parser buffer.
- *
- * It cannot be assumed that the previous value will always be n-1 since the
- * context could have been updated inside of the parse loop. So the only job
- * of this function is to increment by 1
+ * Parses an object starting at the opening brace. Fields are collected on the
+ * context until the closing brace, when their number and size are known and
+ * the object is built in a single allocation. New lines and comments are
+ * allowed between fields and a trailing comma is ignored
+ */
+static int parse_object(struct parser_context *context,
+                        struct sroc_object **dest)
+{
+        if (context->depth == context->limits.max_depth) {
+                return limit_error(context, SROC_ERRDEPTH);
+        }
+
+        if (charge_bytes(context, sizeof(struct sroc_object)) != 0) {
+                return -1;
+        }
+
+        size_t base = context->fields_length;
+
+        ++context->depth;
+        parser_advance(context, 1);
+
+        for (;;) {
+                parser_skip_blank_lines(context);
+
+                if (parser_at_end(context)) {
+                        errno = EINVAL;
+
+                        goto destroy_and_err;
+                }
+
+                if (char_to_token(parser_peek(context)) == CLOSE_BRACE) {
+                        break;
+                }
+
+                if (parse_field(context) != 0) {
+                        goto destroy_and_err;
+                }
+
+                parser_skip_blank_lines(context);
+
+                enum token_type token = char_to_token(parser_peek(context));
+
+                if (token == COMMA) {
+                        parser_advance(context, 1);
+                } else if (token != CLOSE_BRACE) {
+                        errno = EINVAL;
+
+                        goto destroy_and_err;
+                }
+        }
+
+        struct sroc_object *object = object_create(
+                context->fields + base, context->fields_length - base);
+
+        if (object == NULL) {
+                goto destroy_and_err;
+        }
+
+        parser_advance(context, 1);
+        --context->depth;
+        context->fields_length = base;
+
+        *dest = object;
+
+        return 0;
+
+destroy_and_err:
+        object_destroy_pending(context->fields + base,
+                               context->fields_length - base);
+        context->fields_length = base;
+
+        return -1;
+}
+
+/**
+ * Parses any value into value. Commas between digits of a number are only
+ * skipped with allow_grouping, since in arrays and objects they separate
+ * values. Nothing is left to destroy on failure
+ */
+static int parse_value_into(struct parser_context *context,
+                            bool allow_grouping, struct sroc_value *value)
+{
+        int result;
+
+        value->interned = false;
+
+        switch (char_to_token(parser_peek(context))) {
+        case QUOTE:
+                value->type = SROC_STRING;
+                result = parse_string(
+                        context, &value->string, &value->interned);
+                break;
+        case OPEN_BRACKET:
+                value->type = SROC_ARRAY;
+                result = parse_array(context, &value->array);
+                break;
+        case OPEN_BRACE:
+                value->type = SROC_OBJECT;
+                result = parse_object(context, &value->object);
+                break;
+        case NEGATIVE:
+        case NUMERIC_CHAR:
+                value->type = SROC_NUMBER;
+                result = parse_number(context, allow_grouping, &value->number);
+                break;
+        case ALPHA_CHAR:
+                value->type = SROC_BOOL;
+                result = parse_bool(context, &value->boolean);
+                break;
+        default:
+                result = parse_error();
+                break;
+        }
+
+        return result;
+}
+
+static int parse_value(struct parser_context *context, bool in_array,
+                       struct sroc_value **dest)
+{
+        size_t bytes = sizeof(struct sroc_value);
+        int charged;
+
+        // Values in arrays are elements of their own, other values belong to
+        // the item holding them
+        if (in_array) {
+                charged = charge_element(context, bytes + sizeof(void *));
+        } else {
+                charged = charge_bytes(context, bytes);
+        }
+
+        if (charged != 0) {
+                return -1;
+        }
+
+        struct sroc_value *value = malloc(sizeof(struct sroc_value));
+
+        if (value == NULL) {
+                errno = ENOMEM;
+
+                return -1;
+        }
+
+        if (parse_value_into(context, !in_array, value) != 0) {
+                free(value);
+
+                return -1;
+        }
+
+        *dest = value;
+
+        return 0;
+}
+
+/**
+ * Parses a single `key = value` line
+ */
+static int parse_item(struct parser_context *context, struct sroc_item **dest)
+{
+        size_t key_length = parser_scan_key(context, false);
+
+        if (key_length == 0) {
+                return parse_error();
+        }
+
+        if (charge_element(context,
+                           sizeof(struct sroc_item) + key_length + 1
+                                   + ENTRY_OVERHEAD)
+            != 0) {
+                return -1;
+        }
+
+        struct sroc_item *item = malloc(sizeof(struct sroc_item));
+
+        if (item == NULL) {
+                errno = ENOMEM;
+
+                return -1;
+        }
+
+        item->key = store_string(context,
+                                 context->buffer + context->pos,
+                                 key_length,
+                                 &item->interned);
+
+        if (item->key == NULL) {
+                free(item);
+
+                return -1;
+        }
+
+        parser_advance(context, key_length);
+        parser_skip_whitespace(context);
+
+        if (char_to_token(parser_peek(context)) != EQUAL) {
+                errno = EINVAL;
+
+                goto free_key_and_err;
+        }
+
+        parser_advance(context, 1);
+        parser_skip_whitespace(context);
+
+        if (parse_value(context, false, &item->value) != 0) {
+                goto free_key_and_err;
+        }
+
+        item->value_hash = hash_value(item->value);
+
+        if (parse_end_of_line(context) != 0) {
+                sroc_destroy_item(item);
+
+                return -1;
+        }
+
+        *dest = item;
+
+        return 0;
+
+free_key_and_err:
+        if (!item->interned) {
+                free(item->key);
+        }
+
+        free(item);
+
+        return -1;
+}
+
+/**
+ * Parses a `[section]` header into a new empty table
  */
-static void increment_parser_context(struct parser_context *context)
+static int parse_section_header(struct parser_context *context,
+                                struct sroc_table **dest)
 {
-        if (context->buffer[context->pos] == '\n') {
-                // Handle a new line in the buffer
-                ++context->line_num;
-                context->col_num = 0;
+        parser_advance(context, 1);
+        parser_skip_whitespace(context);
+
+        size_t key_length = parser_scan_key(context, true);
+
+        if (key_length == 0) {
+                return parse_error();
+        }
+
+        if (charge_element(context,
+                           sizeof(struct sroc_table) + key_length + 1
+                                   + ENTRY_OVERHEAD)
+            != 0) {
+                return -1;
+        }
+
+        char *key = copy_key(context->buffer + context->pos, key_length);
+
+        if (key == NULL) {
+                return -1;
+        }
+
+        parser_advance(context, key_length);
+        parser_skip_whitespace(context);
+
+        if (char_to_token(parser_peek(context)) != CLOSE_BRACKET) {
+                free(key);
+
+                return parse_error();
+        }
+
+        parser_advance(context, 1);
+
+        if (parse_end_of_line(context) != 0) {
+                free(key);
+
+                return -1;
+        }
+
+        struct sroc_table *table = sroc_create_table(key);
+
+        if (table == NULL) {
+                free(key);
+                errno = ENOMEM;
+
+                return -1;
         }
 
-        ++context->pos;
+        *dest = table;
+
+        return 0;
+}
+
+/**
+ * Fingerprints the source text of the section currently being parsed, or of
+ * the root items when no section has been seen yet. The fingerprint is keyed,
+ * so no two texts can be written to share one
+ */
+static void set_span_hash(struct sroc_root *root, struct sroc_table *section,
+                          const char *span, size_t length)
+{
+        uint64_t hash = hash_keyed(span, length);
+
+        if (section == NULL) {
+                root->items_hash = hash;
+        } else {
+                section->hash = hash;
+        }
 }
 
 struct sroc_root *sroc_parse_file(FILE *file)
@@ -108,7 +986,7 @@ struct sroc_root *sroc_parse_file(FILE *file)
                 return NULL;
         }
 
-        struct sroc_root *root = sroc_parse_string(file_buffer);
+        struct sroc_root *root = sroc_parse_buffer(file_buffer, file_size);
 
         if (root == NULL) {
                 goto free_and_return_err;
@@ -126,30 +1004,162 @@ free_and_return_err:
 
 struct sroc_root *sroc_parse_string(const char *string)
 {
-        struct sroc_root *root = sroc_create_root();
+        return sroc_parse_buffer(string, strlen(string));
+}
 
-        if (root == NULL) {
+/**
+ * Parses length bytes of buffer into a new root. The buffer does not need to
+ * be null terminated.
+ *
+ * On a syntax error NULL is returned and errno is set to EINVAL
+ */
+struct sroc_root *sroc_parse_buffer(const char *buffer, size_t length)
+{
+        struct parser_context *context = init_parser();
+
+        if (context == NULL) {
                 return NULL;
         }
 
+        struct sroc_root *root = parser_parse(context, buffer, length);
+
+        destroy_parser_context(context);
+
+        return root;
+}
+
+/**
+ * Parses length bytes of buffer into a new root while holding it to limits,
+ * for input which cannot be trusted. Parse time and memory stay proportional
+ * to the limits however the input is crafted.
+ *
+ * Returns 0 and sets dest on success, otherwise returns SROC_ERRINVAL for a
+ * syntax error, SROC_ERRNOMEM or the sroc_error of the exceeded limit
+ */
+int sroc_parse_limited(const char *buffer, size_t length,
+                       const struct sroc_limits *limits,
+                       struct sroc_root **dest)
+{
         struct parser_context *context = init_parser();
 
         if (context == NULL) {
+                return SROC_ERRNOMEM;
+        }
+
+        parser_set_limits(context, limits);
+
+        struct sroc_root *root = parser_parse(context, buffer, length);
+        int result = (root != NULL) ? 0 : parser_error(context);
+
+        destroy_parser_context(context);
+
+        if (result == 0) {
+                *dest = root;
+        }
+
+        return result;
+}
+
+/**
+ * Parses buffer using context, which is reset first so a single context can
+ * be reused for any number of buffers
+ */
+struct sroc_root *parser_parse(struct parser_context *context,
+                               const char *buffer, size_t length)
+{
+        parser_reset(context, buffer, length);
+
+        if (length > context->limits.max_bytes) {
+                limit_error(context, SROC_ERRTOOBIG);
+
+                return NULL;
+        }
+
+        struct sroc_root *root = sroc_create_root();
+
+        if (root == NULL) {
                 return NULL;
         }
 
-        context->buffer = string;
+        if (context->intern) {
+                root->strings = intern_create();
 
-        char cur_ch;
+                if (root->strings == NULL) {
+                        free(root);
 
-        while ((cur_ch = context->buffer[context->pos]) != '\0') {
-                printf("%c\n", cur_ch);
-                increment_parser_context(context);
+                        return NULL;
+                }
         }
 
-        destroy_parser_context(context);
+        context->strings = root->strings;
+
+        struct sroc_table *section = NULL;
+        size_t span_start = 0;
+
+        for (;;) {
+                parser_skip_blank_lines(context);
+
+                if (parser_at_end(context)) {
+                        break;
+                }
+
+                if (char_to_token(parser_peek(context)) == OPEN_BRACKET) {
+                        // Sections span from the start of their header line
+                        // up to the start of the next header line
+                        size_t line_start = context->pos - context->col_num;
+
+                        set_span_hash(root,
+                                      section,
+                                      buffer + span_start,
+                                      line_start - span_start);
+                        span_start = line_start;
+
+                        if (parse_section_header(context, &section) != 0) {
+                                goto destroy_and_err;
+                        }
+
+                        if (push_root_section(root, section) != 0) {
+                                sroc_destroy_table(section);
+
+                                goto destroy_and_err;
+                        }
+
+                        continue;
+                }
+
+                struct sroc_item *item = NULL;
+
+                if (parse_item(context, &item) != 0) {
+                        goto destroy_and_err;
+                }
+
+                int result;
+
+                if (section == NULL) {
+                        result = push_root_item(root, item);
+                } else {
+                        result = push_table_item(section, item);
+                }
+
+                if (result != 0) {
+                        sroc_destroy_item(item);
+
+                        goto destroy_and_err;
+                }
+        }
+
+        set_span_hash(root, section, buffer + span_start, length - span_start);
+
+        if (index_build_root(root) != 0) {
+                goto destroy_and_err;
+        }
 
         return root;
+
+destroy_and_err:
+        sroc_destroy_root(root);
+
+        return NULL;
 }
 
 struct sroc_root *sroc_create_root(void)
@@ -163,9 +1173,20 @@ struct sroc_root *sroc_create_root(void)
         }
 
         root->items_length = 0;
+        root->items_capacity = 0;
         root->items = NULL;
+        root->items_index = NULL;
+        root->items_hash = 0;
         root->sections_length = 0;
+        root->sections_capacity = 0;
         root->sections = NULL;
+        root->sections_index = NULL;
+        index_init_lookup(&root->items_lookup);
+        index_init_lookup(&root->sections_lookup);
+        root->access = NULL;
+        root->base = NULL;
+        root->references = 0;
+        root->strings = NULL;
 
         return root;
 }
@@ -180,21 +1201,96 @@ struct sroc_table *sroc_create_table(char *key)
 
         table->key = key;
         table->size = 0;
+        table->capacity = 0;
         table->items = NULL;
+        table->index = NULL;
+        table->hash = 0;
+        table->base = NULL;
+        index_init_lookup(&table->lookup);
 
         return table;
 }
 
+/**
+ * Creates an empty array whose values will be of the given type. The type of
+ * an empty array is taken from the first value pushed onto it
+ */
+struct sroc_array *sroc_create_array(enum sroc_type type)
+{
+        struct sroc_array *array = malloc(sizeof(struct sroc_array));
+
+        if (array == NULL) {
+                errno = ENOMEM;
+
+                return NULL;
+        }
+
+        array->length = 0;
+        array->type = type;
+        array->items = NULL;
+        array->capacity = 0;
+        array->frozen = false;
+
+        return array;
+}
+
+/**
+ * Creates a zeroed value of the given type. Array and string values start
+ * with a NULL array or string which the caller must fill in
+ */
+struct sroc_value *sroc_create_value(enum sroc_type type)
+{
+        struct sroc_value *value = calloc(1, sizeof(struct sroc_value));
+
+        if (value == NULL) {
+                errno = ENOMEM;
+
+                return NULL;
+        }
+
+        value->type = type;
+
+        return value;
+}
+
+/**
+ * Destroys root once it is no longer the base of any derived root. Items and
+ * tables a derived root shares with its base are left to the base
+ */
 void sroc_destroy_root(struct sroc_root *root)
 {
-        for (size_t i = 0; i < root->items_length; ++i) {
-                sroc_destroy_item(root->items[i]);
+        if (root == NULL || !derive_release(root)) {
+                return;
+        }
+
+        if (!derive_shares_root_items(root)) {
+                struct sroc_root *base = root->base;
+
+                for (size_t i = 0; i < root->items_length; ++i) {
+                        if (base == NULL
+                            || !derive_shares_item(root->items,
+                                                   base->items,
+                                                   base->items_length,
+                                                   i)) {
+                                sroc_destroy_item(root->items[i]);
+                        }
+                }
+
+                free(root->items);
+                free(root->items_index);
+                index_destroy_lookup(&root->items_lookup);
         }
 
         for (size_t i = 0; i < root->sections_length; ++i) {
                 sroc_destroy_table(root->sections[i]);
         }
 
+        free(root->sections);
+        free(root->sections_index);
+        index_destroy_lookup(&root->sections_lookup);
+        access_destroy(root->access);
+        intern_destroy(root->strings);
+        sroc_destroy_root(root->base);
         free(root);
 }
 
@@ -204,21 +1300,28 @@ void sroc_destroy_array(struct sroc_array *array)
                 sroc_destroy_value(array->items[i]);
         }
 
+        free(array->items);
         free(array);
 }
 
 void sroc_destroy_item(struct sroc_item *item)
 {
-        free(item->key);
+        if (!item->interned) {
+                free(item->key);
+        }
 
         sroc_destroy_value(item->value);
+
+        free(item);
 }
 
 void sroc_destroy_value(struct sroc_value *value)
 {
         if (value->type == SROC_ARRAY) {
                 sroc_destroy_array(value->array);
-        } else if (value->type == SROC_STRING) {
+        } else if (value->type == SROC_OBJECT) {
+                sroc_destroy_object(value->object);
+        } else if (value->type == SROC_STRING && !value->interned) {
                 free(value->string);
         }
 
@@ -227,12 +1330,21 @@ void sroc_destroy_value(struct sroc_value *value)
 
 void sroc_destroy_table(struct sroc_table *table)
 {
+        const struct sroc_table *base = table->base;
+
         free(table->key);
 
         for (size_t i = 0; i < table->size; ++i) {
-                sroc_destroy_item(table->items[i]);
+                if (base == NULL
+                    || !derive_shares_item(
+                            table->items, base->items, base->size, i)) {
+                        sroc_destroy_item(table->items[i]);
+                }
         }
 
+        free(table->items);
+        free(table->index);
+        index_destroy_lookup(&table->lookup);
         free(table);
 }
 
@@ -5,10 +5,12 @@
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "scan.h"
 #include "string_helper.h"
 
 /*
@@ -79,7 +81,7 @@ int64_t string_find_first_nonspace(const char *string)
         char ch;
         int64_t index = 0;
 
-        while ((ch = string[index]) != '\0' && isspace(ch)) {
+        while ((ch = string[index]) != '\0' && isspace((unsigned char)ch)) {
                 ++index;
         }
 
@@ -103,14 +105,14 @@ int64_t string_find_last_nonspace(const char *string)
                 return -1;
         }
 
-        int64_t index = (int64_t)strlen(string) - 1;
+        size_t length = strlen(string);
 
-        while (index >= 0 && isspace(string[index])) {
-                --index;
+        while (length > 0 && isspace((unsigned char)string[length - 1])) {
+                --length;
         }
 
         // If nothing is found will have reached -1
-        return index;
+        return (int64_t)length - 1;
 }
 
 /**
@@ -167,3 +169,148 @@ int64_t string_strip_surrounding_space(const char *string, char **dest)
 
         return string_splice(string, dest, start_index, end_index + 1);
 }
+
+void span_init(struct sroc_span *span, const char *p, size_t n)
+{
+        span->p = p;
+        span->n = n;
+}
+
+void span_from_string(struct sroc_span *span, const char *string)
+{
+        span_init(span, string, (string == NULL) ? 0 : strlen(string));
+}
+
+/**
+ * Returns the offset of the first nonspace character in span, or its length
+ * if there is none, where space is what isspace accepts in the C locale
+ */
+size_t span_skip_space(const struct sroc_span *span)
+{
+        return scan_kernels.skip_space(span->p, span->n);
+}
+
+/**
+ * Returns the length of span once trailing whitespace has been dropped, which
+ * is 0 if span is all whitespace
+ */
+size_t span_skip_space_back(const struct sroc_span *span)
+{
+        return scan_kernels.skip_space_back(span->p, span->n);
+}
+
+/**
+ * Points dest at span without its surrounding whitespace. Every byte of span
+ * is looked at most once
+ */
+void span_trim(const struct sroc_span *span, struct sroc_span *dest)
+{
+        size_t start = span_skip_space(span);
+        struct sroc_span rest;
+
+        span_init(&rest, span->p + start, span->n - start);
+        span_init(dest, rest.p, span_skip_space_back(&rest));
+}
+
+/**
+ * Returns the offset of the first delimiter in span, or -1 if there is none
+ */
+int64_t span_find(const struct sroc_span *span, char delimiter)
+{
+        const char *found = memchr(span->p, delimiter, span->n);
+
+        if (found == NULL) {
+                return -1;
+        }
+
+        return found - span->p;
+}
+
+/**
+ * Points dest at everything in span before the first delimiter and returns
+ * its length, or returns -1 and leaves dest alone if there is no delimiter
+ */
+int64_t span_get_delimiter(const struct sroc_span *span, char delimiter,
+                           struct sroc_span *dest)
+{
+        int64_t length = span_find(span, delimiter);
+
+        if (length >= 0) {
+                span_init(dest, span->p, (size_t)length);
+        }
+
+        return length;
+}
+
+int64_t span_get_line(const struct sroc_span *span, struct sroc_span *dest)
+{
+        return span_get_delimiter(span, '\n', dest);
+}
+
+/**
+ * Points dest at bytes [start, end) of span. Returns -1 if the range does not
+ * fit inside of span
+ */
+int span_splice(const struct sroc_span *span, size_t start, size_t end,
+                struct sroc_span *dest)
+{
+        if (start > end || end > span->n) {
+                return -1;
+        }
+
+        span_init(dest, span->p + start, end - start);
+
+        return 0;
+}
+
+/**
+ * Copies span into a new null terminated string which must be freed by the
+ * caller
+ */
+char *span_dup(const struct sroc_span *span)
+{
+        char *string = malloc(span->n + 1);
+
+        if (string == NULL) {
+                errno = ENOMEM;
+
+                return NULL;
+        }
+
+        memcpy(string, span->p, span->n);
+        string[span->n] = '\0';
+
+        return string;
+}
+
+/**
+ * Copies span into dest with each escape character removed and the character
+ * following it kept. dest must have room for the result and a null terminator.
+ * Returns the length of the result
+ */
+size_t span_unescape(const struct sroc_span *span, char *dest)
+{
+        const char *src = span->p;
+        const char *src_end = span->p + span->n;
+        char *out = dest;
+
+        while (src < src_end) {
+                const char *escape = memchr(src, '\\', (size_t)(src_end - src));
+
+                if (escape == NULL) {
+                        memcpy(out, src, (size_t)(src_end - src));
+                        out += src_end - src;
+
+                        break;
+                }
+
+                memcpy(out, src, (size_t)(escape - src));
+                out += escape - src;
+                *out++ = escape[1];
+                src = escape + 2;
+        }
+
+        *out = '\0';
+
+        return (size_t)(out - dest);
+}
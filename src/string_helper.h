@@ -2,6 +2,21 @@
 // Licensed under BSD-3-Clause
 // Refer to the license.txt file included in the root of the project
 
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A view of n bytes starting at p. The bytes do not need to be null
+ * terminated and are never copied, so a span is only valid for as long as the
+ * memory it points into
+ */
+struct sroc_span {
+        const char *p;
+        size_t n;
+};
+
 int64_t string_get_delimiter(const char *string, char delimiter, char **dest);
 int64_t string_get_line(const char *string, char **dest);
 int64_t string_find_first_nonspace(const char *string);
@@ -9,3 +24,17 @@ int64_t string_find_last_nonspace(const char *string);
 int64_t string_splice(const char *string, char **dest, int64_t start,
                       int64_t end);
 int64_t string_strip_surrounding_space(const char *string, char **dest);
+
+void span_init(struct sroc_span *span, const char *p, size_t n);
+void span_from_string(struct sroc_span *span, const char *string);
+size_t span_skip_space(const struct sroc_span *span);
+size_t span_skip_space_back(const struct sroc_span *span);
+void span_trim(const struct sroc_span *span, struct sroc_span *dest);
+int64_t span_find(const struct sroc_span *span, char delimiter);
+int64_t span_get_delimiter(const struct sroc_span *span, char delimiter,
+                           struct sroc_span *dest);
+int64_t span_get_line(const struct sroc_span *span, struct sroc_span *dest);
+int span_splice(const struct sroc_span *span, size_t start, size_t end,
+                struct sroc_span *dest);
+char *span_dup(const struct sroc_span *span);
+size_t span_unescape(const struct sroc_span *span, char *dest);
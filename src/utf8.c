@@ -0,0 +1,467 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdint.h>
+#include <string.h>
+
+#include "scan.h"
+
+#if defined(SCAN_X86)
+#include <immintrin.h>
+#endif
+
+#include "utf8.h"
+
+#define ASCII_MASK 0x8080808080808080ULL
+
+static inline int is_continuation(unsigned char byte)
+{
+        return (byte & 0xC0) == 0x80;
+}
+
+/**
+ * Validates buffer a sequence at a time following table 3-7 of the Unicode
+ * standard, skipping runs of ASCII eight bytes at a time.
+ *
+ * Returns the offset of the first byte of the first invalid or truncated
+ * sequence, or length if the whole buffer is valid
+ */
+size_t utf8_validate_scalar(const char *buffer, size_t length)
+{
+        const unsigned char *bytes = (const unsigned char *)buffer;
+        size_t pos = 0;
+
+        while (pos < length) {
+                if (length - pos >= 8) {
+                        uint64_t word;
+
+                        memcpy(&word, bytes + pos, sizeof(word));
+
+                        if ((word & ASCII_MASK) == 0) {
+                                pos += 8;
+
+                                continue;
+                        }
+                }
+
+                unsigned char lead = bytes[pos];
+                unsigned char low = 0x80;
+                unsigned char high = 0xBF;
+                size_t continuations;
+
+                if (lead < 0x80) {
+                        ++pos;
+
+                        continue;
+                } else if (lead >= 0xC2 && lead <= 0xDF) {
+                        continuations = 1;
+                } else if (lead == 0xE0) {
+                        // Rejects overlong encodings
+                        continuations = 2;
+                        low = 0xA0;
+                } else if (lead == 0xED) {
+                        // Rejects UTF-16 surrogates
+                        continuations = 2;
+                        high = 0x9F;
+                } else if (lead >= 0xE1 && lead <= 0xEF) {
+                        continuations = 2;
+                } else if (lead == 0xF0) {
+                        continuations = 3;
+                        low = 0x90;
+                } else if (lead == 0xF4) {
+                        // Rejects anything past U+10FFFF
+                        continuations = 3;
+                        high = 0x8F;
+                } else if (lead >= 0xF1 && lead <= 0xF3) {
+                        continuations = 3;
+                } else {
+                        return pos;
+                }
+
+                if (length - pos <= continuations || bytes[pos + 1] < low
+                    || bytes[pos + 1] > high) {
+                        return pos;
+                }
+
+                for (size_t i = 2; i <= continuations; ++i) {
+                        if (!is_continuation(bytes[pos + i])) {
+                                return pos;
+                        }
+                }
+
+                pos += continuations + 1;
+        }
+
+        return length;
+}
+
+/**
+ * Finishes validation from offset after the vector loop either ran out of
+ * whole blocks or found an error. Everything before offset is known to be
+ * valid except for a sequence which may have started up to three bytes
+ * earlier, so the scalar validator resumes from the start of that sequence
+ * and reports exactly the same offset it would have on its own
+ */
+static inline size_t finish_scalar(const char *buffer, size_t length,
+                                   size_t offset)
+{
+        const unsigned char *bytes = (const unsigned char *)buffer;
+        size_t start = offset;
+
+        for (size_t back = 1; back <= 3 && back <= offset; ++back) {
+                if (!is_continuation(bytes[offset - back])) {
+                        if (bytes[offset - back] >= 0xC0) {
+                                start = offset - back;
+                        }
+
+                        break;
+                }
+        }
+
+        return start + utf8_validate_scalar(buffer + start, length - start);
+}
+
+#if defined(SCAN_X86)
+
+/*
+ * Vector validation uses the lookup algorithm from "Validating UTF-8 In Less
+ * Than One Instruction Per Byte" (Keiser and Lemire). Every byte is classified
+ * by three 16 entry tables indexed by the high and low nibble of the previous
+ * byte and the high nibble of the current byte, and the bitwise and of the
+ * three results is non zero only for invalid pairs. Three and four byte
+ * sequences are checked separately by looking two and three bytes back
+ */
+
+// Error classes for a pair of adjacent bytes
+#define TOO_SHORT (1 << 0)
+#define TOO_LONG (1 << 1)
+#define OVERLONG_3 (1 << 2)
+#define TOO_LARGE (1 << 3)
+#define SURROGATE (1 << 4)
+#define OVERLONG_2 (1 << 5)
+#define TOO_LARGE_1000 (1 << 6)
+#define OVERLONG_4 (1 << 6)
+#define TWO_CONTS (1 << 7)
+#define CARRY (TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+#define BYTE_1_HIGH                                                            \
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,  \
+                TOO_LONG, TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,          \
+                TOO_SHORT | OVERLONG_2, TOO_SHORT,                             \
+                TOO_SHORT | OVERLONG_3 | SURROGATE,                            \
+                TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4
+
+#define BYTE_1_LOW                                                             \
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4, CARRY | OVERLONG_2,      \
+                CARRY, CARRY, CARRY | TOO_LARGE,                               \
+                CARRY | TOO_LARGE | TOO_LARGE_1000,                            \
+                CARRY | TOO_LARGE | TOO_LARGE_1000,                            \
+                CARRY | TOO_LARGE | TOO_LARGE_1000,                            \
+                CARRY | TOO_LARGE | TOO_LARGE_1000,                            \
+                CARRY | TOO_LARGE | TOO_LARGE_1000,                            \
+                CARRY | TOO_LARGE | TOO_LARGE_1000,                            \
+                CARRY | TOO_LARGE | TOO_LARGE_1000,                            \
+                CARRY | TOO_LARGE | TOO_LARGE_1000,                            \
+                CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,                \
+                CARRY | TOO_LARGE | TOO_LARGE_1000,                            \
+                CARRY | TOO_LARGE | TOO_LARGE_1000
+
+#define BYTE_2_HIGH                                                            \
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,      \
+                TOO_SHORT, TOO_SHORT,                                          \
+                TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3                 \
+                        | TOO_LARGE_1000 | OVERLONG_4,                         \
+                TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,    \
+                TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,     \
+                TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,     \
+                TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+
+#define AVX2_BLOCK 32
+#define SSSE3_BLOCK 16
+#define AVX512_BLOCK 64
+
+AVX2_TARGET static inline __m256i avx2_lookup(const uint8_t table[16],
+                                              __m256i index)
+{
+        __m256i lookup = _mm256_broadcastsi128_si256(
+                _mm_loadu_si128((const __m128i *)table));
+
+        return _mm256_shuffle_epi8(lookup, index);
+}
+
+AVX2_TARGET static inline __m256i avx2_shift_in(__m256i input, __m256i prev,
+                                                int count)
+{
+        __m256i joined = _mm256_permute2x128_si256(prev, input, 0x21);
+
+        switch (count) {
+        case 1:
+                return _mm256_alignr_epi8(input, joined, 15);
+        case 2:
+                return _mm256_alignr_epi8(input, joined, 14);
+        default:
+                return _mm256_alignr_epi8(input, joined, 13);
+        }
+}
+
+AVX2_TARGET size_t utf8_validate_avx2(const char *buffer, size_t length)
+{
+        static const uint8_t byte_1_high[16] = {BYTE_1_HIGH};
+        static const uint8_t byte_1_low[16] = {BYTE_1_LOW};
+        static const uint8_t byte_2_high[16] = {BYTE_2_HIGH};
+        const __m256i nibble = _mm256_set1_epi8(0x0F);
+        const __m256i max_tail = _mm256_setr_epi8(
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+        __m256i prev = _mm256_setzero_si256();
+        __m256i prev_incomplete = _mm256_setzero_si256();
+        size_t pos = 0;
+
+        for (; length - pos >= AVX2_BLOCK; pos += AVX2_BLOCK) {
+                __m256i input
+                        = _mm256_loadu_si256((const __m256i *)(buffer + pos));
+
+                if (_mm256_movemask_epi8(input) == 0) {
+                        // An ASCII block is only wrong if the previous block
+                        // stopped in the middle of a sequence
+                        if (!_mm256_testz_si256(prev_incomplete,
+                                                prev_incomplete)) {
+                                break;
+                        }
+
+                        prev = input;
+
+                        continue;
+                }
+
+                __m256i prev1 = avx2_shift_in(input, prev, 1);
+                __m256i prev1_high = _mm256_and_si256(
+                        _mm256_srli_epi16(prev1, 4), nibble);
+                __m256i input_high = _mm256_and_si256(
+                        _mm256_srli_epi16(input, 4), nibble);
+                __m256i special = _mm256_and_si256(
+                        _mm256_and_si256(
+                                avx2_lookup(byte_1_high, prev1_high),
+                                avx2_lookup(byte_1_low,
+                                            _mm256_and_si256(prev1, nibble))),
+                        avx2_lookup(byte_2_high, input_high));
+                __m256i third = _mm256_subs_epu8(avx2_shift_in(input, prev, 2),
+                                                 _mm256_set1_epi8(0x60));
+                __m256i fourth = _mm256_subs_epu8(
+                        avx2_shift_in(input, prev, 3), _mm256_set1_epi8(0x70));
+                __m256i must_23 = _mm256_and_si256(
+                        _mm256_or_si256(third, fourth),
+                        _mm256_set1_epi8((char)0x80));
+                __m256i error = _mm256_xor_si256(special, must_23);
+
+                if (!_mm256_testz_si256(error, error)) {
+                        break;
+                }
+
+                prev = input;
+                prev_incomplete = _mm256_subs_epu8(input, max_tail);
+        }
+
+        return finish_scalar(buffer, length, pos);
+}
+
+SSSE3_TARGET static inline __m128i ssse3_lookup(const uint8_t table[16],
+                                                __m128i index)
+{
+        return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)table), index);
+}
+
+SSSE3_TARGET size_t utf8_validate_ssse3(const char *buffer, size_t length)
+{
+        static const uint8_t byte_1_high[16] = {BYTE_1_HIGH};
+        static const uint8_t byte_1_low[16] = {BYTE_1_LOW};
+        static const uint8_t byte_2_high[16] = {BYTE_2_HIGH};
+        const __m128i nibble = _mm_set1_epi8(0x0F);
+        const __m128i max_tail = _mm_setr_epi8(-1,
+                                               -1,
+                                               -1,
+                                               -1,
+                                               -1,
+                                               -1,
+                                               -1,
+                                               -1,
+                                               -1,
+                                               -1,
+                                               -1,
+                                               -1,
+                                               -1,
+                                               (char)(0xF0 - 1),
+                                               (char)(0xE0 - 1),
+                                               (char)(0xC0 - 1));
+        __m128i prev = _mm_setzero_si128();
+        __m128i prev_incomplete = _mm_setzero_si128();
+        size_t pos = 0;
+
+        for (; length - pos >= SSSE3_BLOCK; pos += SSSE3_BLOCK) {
+                __m128i input
+                        = _mm_loadu_si128((const __m128i *)(buffer + pos));
+
+                if (_mm_movemask_epi8(input) == 0) {
+                        if (_mm_movemask_epi8(_mm_cmpeq_epi8(
+                                    prev_incomplete, _mm_setzero_si128()))
+                            != 0xFFFF) {
+                                break;
+                        }
+
+                        prev = input;
+
+                        continue;
+                }
+
+                __m128i prev1 = _mm_alignr_epi8(input, prev, 15);
+                __m128i prev1_high
+                        = _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble);
+                __m128i input_high
+                        = _mm_and_si128(_mm_srli_epi16(input, 4), nibble);
+                __m128i special = _mm_and_si128(
+                        _mm_and_si128(
+                                ssse3_lookup(byte_1_high, prev1_high),
+                                ssse3_lookup(byte_1_low,
+                                             _mm_and_si128(prev1, nibble))),
+                        ssse3_lookup(byte_2_high, input_high));
+                __m128i third = _mm_subs_epu8(_mm_alignr_epi8(input, prev, 14),
+                                              _mm_set1_epi8(0x60));
+                __m128i fourth = _mm_subs_epu8(_mm_alignr_epi8(input, prev, 13),
+                                               _mm_set1_epi8(0x70));
+                __m128i must_23 = _mm_and_si128(_mm_or_si128(third, fourth),
+                                                _mm_set1_epi8((char)0x80));
+                __m128i error = _mm_xor_si128(special, must_23);
+
+                if (_mm_movemask_epi8(
+                            _mm_cmpeq_epi8(error, _mm_setzero_si128()))
+                    != 0xFFFF) {
+                        break;
+                }
+
+                prev = input;
+                prev_incomplete = _mm_subs_epu8(input, max_tail);
+        }
+
+        return finish_scalar(buffer, length, pos);
+}
+
+AVX512_TARGET static inline __m512i avx512_lookup(const uint8_t table[16],
+                                                  __m512i index)
+{
+        __m512i lookup = _mm512_broadcast_i32x4(
+                _mm_loadu_si128((const __m128i *)table));
+
+        return _mm512_shuffle_epi8(lookup, index);
+}
+
+/**
+ * Shifts the last count bytes of prev in front of input. Byte shifts only
+ * work within 128 bit lanes, so the lanes are first lined up with the lane
+ * before each of them
+ */
+AVX512_TARGET static inline __m512i avx512_shift_in(__m512i input,
+                                                    __m512i prev, int count)
+{
+        __m512i joined = _mm512_permutex2var_epi64(
+                prev, _mm512_set_epi64(13, 12, 11, 10, 9, 8, 7, 6), input);
+
+        switch (count) {
+        case 1:
+                return _mm512_alignr_epi8(input, joined, 15);
+        case 2:
+                return _mm512_alignr_epi8(input, joined, 14);
+        default:
+                return _mm512_alignr_epi8(input, joined, 13);
+        }
+}
+
+AVX512_TARGET size_t utf8_validate_avx512(const char *buffer, size_t length)
+{
+        static const uint8_t byte_1_high[16] = {BYTE_1_HIGH};
+        static const uint8_t byte_1_low[16] = {BYTE_1_LOW};
+        static const uint8_t byte_2_high[16] = {BYTE_2_HIGH};
+        const __m512i nibble = _mm512_set1_epi8(0x0F);
+        // Only the last three bytes of a block can start a sequence which
+        // continues into the next one
+        const __m512i max_tail = _mm512_inserti32x4(
+                _mm512_set1_epi8(-1),
+                _mm_setr_epi8(-1,
+                              -1,
+                              -1,
+                              -1,
+                              -1,
+                              -1,
+                              -1,
+                              -1,
+                              -1,
+                              -1,
+                              -1,
+                              -1,
+                              -1,
+                              (char)(0xF0 - 1),
+                              (char)(0xE0 - 1),
+                              (char)(0xC0 - 1)),
+                3);
+        __m512i prev = _mm512_setzero_si512();
+        __m512i prev_incomplete = _mm512_setzero_si512();
+        size_t pos = 0;
+
+        for (; length - pos >= AVX512_BLOCK; pos += AVX512_BLOCK) {
+                __m512i input = _mm512_loadu_si512(buffer + pos);
+
+                if (_mm512_movepi8_mask(input) == 0) {
+                        if (_mm512_test_epi8_mask(prev_incomplete,
+                                                  prev_incomplete)
+                            != 0) {
+                                break;
+                        }
+
+                        prev = input;
+
+                        continue;
+                }
+
+                __m512i prev1 = avx512_shift_in(input, prev, 1);
+                __m512i prev1_high = _mm512_and_si512(
+                        _mm512_srli_epi16(prev1, 4), nibble);
+                __m512i input_high = _mm512_and_si512(
+                        _mm512_srli_epi16(input, 4), nibble);
+                __m512i special = _mm512_and_si512(
+                        _mm512_and_si512(
+                                avx512_lookup(byte_1_high, prev1_high),
+                                avx512_lookup(byte_1_low,
+                                              _mm512_and_si512(prev1, nibble))),
+                        avx512_lookup(byte_2_high, input_high));
+                __m512i third = _mm512_subs_epu8(
+                        avx512_shift_in(input, prev, 2),
+                        _mm512_set1_epi8(0x60));
+                __m512i fourth = _mm512_subs_epu8(
+                        avx512_shift_in(input, prev, 3),
+                        _mm512_set1_epi8(0x70));
+                __m512i must_23 = _mm512_and_si512(
+                        _mm512_or_si512(third, fourth),
+                        _mm512_set1_epi8((char)0x80));
+                __m512i error = _mm512_xor_si512(special, must_23);
+
+                if (_mm512_test_epi8_mask(error, error) != 0) {
+                        break;
+                }
+
+                prev = input;
+                prev_incomplete = _mm512_subs_epu8(input, max_tail);
+        }
+
+        return finish_scalar(buffer, length, pos);
+}
+
+#endif
+
+/**
+ * Validates buffer with the kernel of the tier picked for this CPU
+ */
+size_t utf8_validate(const char *buffer, size_t length)
+{
+        return scan_kernels.utf8_validate(buffer, length);
+}
@@ -0,0 +1,18 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#pragma once
+
+#include <stddef.h>
+
+#include "scan.h"
+
+size_t utf8_validate(const char *buffer, size_t length);
+size_t utf8_validate_scalar(const char *buffer, size_t length);
+
+#if defined(SCAN_X86)
+size_t utf8_validate_ssse3(const char *buffer, size_t length);
+size_t utf8_validate_avx2(const char *buffer, size_t length);
+size_t utf8_validate_avx512(const char *buffer, size_t length);
+#endif
@@ -0,0 +1,171 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+#include <sroc.h>
+
+#define THREADS 8
+#define READS_PER_THREAD 10000
+
+static const char *test_string = "name = \"app\"\n"
+                                 "\n"
+                                 "[server]\n"
+                                 "port = 80\n"
+                                 "host = \"localhost\"\n"
+                                 "legacy = true\n";
+
+struct recorded_counts {
+        size_t length;
+        char lines[8][64];
+        int stop_after;
+};
+
+static int record_count(const char *section, const char *key, uint64_t count,
+                        void *data)
+{
+        struct recorded_counts *counts = data;
+
+        snprintf(counts->lines[counts->length++],
+                 sizeof(counts->lines[0]),
+                 "%s.%s %llu",
+                 (section == NULL) ? "" : section,
+                 key,
+                 (unsigned long long)count);
+
+        if (counts->stop_after != 0
+            && (int)counts->length == counts->stop_after) {
+                return 42;
+        }
+
+        return 0;
+}
+
+static void test_sroc_access_counts_reads(void **state)
+{
+        struct sroc_root *root = sroc_parse_string(test_string);
+        struct recorded_counts counts = {0};
+        const char *string;
+        int64_t number;
+
+        assert_int_equal(SROC_ERRINVAL,
+                         sroc_access_report(root, record_count, &counts));
+        assert_int_equal(0, sroc_track_access(root));
+
+        for (int i = 0; i < 3; ++i) {
+                assert_int_equal(
+                        0, sroc_read_number(root, "server", "port", &number));
+        }
+
+        assert_int_equal(0, sroc_read_string(root, NULL, "name", &string));
+        assert_int_equal(SROC_ERRNOKEY,
+                         sroc_read_number(root, "server", "missing", &number));
+        assert_int_equal(SROC_ERRNOSECTION,
+                         sroc_read_number(root, "missing", "port", &number));
+
+        assert_int_equal(0, sroc_access_report(root, record_count, &counts));
+        assert_int_equal(4, counts.length);
+        assert_string_equal(".name 1", counts.lines[0]);
+        assert_string_equal("server.port 3", counts.lines[1]);
+        assert_string_equal("server.host 0", counts.lines[2]);
+        assert_string_equal("server.legacy 0", counts.lines[3]);
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_access_report_stops(void **state)
+{
+        struct sroc_root *root = sroc_parse_string(test_string);
+        struct recorded_counts counts = {.stop_after = 2};
+
+        assert_int_equal(0, sroc_track_access(root));
+        assert_int_equal(42, sroc_access_report(root, record_count, &counts));
+        assert_int_equal(2, counts.length);
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_access_ignores_later_items(void **state)
+{
+        struct sroc_root *root = sroc_parse_string(test_string);
+        struct recorded_counts counts = {0};
+        struct sroc_table *table;
+        int64_t number;
+
+        assert_int_equal(0, sroc_track_access(root));
+        assert_int_equal(0, sroc_root_add_section(root, "extra", &table));
+        assert_int_equal(0, sroc_table_set_number(table, "added", 1));
+        assert_int_equal(0, sroc_root_add_section(root, "server", &table));
+        assert_int_equal(0, sroc_table_set_number(table, "added", 2));
+        assert_int_equal(0, sroc_read_number(root, "extra", "added", &number));
+        assert_int_equal(0,
+                         sroc_read_number(root, "server", "added", &number));
+
+        assert_int_equal(0, sroc_access_report(root, record_count, &counts));
+        assert_int_equal(4, counts.length);
+
+        sroc_destroy_root(root);
+}
+
+static void *read_port(void *data)
+{
+        const struct sroc_root *root = data;
+        int64_t number;
+
+        for (int i = 0; i < READS_PER_THREAD; ++i) {
+                sroc_read_number(root, "server", "port", &number);
+        }
+
+        return NULL;
+}
+
+static void test_sroc_access_counts_across_threads(void **state)
+{
+        struct sroc_root *root = sroc_parse_string(test_string);
+        struct recorded_counts counts = {0};
+        pthread_t threads[THREADS];
+
+        assert_int_equal(0, sroc_track_access(root));
+
+        for (int i = 0; i < THREADS; ++i) {
+                assert_int_equal(
+                        0, pthread_create(&threads[i], NULL, read_port, root));
+        }
+
+        for (int i = 0; i < THREADS; ++i) {
+                pthread_join(threads[i], NULL);
+        }
+
+        char expected[64];
+
+        snprintf(expected,
+                 sizeof(expected),
+                 "server.port %d",
+                 THREADS * READS_PER_THREAD);
+
+        assert_int_equal(0, sroc_access_report(root, record_count, &counts));
+        assert_string_equal(expected, counts.lines[1]);
+
+        sroc_destroy_root(root);
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test(test_sroc_access_counts_reads),
+                cmocka_unit_test(test_sroc_access_report_stops),
+                cmocka_unit_test(test_sroc_access_ignores_later_items),
+                cmocka_unit_test(test_sroc_access_counts_across_threads),
+        };
+
+        return cmocka_run_group_tests(tests, NULL, NULL);
+}
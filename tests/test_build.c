@@ -0,0 +1,322 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+#include <sroc.h>
+
+// Enough keys to grow the items, the index and the lookup several times
+#define MANY_KEYS 1000
+
+static char *emit_to_string(const struct sroc_root *root)
+{
+        struct sroc_sink sink;
+
+        sroc_init_buffer_sink(&sink);
+
+        if (sroc_emit(root, &sink) != 0) {
+                sroc_release_sink(&sink);
+
+                return NULL;
+        }
+
+        return sink.buffer.data;
+}
+
+static int count_change(enum sroc_change change, const char *section,
+                        const char *key, const struct sroc_value *old_value,
+                        const struct sroc_value *new_value, void *data)
+{
+        ++*(size_t *)data;
+
+        return 0;
+}
+
+static struct sroc_array *create_number_array(size_t length)
+{
+        struct sroc_array *array = sroc_create_array(SROC_NUMBER);
+
+        for (size_t i = 0; i < length; ++i) {
+                struct sroc_value *value = sroc_create_value(SROC_NUMBER);
+
+                value->number = (int64_t)i;
+                assert_int_equal(0, sroc_array_push(array, value));
+        }
+
+        return array;
+}
+
+static void test_sroc_build_from_empty_root(void **state)
+{
+        struct sroc_root *root = sroc_create_root();
+        struct sroc_table *server;
+        struct sroc_value *name = sroc_create_value(SROC_STRING);
+
+        name->string = strdup("app");
+
+        assert_int_equal(0, sroc_root_set_value(root, "name", name));
+        assert_int_equal(0, sroc_root_add_section(root, "server", &server));
+        assert_int_equal(0, sroc_table_set_number(server, "port", 8080));
+        assert_int_equal(0, sroc_table_set_bool(server, "enabled", true));
+        assert_int_equal(0, sroc_table_set_string(server, "host", "a\"b"));
+        assert_int_equal(
+                0,
+                sroc_table_set_array(server, "ids", create_number_array(3)));
+
+        const char *string;
+        int64_t number;
+        bool boolean;
+        struct sroc_array *array;
+        size_t length;
+
+        assert_int_equal(0, sroc_read_string(root, NULL, "name", &string));
+        assert_string_equal("app", string);
+        assert_int_equal(0, sroc_read_number(root, "server", "port", &number));
+        assert_int_equal(8080, number);
+        assert_int_equal(0,
+                         sroc_read_bool(root, "server", "enabled", &boolean));
+        assert_true(boolean);
+        assert_int_equal(0, sroc_read_string(root, "server", "host", &string));
+        assert_string_equal("a\"b", string);
+        assert_int_equal(
+                0, sroc_read_array(root, "server", "ids", &array, &length));
+        assert_int_equal(3, length);
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_build_replaces_values(void **state)
+{
+        struct sroc_root *root = sroc_parse_string("[server]\n"
+                                                   "port = 80\n"
+                                                   "host = \"old\"\n");
+        struct sroc_table *server;
+        struct sroc_table *again;
+        int64_t number;
+        const char *string;
+
+        assert_int_equal(0, sroc_root_add_section(root, "server", &server));
+        assert_int_equal(0, sroc_root_add_section(root, "server", &again));
+        assert_ptr_equal(server, again);
+        assert_int_equal(1, root->sections_length);
+
+        assert_int_equal(0, sroc_table_set_number(server, "port", 443));
+        assert_int_equal(0, sroc_table_set_string(server, "host", "new"));
+        assert_int_equal(2, server->size);
+        assert_int_equal(0, sroc_read_number(root, "server", "port", &number));
+        assert_int_equal(443, number);
+        assert_int_equal(0, sroc_read_string(root, "server", "host", &string));
+        assert_string_equal("new", string);
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_build_many_keys(void **state)
+{
+        struct sroc_root *root = sroc_parse_string("[t]\nk_seed = 1\n");
+        struct sroc_table *table;
+        char key[32];
+        int64_t number;
+
+        assert_int_equal(0, sroc_root_add_section(root, "t", &table));
+
+        // Descending order so every insert lands at the front of the index
+        for (int i = MANY_KEYS - 1; i >= 0; --i) {
+                snprintf(key, sizeof(key), "k_%04d", i);
+                assert_int_equal(0, sroc_table_set_number(table, key, i));
+        }
+
+        assert_int_equal(MANY_KEYS + 1, table->size);
+        assert_true(table->capacity >= table->size);
+
+        for (int i = 0; i < MANY_KEYS; ++i) {
+                snprintf(key, sizeof(key), "k_%04d", i);
+                assert_int_equal(0, sroc_read_number(root, "t", key, &number));
+                assert_int_equal(i, number);
+        }
+
+        struct sroc_key_cursor cursor;
+        struct sroc_item *item;
+        size_t seen = 0;
+        const char *previous = "";
+
+        sroc_iter_keys_prefix(table, "k_0", &cursor);
+
+        while ((item = sroc_next_key(&cursor)) != NULL) {
+                assert_true(strcmp(previous, item->key) < 0);
+                previous = item->key;
+                ++seen;
+        }
+
+        assert_int_equal(MANY_KEYS, seen);
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_build_sections_sorted(void **state)
+{
+        struct sroc_root *root = sroc_create_root();
+        struct sroc_section_cursor cursor;
+        struct sroc_table *table;
+        char name[32];
+
+        for (int i = 19; i >= 0; --i) {
+                snprintf(name, sizeof(name), "tenant.%02d", i);
+                assert_int_equal(0, sroc_root_add_section(root, name, &table));
+        }
+
+        assert_int_equal(0, sroc_root_add_section(root, "other", &table));
+        assert_int_equal(0, sroc_get_section(root, "tenant.07", &table));
+        assert_string_equal("tenant.07", table->key);
+
+        sroc_iter_sections_prefix(root, "tenant.", &cursor);
+
+        for (int i = 0; i < 20; ++i) {
+                snprintf(name, sizeof(name), "tenant.%02d", i);
+                assert_string_equal(name, sroc_next_section(&cursor)->key);
+        }
+
+        assert_null(sroc_next_section(&cursor));
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_build_errors(void **state)
+{
+        struct sroc_root *root = sroc_create_root();
+        struct sroc_table *table;
+        struct sroc_array *array = create_number_array(2);
+        struct sroc_value *string = sroc_create_value(SROC_STRING);
+
+        string->string = strdup("x");
+
+        assert_int_equal(SROC_ERRTYPE, sroc_array_push(array, string));
+        assert_int_equal(2, array->length);
+        assert_int_equal(SROC_ERRINVAL,
+                         sroc_root_add_section(root, "bad name", &table));
+        assert_int_equal(SROC_ERRINVAL,
+                         sroc_root_add_section(root, "", &table));
+        assert_int_equal(0, sroc_root_add_section(root, "a.b", &table));
+        assert_int_equal(SROC_ERRINVAL,
+                         sroc_table_set_bool(table, "a.b", true));
+        assert_int_equal(SROC_ERRINVAL,
+                         sroc_table_set_array(table, "a=b", array));
+        assert_int_equal(0, table->size);
+
+        sroc_destroy_value(string);
+        sroc_destroy_array(array);
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_freeze_round_trips(void **state)
+{
+        struct sroc_root *root = sroc_create_root();
+        struct sroc_table *table;
+        struct sroc_array *array = create_number_array(1);
+
+        assert_int_equal(0, sroc_root_add_section(root, "server", &table));
+        assert_int_equal(0, sroc_table_set_number(table, "port", 80));
+        assert_int_equal(0, sroc_table_set_array(table, "ids", array));
+
+        // Pushed after the array was set, freeze has to pick it up
+        struct sroc_value *value = sroc_create_value(SROC_NUMBER);
+
+        value->number = 7;
+        assert_int_equal(0, sroc_array_push(array, value));
+
+        assert_int_equal(0, sroc_freeze(root));
+        assert_int_equal(1, root->sections_capacity);
+        assert_int_equal(2, table->capacity);
+        assert_int_equal(2, array->capacity);
+
+        char *emitted = emit_to_string(root);
+
+        assert_string_equal("[server]\nport = 80\nids = [0, 7]\n", emitted);
+
+        struct sroc_root *parsed = sroc_parse_string(emitted);
+        size_t changes = 0;
+
+        assert_non_null(parsed);
+        assert_int_equal(0, sroc_diff(root, parsed, count_change, &changes));
+        assert_int_equal(0, changes);
+
+        // The root can still be changed after it was frozen
+        assert_int_equal(0, sroc_table_set_number(table, "port", 81));
+        assert_int_equal(0, sroc_table_set_bool(table, "tls", true));
+        assert_int_equal(0, sroc_diff(parsed, root, count_change, &changes));
+        assert_int_equal(2, changes);
+
+        free(emitted);
+        sroc_destroy_root(parsed);
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_push_rejects_frozen_arrays(void **state)
+{
+        struct sroc_root *root = sroc_parse_string("a = [1, 2]\n"
+                                                   "[s]\nb = [3]\n");
+        struct sroc_root *grown = sroc_parse_string("a = [1, 2, 3]\n"
+                                                    "[s]\nb = [3]\n");
+        struct sroc_root *derived;
+        struct sroc_table *table;
+        struct sroc_array *array;
+        struct sroc_value *value = sroc_create_value(SROC_NUMBER);
+        size_t length;
+        size_t changes = 0;
+
+        value->number = 3;
+
+        assert_int_equal(0, sroc_read_array(root, NULL, "a", &array, &length));
+        assert_int_equal(SROC_ERRINVAL, sroc_array_push(array, value));
+        assert_int_equal(2, array->length);
+
+        // Arrays read through a derived root belong to its base
+        assert_int_equal(0, sroc_derive(root, &derived));
+        assert_int_equal(
+                0, sroc_read_array(derived, "s", "b", &array, &length));
+        assert_int_equal(SROC_ERRINVAL, sroc_array_push(array, value));
+        sroc_destroy_root(derived);
+
+        assert_int_equal(0, sroc_freeze(root));
+        assert_int_equal(0, root->items_hash);
+        assert_int_equal(0, root->sections[0]->hash);
+        assert_int_equal(0, sroc_diff(root, grown, count_change, &changes));
+        assert_int_equal(1, changes);
+
+        // Built arrays can be pushed onto until they are frozen
+        array = create_number_array(1);
+        assert_int_equal(0, sroc_root_add_section(root, "t", &table));
+        assert_int_equal(0, sroc_table_set_array(table, "c", array));
+        assert_int_equal(0, sroc_array_push(array, value));
+        assert_int_equal(0, sroc_freeze(root));
+
+        value = sroc_create_value(SROC_NUMBER);
+        assert_int_equal(SROC_ERRINVAL, sroc_array_push(array, value));
+
+        sroc_destroy_value(value);
+        sroc_destroy_root(grown);
+        sroc_destroy_root(root);
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test(test_sroc_build_from_empty_root),
+                cmocka_unit_test(test_sroc_build_replaces_values),
+                cmocka_unit_test(test_sroc_build_many_keys),
+                cmocka_unit_test(test_sroc_build_sections_sorted),
+                cmocka_unit_test(test_sroc_build_errors),
+                cmocka_unit_test(test_sroc_freeze_round_trips),
+                cmocka_unit_test(test_sroc_push_rejects_frozen_arrays),
+        };
+
+        return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,284 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+#include <sroc.h>
+
+static const char *base_string = "name = \"app\"\n"
+                                 "\n"
+                                 "[server]\n"
+                                 "port = 80\n"
+                                 "host = \"localhost\"\n"
+                                 "\n"
+                                 "[tenant.a]\n"
+                                 "quota = 10\n"
+                                 "\n"
+                                 "[tenant.c]\n"
+                                 "quota = 30\n";
+
+static char *emit_to_string(const struct sroc_root *root)
+{
+        struct sroc_sink sink;
+
+        sroc_init_buffer_sink(&sink);
+
+        if (sroc_emit(root, &sink) != 0) {
+                sroc_release_sink(&sink);
+
+                return NULL;
+        }
+
+        return sink.buffer.data;
+}
+
+struct recorded_changes {
+        size_t length;
+        char lines[8][64];
+};
+
+static int record_change(enum sroc_change change, const char *section,
+                         const char *key, const struct sroc_value *old_value,
+                         const struct sroc_value *new_value, void *data)
+{
+        struct recorded_changes *changes = data;
+
+        snprintf(changes->lines[changes->length++],
+                 sizeof(changes->lines[0]),
+                 "%d %s.%s",
+                 (int)change,
+                 (section == NULL) ? "" : section,
+                 key);
+
+        return 0;
+}
+
+static void test_sroc_derive_reads_base(void **state)
+{
+        struct sroc_root *base = sroc_parse_string(base_string);
+        struct sroc_root *derived;
+        struct sroc_table *table;
+        int64_t number;
+        const char *string;
+
+        assert_int_equal(0, sroc_derive(base, &derived));
+        assert_int_equal(0, derived->sections_length);
+        assert_ptr_equal(base->items, derived->items);
+
+        assert_int_equal(0, sroc_read_string(derived, NULL, "name", &string));
+        assert_string_equal("app", string);
+        assert_int_equal(0,
+                         sroc_read_number(derived, "server", "port", &number));
+        assert_int_equal(80, number);
+        assert_int_equal(0, sroc_get_section(derived, "tenant.a", &table));
+        assert_ptr_equal(base->sections[1], table);
+        assert_int_equal(SROC_ERRNOSECTION,
+                         sroc_read_number(derived, "missing", "port", &number));
+        assert_int_equal(
+                SROC_ERRNOKEY,
+                sroc_read_number(derived, "server", "missing", &number));
+
+        sroc_destroy_root(derived);
+        sroc_destroy_root(base);
+}
+
+static void test_sroc_derive_copies_changed_tables(void **state)
+{
+        struct sroc_root *base = sroc_parse_string(base_string);
+        struct sroc_root *derived;
+        struct sroc_table *table;
+        int64_t number;
+        const char *string;
+
+        assert_int_equal(0, sroc_derive(base, &derived));
+        assert_int_equal(0, sroc_root_add_section(derived, "server", &table));
+        assert_ptr_not_equal(base->sections[0], table);
+        assert_ptr_equal(base->sections[0]->items[1], table->items[1]);
+        assert_int_equal(0, sroc_table_set_number(table, "port", 8080));
+        assert_int_equal(0, sroc_table_set_bool(table, "tls", true));
+        assert_int_equal(1, derived->sections_length);
+
+        assert_int_equal(0,
+                         sroc_read_number(derived, "server", "port", &number));
+        assert_int_equal(8080, number);
+        assert_int_equal(
+                0, sroc_read_string(derived, "server", "host", &string));
+        assert_string_equal("localhost", string);
+        assert_int_equal(0, sroc_read_number(base, "server", "port", &number));
+        assert_int_equal(80, number);
+
+        // A section the base does not have is added to the derived root only
+        assert_int_equal(0, sroc_root_add_section(derived, "tenant.b", &table));
+        assert_int_equal(0, sroc_table_set_number(table, "quota", 20));
+        assert_int_equal(SROC_ERRNOSECTION,
+                         sroc_read_number(base, "tenant.b", "quota", &number));
+
+        sroc_destroy_root(derived);
+        sroc_destroy_root(base);
+}
+
+static void test_sroc_derive_root_items(void **state)
+{
+        struct sroc_root *base = sroc_parse_string(base_string);
+        struct sroc_root *derived;
+        struct sroc_value *value = sroc_create_value(SROC_NUMBER);
+        const char *string;
+        int64_t number;
+
+        value->number = 3;
+
+        assert_int_equal(0, sroc_derive(base, &derived));
+        assert_int_equal(0, sroc_root_set_value(derived, "replicas", value));
+        assert_ptr_not_equal(base->items, derived->items);
+        assert_int_equal(
+                0, sroc_read_number(derived, NULL, "replicas", &number));
+        assert_int_equal(3, number);
+        assert_int_equal(0, sroc_read_string(derived, NULL, "name", &string));
+        assert_int_equal(SROC_ERRNOKEY,
+                         sroc_read_number(base, NULL, "replicas", &number));
+
+        value = sroc_create_value(SROC_STRING);
+        value->string = strdup("tenant");
+
+        assert_int_equal(0, sroc_root_set_value(derived, "name", value));
+        assert_int_equal(0, sroc_read_string(derived, NULL, "name", &string));
+        assert_string_equal("tenant", string);
+        assert_int_equal(0, sroc_read_string(base, NULL, "name", &string));
+        assert_string_equal("app", string);
+
+        sroc_destroy_root(derived);
+        sroc_destroy_root(base);
+}
+
+static void test_sroc_derive_outlives_base(void **state)
+{
+        struct sroc_root *base = sroc_parse_string(base_string);
+        struct sroc_root *first;
+        struct sroc_root *second;
+        struct sroc_table *table;
+        int64_t number;
+
+        assert_int_equal(0, sroc_derive(base, &first));
+        assert_int_equal(0, sroc_derive(base, &second));
+        assert_int_equal(0, sroc_root_add_section(first, "server", &table));
+        assert_int_equal(0, sroc_table_set_number(table, "port", 1));
+
+        sroc_destroy_root(base);
+
+        assert_int_equal(0, sroc_read_number(first, "server", "port", &number));
+        assert_int_equal(1, number);
+
+        sroc_destroy_root(first);
+
+        assert_int_equal(
+                0, sroc_read_number(second, "server", "port", &number));
+        assert_int_equal(80, number);
+
+        sroc_destroy_root(second);
+}
+
+static void test_sroc_derive_iterates_merged(void **state)
+{
+        struct sroc_root *base = sroc_parse_string(base_string);
+        struct sroc_root *derived;
+        struct sroc_section_cursor cursor;
+        struct sroc_table *table;
+        struct sroc_table *copy;
+
+        assert_int_equal(0, sroc_derive(base, &derived));
+        assert_int_equal(0, sroc_root_add_section(derived, "tenant.b", &table));
+        assert_int_equal(0, sroc_root_add_section(derived, "tenant.c", &copy));
+
+        sroc_iter_sections_prefix(derived, "tenant.", &cursor);
+
+        assert_ptr_equal(base->sections[1], sroc_next_section(&cursor));
+        assert_ptr_equal(table, sroc_next_section(&cursor));
+        assert_ptr_equal(copy, sroc_next_section(&cursor));
+        assert_null(sroc_next_section(&cursor));
+
+        sroc_destroy_root(derived);
+        sroc_destroy_root(base);
+}
+
+static void test_sroc_derive_emit_and_diff(void **state)
+{
+        struct sroc_root *base = sroc_parse_string(base_string);
+        struct sroc_root *derived;
+        struct sroc_table *table;
+        struct recorded_changes changes = {0};
+
+        assert_int_equal(0, sroc_derive(base, &derived));
+        assert_int_equal(0, sroc_root_add_section(derived, "tenant.a", &table));
+        assert_int_equal(0, sroc_table_set_number(table, "quota", 11));
+        assert_int_equal(0, sroc_root_add_section(derived, "extra", &table));
+        assert_int_equal(0, sroc_table_set_bool(table, "on", true));
+
+        char *emitted = emit_to_string(derived);
+
+        assert_string_equal("name = \"app\"\n"
+                            "\n"
+                            "[server]\n"
+                            "port = 80\n"
+                            "host = \"localhost\"\n"
+                            "\n"
+                            "[tenant.a]\n"
+                            "quota = 11\n"
+                            "\n"
+                            "[tenant.c]\n"
+                            "quota = 30\n"
+                            "\n"
+                            "[extra]\n"
+                            "on = true\n",
+                            emitted);
+
+        assert_int_equal(0, sroc_diff(base, derived, record_change, &changes));
+        assert_int_equal(2, changes.length);
+        assert_string_equal("2 tenant.a.quota", changes.lines[0]);
+        assert_string_equal("0 extra.on", changes.lines[1]);
+
+        free(emitted);
+        sroc_destroy_root(derived);
+        sroc_destroy_root(base);
+}
+
+static void test_sroc_derive_errors(void **state)
+{
+        struct sroc_root *base = sroc_parse_string(base_string);
+        struct sroc_root *derived;
+        struct sroc_root *again;
+
+        assert_int_equal(0, sroc_derive(base, &derived));
+        assert_int_equal(SROC_ERRINVAL, sroc_derive(derived, &again));
+        assert_int_equal(SROC_ERRINVAL, sroc_freeze(base));
+        assert_null(sroc_reparse(base, "a = 1\n", 6));
+        assert_int_equal(0, sroc_freeze(derived));
+
+        sroc_destroy_root(derived);
+
+        assert_int_equal(0, sroc_freeze(base));
+
+        sroc_destroy_root(base);
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test(test_sroc_derive_reads_base),
+                cmocka_unit_test(test_sroc_derive_copies_changed_tables),
+                cmocka_unit_test(test_sroc_derive_root_items),
+                cmocka_unit_test(test_sroc_derive_outlives_base),
+                cmocka_unit_test(test_sroc_derive_iterates_merged),
+                cmocka_unit_test(test_sroc_derive_emit_and_diff),
+                cmocka_unit_test(test_sroc_derive_errors),
+        };
+
+        return cmocka_run_group_tests(tests, NULL, NULL);
+}
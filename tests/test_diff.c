@@ -0,0 +1,203 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+#include <sroc.h>
+
+struct recorded_changes {
+        size_t length;
+        char lines[16][64];
+        int stop_after;
+};
+
+static int record_change(enum sroc_change change, const char *section,
+                         const char *key, const struct sroc_value *old_value,
+                         const struct sroc_value *new_value, void *data)
+{
+        static const char *change_names[] = {"added", "removed", "modified"};
+        struct recorded_changes *changes = data;
+
+        if (change == SROC_ADDED) {
+                assert_null(old_value);
+                assert_non_null(new_value);
+        } else if (change == SROC_REMOVED) {
+                assert_non_null(old_value);
+                assert_null(new_value);
+        } else {
+                assert_non_null(old_value);
+                assert_non_null(new_value);
+        }
+
+        snprintf(changes->lines[changes->length++],
+                 sizeof(changes->lines[0]),
+                 "%s %s.%s",
+                 change_names[change],
+                 (section == NULL) ? "" : section,
+                 key);
+
+        if (changes->stop_after != 0
+            && (int)changes->length == changes->stop_after) {
+                return 42;
+        }
+
+        return 0;
+}
+
+static void diff_strings(const char *old_string, const char *new_string,
+                         struct recorded_changes *changes)
+{
+        struct sroc_root *old_root = sroc_parse_string(old_string);
+        struct sroc_root *new_root = sroc_parse_string(new_string);
+
+        assert_non_null(old_root);
+        assert_non_null(new_root);
+
+        changes->length = 0;
+
+        assert_int_equal(0,
+                         sroc_diff(old_root, new_root, record_change, changes));
+
+        sroc_destroy_root(old_root);
+        sroc_destroy_root(new_root);
+}
+
+static void test_sroc_diff_identical(void **state)
+{
+        struct recorded_changes changes = {0};
+
+        diff_strings("a = 1\n[s]\nb = [1, 2]\n",
+                     "a = 1\n[s]\nb = [1, 2]\n",
+                     &changes);
+
+        assert_int_equal(0, changes.length);
+}
+
+static void test_sroc_diff_formatting_only(void **state)
+{
+        struct recorded_changes changes = {0};
+
+        diff_strings("a = 1,000\n[s]\nb = [1, 2] # old\n",
+                     "a=1000\n\n[s]\n  b = [\n 1,\n 2,\n]\n",
+                     &changes);
+
+        assert_int_equal(0, changes.length);
+}
+
+static void test_sroc_diff_changes(void **state)
+{
+        struct recorded_changes changes = {0};
+
+        diff_strings("a = 1\n"
+                     "[s]\n"
+                     "port = 80\n"
+                     "hosts = [\"x\"]\n"
+                     "gone = true\n"
+                     "[old]\n"
+                     "k = 1\n",
+                     "a = 1\n"
+                     "[new]\n"
+                     "k = 1\n"
+                     "[s]\n"
+                     "hosts = [\"x\", \"y\"]\n"
+                     "port = 80\n"
+                     "extra = \"e\"\n",
+                     &changes);
+
+        assert_int_equal(5, changes.length);
+        assert_string_equal("added new.k", changes.lines[0]);
+        assert_string_equal("modified s.hosts", changes.lines[1]);
+        assert_string_equal("added s.extra", changes.lines[2]);
+        assert_string_equal("removed s.gone", changes.lines[3]);
+        assert_string_equal("removed old.k", changes.lines[4]);
+}
+
+static void test_sroc_diff_root_items(void **state)
+{
+        struct recorded_changes changes = {0};
+
+        diff_strings("a = 1\nb = 2\n", "a = 2\nc = 3\n", &changes);
+
+        assert_int_equal(3, changes.length);
+        assert_string_equal("modified .a", changes.lines[0]);
+        assert_string_equal("added .c", changes.lines[1]);
+        assert_string_equal("removed .b", changes.lines[2]);
+}
+
+static void test_sroc_diff_type_change(void **state)
+{
+        struct recorded_changes changes = {0};
+
+        diff_strings("a = 1\n", "a = \"1\"\n", &changes);
+
+        assert_int_equal(1, changes.length);
+        assert_string_equal("modified .a", changes.lines[0]);
+}
+
+static void test_sroc_diff_colliding_values(void **state)
+{
+        struct recorded_changes changes = {0};
+
+        // These arrays share a value hash but are not equal
+        diff_strings("a = [5, 2727427253609430886]\n", "a = [1, 2]\n",
+                     &changes);
+
+        assert_int_equal(1, changes.length);
+        assert_string_equal("modified .a", changes.lines[0]);
+}
+
+static void test_sroc_diff_colliding_sections(void **state)
+{
+        struct recorded_changes changes = {0};
+        struct sroc_root *old_root = sroc_parse_string("[s]\na = 1\n");
+        struct sroc_root *new_root = sroc_parse_string("[s]\na = 2\n");
+
+        new_root->sections[0]->hash = old_root->sections[0]->hash;
+
+        assert_int_equal(0, sroc_diff(old_root, new_root, record_change,
+                                      &changes));
+        assert_int_equal(1, changes.length);
+        assert_string_equal("modified s.a", changes.lines[0]);
+
+        sroc_destroy_root(old_root);
+        sroc_destroy_root(new_root);
+}
+
+static void test_sroc_diff_callback_stops(void **state)
+{
+        struct recorded_changes changes = {.stop_after = 1};
+        struct sroc_root *old_root = sroc_parse_string("a = 1\nb = 1\n");
+        struct sroc_root *new_root = sroc_parse_string("a = 2\nb = 2\n");
+
+        int result = sroc_diff(old_root, new_root, record_change, &changes);
+
+        assert_int_equal(42, result);
+        assert_int_equal(1, changes.length);
+
+        sroc_destroy_root(old_root);
+        sroc_destroy_root(new_root);
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test(test_sroc_diff_identical),
+                cmocka_unit_test(test_sroc_diff_formatting_only),
+                cmocka_unit_test(test_sroc_diff_changes),
+                cmocka_unit_test(test_sroc_diff_root_items),
+                cmocka_unit_test(test_sroc_diff_type_change),
+                cmocka_unit_test(test_sroc_diff_colliding_values),
+                cmocka_unit_test(test_sroc_diff_colliding_sections),
+                cmocka_unit_test(test_sroc_diff_callback_stops),
+        };
+
+        return cmocka_run_group_tests(tests, NULL, NULL);
+}
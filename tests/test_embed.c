@@ -0,0 +1,156 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+#include <sroc.h>
+
+#include "sroc_config_embedded.h"
+
+static const struct sroc_root *root = &sroc_config_embedded;
+
+static int count_change(enum sroc_change change, const char *section,
+                        const char *key, const struct sroc_value *old_value,
+                        const struct sroc_value *new_value, void *data)
+{
+        ++*(size_t *)data;
+
+        return 0;
+}
+
+static void test_embedded_read(void **state)
+{
+        const char *string;
+        int64_t number;
+        bool boolean;
+        struct sroc_array *array;
+        size_t length;
+        struct sroc_object *object;
+        const struct sroc_value *value;
+
+        assert_int_equal(0, sroc_read_string(root, NULL, "name", &string));
+        assert_string_equal("embedded \"defaults\"", string);
+        assert_int_equal(0, sroc_read_number(root, "net", "port", &number));
+        assert_int_equal(8080, number);
+        assert_int_equal(0, sroc_read_bool(root, "net", "tls", &boolean));
+        assert_true(boolean);
+        assert_int_equal(
+                0, sroc_read_array(root, "net", "limits", &array, &length));
+        assert_int_equal(2, length);
+        assert_true(array->items[1]->array->items[0]->number == INT64_MIN);
+        assert_int_equal(0, sroc_read_object(root, "net", "pool", &object));
+        assert_int_equal(0, sroc_object_get(object, "retry", &value));
+        assert_int_equal(0, sroc_object_get(value->object, "backoff", &value));
+        assert_int_equal(-1, value->number);
+        assert_int_equal(0, sroc_read_object(root, "net", "weights", &object));
+        assert_int_equal(0, sroc_object_get(object, "i", &value));
+        assert_int_equal(9, value->number);
+        assert_int_equal(SROC_ERRNOKEY,
+                         sroc_read_number(root, "net", "missing", &number));
+        assert_int_equal(SROC_ERRNOSECTION,
+                         sroc_read_number(root, "missing", "port", &number));
+}
+
+static void test_embedded_lookup_is_perfect(void **state)
+{
+        const struct sroc_lookup *lookup = &root->sections_lookup;
+
+        assert_non_null(lookup->seeds);
+
+        // Every slot holds a distinct section, so every key is one probe away
+        size_t used = 0;
+
+        for (size_t i = 0; i <= lookup->mask; ++i) {
+                if (lookup->slots[i] != SROC_EMPTY_SLOT) {
+                        ++used;
+                }
+        }
+
+        assert_int_equal(root->sections_length, used);
+}
+
+static void test_embedded_prefix_iteration(void **state)
+{
+        struct sroc_section_cursor cursor;
+
+        sroc_iter_sections_prefix(root, "tenant_", &cursor);
+
+        assert_string_equal("tenant_a", sroc_next_section(&cursor)->key);
+        assert_string_equal("tenant_b", sroc_next_section(&cursor)->key);
+        assert_null(sroc_next_section(&cursor));
+}
+
+static void test_embedded_matches_parsed(void **state)
+{
+        FILE *file = fopen(EMBEDDED_CONF_PATH, "r");
+
+        assert_non_null(file);
+
+        struct sroc_root *parsed = sroc_parse_file(file);
+        size_t changes = 0;
+
+        fclose(file);
+
+        assert_non_null(parsed);
+        assert_int_equal(0, sroc_diff(parsed, root, count_change, &changes));
+        assert_int_equal(0, changes);
+
+        sroc_destroy_root(parsed);
+}
+
+/**
+ * Defaults built into the program with overrides layered on top. The
+ * embedded root is read only, so it must never be counted or freed
+ */
+static void test_embedded_derive(void **state)
+{
+        struct sroc_root *base = (struct sroc_root *)root;
+        struct sroc_root *derived;
+        struct sroc_table *table;
+        struct sroc_value *value = sroc_create_value(SROC_STRING);
+        const char *string;
+        int64_t number;
+
+        value->string = strdup("tenant");
+
+        assert_int_equal(SROC_STATIC_ROOT, root->references);
+        assert_int_equal(0, sroc_derive(base, &derived));
+        assert_int_equal(0, sroc_root_add_section(derived, "net", &table));
+        assert_int_equal(0, sroc_table_set_number(table, "port", 9090));
+        assert_int_equal(0, sroc_root_set_value(derived, "name", value));
+
+        assert_int_equal(0, sroc_read_number(derived, "net", "port", &number));
+        assert_int_equal(9090, number);
+        assert_int_equal(0, sroc_read_string(derived, NULL, "name", &string));
+        assert_string_equal("tenant", string);
+        assert_int_equal(0, sroc_read_number(root, "net", "port", &number));
+        assert_int_equal(8080, number);
+
+        sroc_destroy_root(derived);
+        sroc_destroy_root(base);
+
+        assert_int_equal(SROC_STATIC_ROOT, root->references);
+        assert_int_equal(0, sroc_read_string(root, NULL, "name", &string));
+        assert_string_equal("embedded \"defaults\"", string);
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test(test_embedded_read),
+                cmocka_unit_test(test_embedded_lookup_is_perfect),
+                cmocka_unit_test(test_embedded_prefix_iteration),
+                cmocka_unit_test(test_embedded_matches_parsed),
+                cmocka_unit_test(test_embedded_derive),
+        };
+
+        return cmocka_run_group_tests(tests, NULL, NULL);
+}
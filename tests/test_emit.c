@@ -0,0 +1,186 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+#include <sroc.h>
+
+static const char *canonical_string = "name = \"Jane \\\"JD\\\" Doe\\\\\"\n"
+                                      "count = -9223372036854775808\n"
+                                      "\n"
+                                      "[server]\n"
+                                      "port = 8080\n"
+                                      "enabled = false\n"
+                                      "hosts = [\"a\", \"b\"]\n"
+                                      "matrix = [[1, 2], [], [-3]]\n"
+                                      "note = \"line one\\\nline two\"\n"
+                                      "\n"
+                                      "[empty]\n";
+
+static char *emit_to_string(const struct sroc_root *root)
+{
+        struct sroc_sink sink;
+
+        sroc_init_buffer_sink(&sink);
+
+        if (sroc_emit(root, &sink) != 0) {
+                sroc_release_sink(&sink);
+
+                return NULL;
+        }
+
+        return sink.buffer.data;
+}
+
+static void test_sroc_emit_canonical_round_trip(void **state)
+{
+        struct sroc_root *root = sroc_parse_string(canonical_string);
+
+        assert_non_null(root);
+
+        char *emitted = emit_to_string(root);
+
+        assert_non_null(emitted);
+        assert_string_equal(canonical_string, emitted);
+
+        free(emitted);
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_emit_normalizes(void **state)
+{
+        const char *test_string = "  a=1,000 # comment\n"
+                                  "b = [ 1,\n 2, ]\n";
+        const char *expected_string = "a = 1000\nb = [1, 2]\n";
+        struct sroc_root *root = sroc_parse_string(test_string);
+
+        assert_non_null(root);
+
+        char *emitted = emit_to_string(root);
+
+        assert_string_equal(expected_string, emitted);
+
+        free(emitted);
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_emit_buffer_appends(void **state)
+{
+        struct sroc_root *root = sroc_parse_string("a = 1\n");
+        struct sroc_sink sink;
+
+        sroc_init_buffer_sink(&sink);
+
+        assert_int_equal(0, sroc_emit(root, &sink));
+        assert_int_equal(0, sroc_emit(root, &sink));
+        assert_int_equal(strlen("a = 1\na = 1\n"), sink.buffer.length);
+        assert_string_equal("a = 1\na = 1\n", sink.buffer.data);
+
+        sroc_release_sink(&sink);
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_emit_file_sink(void **state)
+{
+        struct sroc_root *root = sroc_parse_string(canonical_string);
+        FILE *file = tmpfile();
+        struct sroc_sink sink;
+
+        assert_non_null(file);
+
+        sroc_init_file_sink(&sink, file);
+
+        assert_int_equal(0, sroc_emit(root, &sink));
+
+        rewind(file);
+
+        struct sroc_root *reparsed = sroc_parse_file(file);
+        char *emitted = emit_to_string(reparsed);
+
+        assert_string_equal(canonical_string, emitted);
+
+        free(emitted);
+        sroc_destroy_root(reparsed);
+        sroc_destroy_root(root);
+        fclose(file);
+}
+
+static void test_sroc_emit_fd_sink_large_string(void **state)
+{
+        size_t length = 200 * 1024;
+        char *large = malloc(length + 1);
+        struct sroc_root *root = sroc_create_root();
+        struct sroc_item *item = malloc(sizeof(struct sroc_item));
+        struct sroc_value *value = malloc(sizeof(struct sroc_value));
+        struct sroc_item *items[] = {item};
+        FILE *file = tmpfile();
+        struct sroc_sink sink;
+
+        for (size_t i = 0; i < length; ++i) {
+                large[i] = (i % 1000 == 999) ? '"' : 'x';
+        }
+
+        large[length] = '\0';
+        value->type = SROC_STRING;
+        value->string = large;
+        item->key = "large";
+        item->value = value;
+        root->items = items;
+        root->items_length = 1;
+
+        sroc_init_fd_sink(&sink, fileno(file));
+
+        assert_int_equal(0, sroc_emit(root, &sink));
+
+        rewind(file);
+
+        struct sroc_root *reparsed = sroc_parse_file(file);
+
+        assert_non_null(reparsed);
+        assert_string_equal(large, reparsed->items[0]->value->string);
+
+        sroc_destroy_root(reparsed);
+        fclose(file);
+        free(large);
+        free(value);
+        free(item);
+        free(root);
+}
+
+static void test_sroc_emit_invalid_key(void **state)
+{
+        struct sroc_root *root = sroc_parse_string("a = 1\n");
+        struct sroc_sink sink;
+        char *key = root->items[0]->key;
+
+        root->items[0]->key = "not a key";
+        sroc_init_buffer_sink(&sink);
+
+        assert_int_equal(SROC_ERRINVAL, sroc_emit(root, &sink));
+
+        root->items[0]->key = key;
+        sroc_release_sink(&sink);
+        sroc_destroy_root(root);
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test(test_sroc_emit_canonical_round_trip),
+                cmocka_unit_test(test_sroc_emit_normalizes),
+                cmocka_unit_test(test_sroc_emit_buffer_appends),
+                cmocka_unit_test(test_sroc_emit_file_sink),
+                cmocka_unit_test(test_sroc_emit_fd_sink_large_string),
+                cmocka_unit_test(test_sroc_emit_invalid_key),
+        };
+
+        return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,128 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <csetjmp>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
+extern "C" {
+#include <cmocka.h>
+}
+
+#include <sroc.hpp>
+
+using namespace sroc::literals;
+
+static const char *test_string = "name = \"app\"\n"
+                                 "\n"
+                                 "[net]\n"
+                                 "port = 8080\n"
+                                 "host = \"localhost\"\n"
+                                 "tls = true\n"
+                                 "ids = [1, 2]\n";
+
+// Hashed by the compiler, compared against the library below
+static_assert("port"_key.hash() == sroc::key("port").hash());
+static_assert("net"_sec.name() == "net");
+
+// Names stop at the first null, as they do for the lookups
+static_assert("po\0rt"_key.hash() == "po"_key.hash());
+
+static void test_sroc_hpp_hash_matches_library(void **state)
+{
+        static const char *const names[] = {
+                "",
+                "a",
+                "port",
+                "abcdefg",
+                "abcdefgh",
+                "abcdefghi",
+                "tenant_000042",
+                "a_key_name_well_past_two_blocks",
+                "\xf0\x9f\x91\x8b",
+        };
+
+        for (const char *name : names) {
+                assert_true(sroc::key(name).hash()
+                            == sroc_hash_key(name, std::strlen(name)));
+        }
+}
+
+static void test_sroc_hpp_get(void **state)
+{
+        sroc::root cfg = sroc::root::parse(test_string);
+
+        assert_true(static_cast<bool>(cfg));
+        assert_int_equal(8080, *cfg.get<int64_t>("net"_sec, "port"_key));
+        assert_true(*cfg.get<bool>("net"_sec, "tls"_key));
+        assert_true(cfg.get<std::string_view>("net"_sec, "host"_key)
+                    == "localhost");
+        assert_true(cfg.get<std::string_view>("name"_key) == "app");
+        auto ids = cfg.get<const sroc_array *>("net"_sec, "ids"_key);
+
+        assert_int_equal(2, (*ids)->length);
+
+        assert_false(cfg.get<int64_t>("net"_sec, "missing"_key).has_value());
+        assert_false(cfg.get<int64_t>("missing"_sec, "port"_key).has_value());
+        assert_false(cfg.get<bool>("net"_sec, "port"_key).has_value());
+
+        int64_t number = 0;
+
+        assert_int_equal(0, cfg.read("net"_sec, "port"_key, number));
+        assert_int_equal(SROC_ERRNOSECTION,
+                         cfg.read("missing"_sec, "port"_key, number));
+        assert_int_equal(SROC_ERRNOKEY, cfg.read("port"_key, number));
+        assert_int_equal(SROC_ERRTYPE, cfg.read("name"_key, number));
+}
+
+static void test_sroc_hpp_moves(void **state)
+{
+        sroc::root cfg = sroc::root::parse(test_string);
+        sroc_root *handle = cfg.handle();
+        sroc::root moved = std::move(cfg);
+
+        assert_false(static_cast<bool>(cfg));
+        assert_ptr_equal(handle, moved.handle());
+
+        cfg = std::move(moved);
+
+        assert_ptr_equal(handle, cfg.handle());
+        assert_int_equal(8080, *cfg.get<int64_t>("net"_sec, "port"_key));
+
+        sroc_destroy_root(cfg.release());
+
+        assert_null(cfg.handle());
+}
+
+static void test_sroc_hpp_parse_error(void **state)
+{
+        int error = 0;
+        sroc::root cfg = sroc::root::parse("a = ", nullptr, &error);
+
+        assert_false(static_cast<bool>(cfg));
+        assert_int_equal(SROC_ERRINVAL, error);
+
+        // An empty root reads as missing rather than crashing
+        int64_t port = 0;
+
+        assert_false(cfg.get<int64_t>("net"_sec, "port"_key).has_value());
+        assert_false(cfg.get<std::string_view>("name"_key).has_value());
+        assert_int_equal(SROC_ERRINVAL, cfg.read("net"_sec, "port"_key, port));
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test(test_sroc_hpp_hash_matches_library),
+                cmocka_unit_test(test_sroc_hpp_get),
+                cmocka_unit_test(test_sroc_hpp_moves),
+                cmocka_unit_test(test_sroc_hpp_parse_error),
+        };
+
+        return cmocka_run_group_tests(tests, NULL, NULL);
+}
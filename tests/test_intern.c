@@ -0,0 +1,178 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+#include <sroc.h>
+
+static const char *test_string = "host = \"localhost\"\n"
+                                 "\n"
+                                 "[a]\n"
+                                 "host = \"localhost\"\n"
+                                 "port = 80\n"
+                                 "motd = \"say \\\"hi\\\"\"\n"
+                                 "pools = [\"primary\", \"secondary\"]\n"
+                                 "\n"
+                                 "[b]\n"
+                                 "port = 81\n"
+                                 "host = \"remote\"\n"
+                                 "motd = \"say \\\"hi\\\"\"\n"
+                                 "pools = [\"secondary\"]\n";
+
+static const struct sroc_item *find_item(const struct sroc_table *table,
+                                         const char *key)
+{
+        for (size_t i = 0; i < table->size; ++i) {
+                if (strcmp(table->items[i]->key, key) == 0) {
+                        return table->items[i];
+                }
+        }
+
+        return NULL;
+}
+
+static void test_sroc_intern_shares_keys_and_strings(void **state)
+{
+        struct sroc_root *root = sroc_parse_string(test_string);
+        struct sroc_table *a;
+        struct sroc_table *b;
+
+        assert_non_null(root);
+        assert_int_equal(0, sroc_get_section(root, "a", &a));
+        assert_int_equal(0, sroc_get_section(root, "b", &b));
+
+        const struct sroc_item *a_port = find_item(a, "port");
+        const struct sroc_item *b_port = find_item(b, "port");
+        const struct sroc_item *a_host = find_item(a, "host");
+        const struct sroc_item *a_motd = find_item(a, "motd");
+        const struct sroc_item *b_motd = find_item(b, "motd");
+
+        assert_true(a_port->interned);
+        assert_ptr_equal(a_port->key, b_port->key);
+        assert_ptr_equal(root->items[0]->key, a_host->key);
+        assert_ptr_equal(root->items[0]->value->string,
+                         a_host->value->string);
+
+        // Strings with escapes are shared by their decoded text
+        assert_string_equal("say \"hi\"", a_motd->value->string);
+        assert_ptr_equal(a_motd->value->string, b_motd->value->string);
+
+        const struct sroc_array *a_pools = find_item(a, "pools")->value->array;
+        const struct sroc_array *b_pools = find_item(b, "pools")->value->array;
+
+        assert_true(a_pools->items[1]->interned);
+        assert_ptr_equal(a_pools->items[1]->string, b_pools->items[0]->string);
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_intern_long_strings(void **state)
+{
+        // Too long to be interned, each keeps a copy of its own
+        size_t length = 300;
+        char *buffer = malloc(2 * (length + 8) + 1);
+        size_t used = 0;
+
+        for (int i = 0; i < 2; ++i) {
+                used += (size_t)sprintf(buffer + used, "%c = \"", 'a' + i);
+                memset(buffer + used, 'x', length);
+                used += length;
+                used += (size_t)sprintf(buffer + used, "\"\n");
+        }
+
+        struct sroc_root *root = sroc_parse_buffer(buffer, used);
+
+        assert_non_null(root);
+        assert_false(root->items[0]->value->interned);
+        assert_ptr_not_equal(root->items[0]->value->string,
+                             root->items[1]->value->string);
+        assert_string_equal(root->items[0]->value->string,
+                            root->items[1]->value->string);
+
+        sroc_destroy_root(root);
+        free(buffer);
+}
+
+static void test_sroc_intern_key(void **state)
+{
+        struct sroc_root *root = sroc_parse_string(test_string);
+        struct sroc_table *b;
+        struct sroc_key section;
+        struct sroc_key key;
+        const struct sroc_value *value;
+        char name[] = "port";
+
+        assert_int_equal(0, sroc_get_section(root, "b", &b));
+        assert_int_equal(0, sroc_intern_key(root, name, &key));
+        assert_ptr_equal(find_item(b, "port")->key, key.name);
+        assert_int_equal(sroc_hash_key("port", 4), key.hash);
+
+        // Section names are not interned, but the key still reads
+        assert_int_equal(SROC_ERRNOKEY, sroc_intern_key(root, "b", &section));
+        assert_int_equal(sroc_hash_key("b", 1), section.hash);
+        assert_int_equal(0, sroc_read_value(root, &section, &key, &value));
+        assert_int_equal(81, value->number);
+
+        assert_int_equal(SROC_ERRNOKEY,
+                         sroc_intern_key(root, "missing", &key));
+        assert_string_equal("missing", key.name);
+        assert_int_equal(SROC_ERRNOKEY,
+                         sroc_read_value(root, &section, &key, &value));
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_intern_survives_changes(void **state)
+{
+        struct sroc_root *root = sroc_parse_string(test_string);
+        struct sroc_table *a;
+        const char *string;
+
+        // Replacing an interned value must leave the shared copy alone
+        assert_int_equal(0, sroc_get_section(root, "a", &a));
+        assert_int_equal(0, sroc_table_set_string(a, "host", "changed"));
+        assert_int_equal(0, sroc_read_string(root, NULL, "host", &string));
+        assert_string_equal("localhost", string);
+
+        // Section b is moved into the new root along with the strings it uses
+        const char *changed = "host = \"localhost\"\n"
+                              "\n"
+                              "[a]\n"
+                              "host = \"other\"\n"
+                              "\n"
+                              "[b]\n"
+                              "port = 81\n"
+                              "host = \"remote\"\n"
+                              "motd = \"say \\\"hi\\\"\"\n"
+                              "pools = [\"secondary\"]\n";
+        struct sroc_root *reparsed
+                = sroc_reparse(root, changed, strlen(changed));
+
+        assert_non_null(reparsed);
+        assert_int_equal(0, sroc_read_string(reparsed, "b", "motd", &string));
+        assert_string_equal("say \"hi\"", string);
+        assert_int_equal(0, sroc_read_string(reparsed, "a", "host", &string));
+        assert_string_equal("other", string);
+
+        sroc_destroy_root(reparsed);
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test(test_sroc_intern_shares_keys_and_strings),
+                cmocka_unit_test(test_sroc_intern_long_strings),
+                cmocka_unit_test(test_sroc_intern_key),
+                cmocka_unit_test(test_sroc_intern_survives_changes),
+        };
+
+        return cmocka_run_group_tests(tests, NULL, NULL);
+}
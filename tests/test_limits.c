@@ -0,0 +1,455 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <cmocka.h>
+#include <sroc.h>
+
+// Input sizes compared by the linear time test
+#define SMALL_INPUT (256 * 1024)
+#define LARGE_INPUT (4 * SMALL_INPUT)
+
+// A quadratic parser would take 16 times longer on the 4 times larger input.
+// The slack keeps inputs which parse in microseconds from tripping on noise
+#define MAX_TIME_RATIO 10.0
+#define TIME_SLACK 0.005
+
+// The constants of hash_bytes in src/hash.c, which the colliding keys below
+// are built against
+#define MURMUR_SEED 0x5ca1ab1e0ddba11ULL
+#define MURMUR_MULTIPLIER 0xc6a4a7935bd1e995ULL
+#define MURMUR_SHIFT 47
+
+// Colliding keys are made of COLLIDING_STAGES pairs of blocks. Each stage has
+// two pairs which lead to the same hash state, so 2^COLLIDING_STAGES keys
+// share their whole hash_bytes
+#define COLLIDING_STAGES 13
+#define COLLIDING_LENGTH (COLLIDING_STAGES * 16)
+
+static int parse_limited(const char *string, const struct sroc_limits *limits)
+{
+        struct sroc_root *root = NULL;
+        int result = sroc_parse_limited(string, strlen(string), limits, &root);
+
+        sroc_destroy_root(root);
+
+        return result;
+}
+
+static void test_sroc_parse_limited_without_limits(void **state)
+{
+        struct sroc_limits limits = {0};
+
+        assert_int_equal(0, parse_limited("a = [[1]]\n[s]\nb = \"x\"\n", NULL));
+        assert_int_equal(0, parse_limited("a = [[1], [2]]\n", &limits));
+        assert_int_equal(SROC_ERRINVAL, parse_limited("a = ", &limits));
+}
+
+static void test_sroc_parse_limited_bytes(void **state)
+{
+        struct sroc_limits limits = {.max_bytes = 6};
+
+        assert_int_equal(0, parse_limited("a = 1\n", &limits));
+        assert_int_equal(SROC_ERRTOOBIG, parse_limited("a = 10\n", &limits));
+}
+
+static void test_sroc_parse_limited_depth(void **state)
+{
+        struct sroc_limits limits = {.max_depth = 2};
+
+        assert_int_equal(0, parse_limited("a = [[1], []]\n", &limits));
+        assert_int_equal(SROC_ERRDEPTH,
+                         parse_limited("a = [[[1]]]\n", &limits));
+
+        // Far deeper than the stack could take without the limit
+        size_t depth = 1000000;
+        char *deep = malloc(depth + 5);
+
+        memcpy(deep, "a = ", 4);
+        memset(deep + 4, '[', depth);
+        deep[depth + 4] = '\0';
+        limits.max_depth = 64;
+
+        assert_int_equal(SROC_ERRDEPTH, parse_limited(deep, &limits));
+
+        free(deep);
+}
+
+static void test_sroc_parse_limited_items(void **state)
+{
+        struct sroc_limits limits = {.max_items = 5};
+
+        // Two items, one section and two array values
+        assert_int_equal(0, parse_limited("a = 1\n[s]\nb = [1, 2]\n", &limits));
+        assert_int_equal(SROC_ERRITEMS,
+                         parse_limited("a = 1\n[s]\nb = [1, 2, 3]\n", &limits));
+        assert_int_equal(SROC_ERRITEMS,
+                         parse_limited("a=1\nb=1\nc=1\nd=1\ne=1\nf=1\n",
+                                       &limits));
+}
+
+static void test_sroc_parse_limited_string_length(void **state)
+{
+        struct sroc_limits limits = {.max_string_length = 4};
+
+        // Escapes count once, after they are removed
+        assert_int_equal(0, parse_limited("a = \"ab\\\"c\"\n", &limits));
+        assert_int_equal(SROC_ERRSTRLEN,
+                         parse_limited("a = \"abcde\"\n", &limits));
+        assert_int_equal(SROC_ERRSTRLEN,
+                         parse_limited("a = [\"ok\", \"large\"]\n",
+                                       &limits));
+}
+
+static void test_sroc_parse_limited_memory(void **state)
+{
+        struct sroc_limits limits = {.max_alloc_bytes = 512};
+        char big[1024];
+
+        assert_int_equal(0, parse_limited("a = \"small\"\n", &limits));
+
+        memcpy(big, "a = \"", 5);
+        memset(big + 5, 'x', 600);
+        memcpy(big + 605, "\"\n", 3);
+
+        assert_int_equal(SROC_ERRMEMLIMIT, parse_limited(big, &limits));
+        assert_int_equal(SROC_ERRMEMLIMIT,
+                         parse_limited("a=1\nb=1\nc=1\nd=1\ne=1\nf=1\ng=1\n"
+                                       "h=1\ni=1\nj=1\nk=1\nl=1\nm=1\n",
+                                       &limits));
+}
+
+static void test_sroc_parse_limited_deadline(void **state)
+{
+        struct timespec now;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        uint64_t now_ns = (uint64_t)now.tv_sec * 1000000000u
+                          + (uint64_t)now.tv_nsec;
+        struct sroc_limits limits = {.deadline_ns = now_ns - 1};
+
+        assert_int_equal(SROC_ERRTIMEOUT, parse_limited("a = 1\n", &limits));
+
+        limits.deadline_ns = now_ns + 60 * 1000000000ull;
+
+        assert_int_equal(0, parse_limited("a = 1\n", &limits));
+}
+
+/**
+ * Fills buffer with copies of piece up to length bytes. piece must be a
+ * complete line or item so the result stays parseable wherever it is cut
+ */
+static char *repeat(const char *prefix, const char *piece, const char *suffix,
+                    size_t length)
+{
+        size_t prefix_length = strlen(prefix);
+        size_t piece_length = strlen(piece);
+        size_t suffix_length = strlen(suffix);
+        char *buffer = malloc(length + suffix_length + 1);
+        size_t used = prefix_length;
+
+        memcpy(buffer, prefix, prefix_length);
+
+        while (used + piece_length <= length) {
+                memcpy(buffer + used, piece, piece_length);
+                used += piece_length;
+        }
+
+        memcpy(buffer + used, suffix, suffix_length + 1);
+
+        return buffer;
+}
+
+static uint64_t murmur_block(uint64_t block)
+{
+        block *= MURMUR_MULTIPLIER;
+        block ^= block >> MURMUR_SHIFT;
+
+        return block * MURMUR_MULTIPLIER;
+}
+
+static uint64_t murmur_step(uint64_t state, uint64_t block)
+{
+        return (state ^ murmur_block(block)) * MURMUR_MULTIPLIER;
+}
+
+/**
+ * Returns the block murmur_block turns into mixed. inverse is the inverse of
+ * MURMUR_MULTIPLIER modulo 2^64
+ */
+static uint64_t murmur_unblock(uint64_t mixed, uint64_t inverse)
+{
+        mixed *= inverse;
+        mixed ^= mixed >> MURMUR_SHIFT;
+
+        return mixed * inverse;
+}
+
+static bool is_key_block(uint64_t block)
+{
+        for (int i = 0; i < 8; ++i) {
+                char ch = (char)(block >> (8 * i));
+
+                if (!(ch >= 'a' && ch <= 'z') && !(ch >= 'A' && ch <= 'Z')
+                    && !(ch >= '0' && ch <= '9') && ch != '_') {
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+static uint64_t letters_block(uint64_t counter)
+{
+        static const char letters[]
+                = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+        uint64_t block = 0;
+
+        for (int i = 0; i < 8; ++i) {
+                block |= (uint64_t)(unsigned char)letters[counter % 52]
+                         << (8 * i);
+                counter /= 52;
+        }
+
+        return block;
+}
+
+/**
+ * Finds the two block pairs of every stage, both of which take the hash state
+ * of a COLLIDING_LENGTH key to the same next state. The block mix can be
+ * inverted, so the second block of a pair follows from the first and about
+ * one in 2^16 of them is made of key characters
+ */
+static void find_colliding_blocks(uint64_t blocks[COLLIDING_STAGES][4])
+{
+        uint64_t inverse = MURMUR_MULTIPLIER;
+        uint64_t state = MURMUR_SEED ^ (COLLIDING_LENGTH * MURMUR_MULTIPLIER);
+        uint64_t counter = 1;
+
+        for (int i = 0; i < 5; ++i) {
+                inverse *= 2 - MURMUR_MULTIPLIER * inverse;
+        }
+
+        for (int stage = 0; stage < COLLIDING_STAGES; ++stage) {
+                uint64_t first = letters_block(0);
+                uint64_t next = murmur_step(murmur_step(state, first), first);
+                uint64_t other;
+                uint64_t second;
+
+                do {
+                        other = letters_block(counter++);
+                        second = murmur_unblock(
+                                next * inverse
+                                        ^ murmur_step(state, other),
+                                inverse);
+                } while (!is_key_block(second));
+
+                blocks[stage][0] = first;
+                blocks[stage][1] = first;
+                blocks[stage][2] = other;
+                blocks[stage][3] = second;
+                state = next;
+        }
+}
+
+/**
+ * Fills a buffer of up to length bytes with format once per colliding key,
+ * between prefix and suffix. The keys are distinct but share their whole
+ * hash_bytes, as anyone can make them without knowing any seed of the process
+ */
+static char *colliding_lines(const char *prefix, const char *format,
+                             const char *suffix, size_t length)
+{
+        static uint64_t blocks[COLLIDING_STAGES][4];
+        static bool found = false;
+        size_t prefix_length = strlen(prefix);
+        size_t suffix_length = strlen(suffix);
+        char *buffer = malloc(length + suffix_length + 1);
+        size_t used = prefix_length;
+        uint64_t hash = 0;
+
+        if (!found) {
+                find_colliding_blocks(blocks);
+                found = true;
+        }
+
+        memcpy(buffer, prefix, prefix_length);
+
+        for (uint32_t i = 0; i < (1u << COLLIDING_STAGES); ++i) {
+                char key[COLLIDING_LENGTH + 1];
+                char line[COLLIDING_LENGTH + 32];
+
+                for (int stage = 0; stage < COLLIDING_STAGES; ++stage) {
+                        const uint64_t *pair
+                                = &blocks[stage][((i >> stage) & 1) * 2];
+
+                        for (int byte = 0; byte < 16; ++byte) {
+                                key[stage * 16 + byte] = (char)(pair[byte / 8]
+                                                        >> (8 * (byte % 8)));
+                        }
+                }
+
+                key[COLLIDING_LENGTH] = '\0';
+
+                if (i == 0) {
+                        hash = sroc_hash_key(key, COLLIDING_LENGTH);
+                }
+
+                assert_true(hash == sroc_hash_key(key, COLLIDING_LENGTH));
+
+                int line_length = snprintf(line, sizeof(line), format, key);
+
+                if (used + (size_t)line_length > length) {
+                        break;
+                }
+
+                memcpy(buffer + used, line, (size_t)line_length);
+                used += (size_t)line_length;
+        }
+
+        memcpy(buffer + used, suffix, suffix_length + 1);
+
+        return buffer;
+}
+
+static double time_parse(const char *buffer)
+{
+        struct sroc_limits limits = {.max_depth = 64};
+        double best = 0;
+
+        for (int run = 0; run < 3; ++run) {
+                struct sroc_root *root = NULL;
+                struct timespec start;
+                struct timespec end;
+
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                sroc_parse_limited(buffer, strlen(buffer), &limits, &root);
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                sroc_destroy_root(root);
+
+                double seconds = (double)(end.tv_sec - start.tv_sec)
+                                 + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+
+                if (run == 0 || seconds < best) {
+                        best = seconds;
+                }
+        }
+
+        return best;
+}
+
+static void assert_linear(const char *name, const char *small,
+                          const char *large)
+{
+        double small_time = time_parse(small);
+        double large_time = time_parse(large);
+
+        if (large_time > small_time * MAX_TIME_RATIO + TIME_SLACK) {
+                fail_msg("%s: %f s for %d bytes but %f s for %d bytes",
+                         name,
+                         small_time,
+                         SMALL_INPUT,
+                         large_time,
+                         LARGE_INPUT);
+        }
+}
+
+/**
+ * Inputs built to hit the slowest path of each part of the parser. Parsing
+ * four times as much of each must take about four times as long
+ */
+static void test_sroc_parse_limited_linear_time(void **state)
+{
+        const struct {
+                const char *prefix;
+                const char *piece;
+                const char *suffix;
+        } corpus[] = {
+                {"", "a=1\n", ""},                           // Short items
+                {"", "[s]\n", ""},                           // Same section
+                {"", "same_key = 1\n", ""},                  // Same key
+                {"", "#\n\n \t\n", ""},                      // Blank lines
+                {"a = \"", "\\\"", "\"\n"},                  // All escapes
+                {"a = \"", "\xf0\x9f\x91\x8b", "\"\n"},      // All multibyte
+                {"a = [", "[[1]],", "]\n"},                  // Nesting
+                {"a = [", "\n#,\n", "]\n"},                  // Array comments
+                {"a = 0", ",000", "\n"},                     // Grouping
+                {"a = [", "\"\\\n\",", "]\n"},               // Escaped lines
+                {"a = [", "{b: {c: \"d\"}},", "]\n"},        // Objects
+                {"a = {", "b: 1,", "}\n"},                   // Same field
+        };
+
+        for (size_t i = 0; i < sizeof(corpus) / sizeof(corpus[0]); ++i) {
+                char *small = repeat(corpus[i].prefix,
+                                     corpus[i].piece,
+                                     corpus[i].suffix,
+                                     SMALL_INPUT);
+                char *large = repeat(corpus[i].prefix,
+                                     corpus[i].piece,
+                                     corpus[i].suffix,
+                                     LARGE_INPUT);
+                char name[32];
+
+                snprintf(name, sizeof(name), "corpus %zu", i);
+                assert_linear(name, small, large);
+
+                free(small);
+                free(large);
+        }
+
+        const struct {
+                const char *prefix;
+                const char *format;
+                const char *suffix;
+        } colliding[] = {
+                {"", "%s = 1\n", ""},     // Keys
+                {"", "[%s]\n", ""},       // Sections
+                {"", "a = \"%s\"\n", ""}, // Interned strings
+                {"a = {", "%s: 1,", "}\n"}, // Object fields
+        };
+
+        for (size_t i = 0; i < sizeof(colliding) / sizeof(colliding[0]); ++i) {
+                char *small = colliding_lines(colliding[i].prefix,
+                                              colliding[i].format,
+                                              colliding[i].suffix,
+                                              SMALL_INPUT);
+                char *large = colliding_lines(colliding[i].prefix,
+                                              colliding[i].format,
+                                              colliding[i].suffix,
+                                              LARGE_INPUT);
+                char name[32];
+
+                snprintf(name, sizeof(name), "colliding %zu", i);
+                assert_linear(name, small, large);
+
+                free(small);
+                free(large);
+        }
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test(test_sroc_parse_limited_without_limits),
+                cmocka_unit_test(test_sroc_parse_limited_bytes),
+                cmocka_unit_test(test_sroc_parse_limited_depth),
+                cmocka_unit_test(test_sroc_parse_limited_items),
+                cmocka_unit_test(test_sroc_parse_limited_string_length),
+                cmocka_unit_test(test_sroc_parse_limited_memory),
+                cmocka_unit_test(test_sroc_parse_limited_deadline),
+                cmocka_unit_test(test_sroc_parse_limited_linear_time),
+        };
+
+        return cmocka_run_group_tests(tests, NULL, NULL);
+}
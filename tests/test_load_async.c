@@ -0,0 +1,371 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cmocka.h>
+#include <sroc.h>
+
+// Size of the generated configuration and the length of each of its values
+#define LARGE_CONFIG (100 * 1024 * 1024)
+#define VALUE_LENGTH 1000
+#define KEYS_PER_SECTION 1000
+
+// The loop must never go this long without servicing its timer
+#define TIMER_INTERVAL_NS 1000000
+#define MAX_TIMER_GAP_NS 200000000
+
+static char large_path[] = "/tmp/sroc_load_async_XXXXXX";
+static size_t large_keys;
+
+static uint64_t now_ns(void)
+{
+        struct timespec now;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+static int write_large_config(void **state)
+{
+        int fd = mkstemp(large_path);
+        FILE *file = fdopen(fd, "w");
+        char value[VALUE_LENGTH + 1];
+        size_t written = 0;
+
+        if (file == NULL) {
+                return -1;
+        }
+
+        memset(value, 'x', VALUE_LENGTH);
+        value[VALUE_LENGTH] = '\0';
+
+        while (written < LARGE_CONFIG) {
+                if (large_keys % KEYS_PER_SECTION == 0) {
+                        size_t section = large_keys / KEYS_PER_SECTION;
+
+                        written += (size_t)fprintf(
+                                file, "[s_%zu]\n", section);
+                }
+
+                written += (size_t)fprintf(
+                        file, "k_%zu = \"%s\"\n", large_keys, value);
+                ++large_keys;
+        }
+
+        return fclose(file);
+}
+
+static int remove_large_config(void **state)
+{
+        return unlink(large_path);
+}
+
+/**
+ * Waits until the descriptor of job becomes readable, as an event loop would
+ */
+static void wait_for_job(struct sroc_load_job *job)
+{
+        int epoll = epoll_create1(EPOLL_CLOEXEC);
+        struct epoll_event event = {.events = EPOLLIN};
+
+        assert_int_equal(
+                0, epoll_ctl(epoll, EPOLL_CTL_ADD, sroc_load_fd(job), &event));
+        assert_int_equal(1, epoll_wait(epoll, &event, 1, -1));
+
+        close(epoll);
+}
+
+static void test_sroc_load_async_keeps_loop_running(void **state)
+{
+        struct sroc_load_job *job;
+        struct sroc_root *root = NULL;
+        int epoll = epoll_create1(EPOLL_CLOEXEC);
+        int timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+        struct itimerspec interval = {
+                .it_interval = {.tv_nsec = TIMER_INTERVAL_NS},
+                .it_value = {.tv_nsec = TIMER_INTERVAL_NS},
+        };
+        struct epoll_event event = {.events = EPOLLIN, .data.fd = timer};
+
+        assert_int_equal(0, timerfd_settime(timer, 0, &interval, NULL));
+        assert_int_equal(0, epoll_ctl(epoll, EPOLL_CTL_ADD, timer, &event));
+        assert_int_equal(0, sroc_load_async(large_path, NULL, &job));
+
+        event.data.fd = sroc_load_fd(job);
+        assert_int_equal(
+                0, epoll_ctl(epoll, EPOLL_CTL_ADD, event.data.fd, &event));
+
+        uint64_t ticks = 0;
+        uint64_t last_tick = now_ns();
+        uint64_t max_gap = 0;
+        int result = SROC_ERRAGAIN;
+
+        while (result == SROC_ERRAGAIN) {
+                assert_int_equal(1, epoll_wait(epoll, &event, 1, -1));
+
+                if (event.data.fd == timer) {
+                        uint64_t expirations;
+                        uint64_t now = now_ns();
+
+                        assert_int_equal(sizeof(expirations),
+                                         read(timer,
+                                              &expirations,
+                                              sizeof(expirations)));
+
+                        if (now - last_tick > max_gap) {
+                                max_gap = now - last_tick;
+                        }
+
+                        last_tick = now;
+                        ++ticks;
+
+                        continue;
+                }
+
+                result = sroc_load_poll(job, &root);
+        }
+
+        assert_int_equal(0, result);
+        assert_true(ticks > 0);
+
+        if (max_gap > MAX_TIMER_GAP_NS) {
+                fail_msg("timer went %f s without running", (double)max_gap / 1e9);
+        }
+
+        // The last key of the last section
+        char section[32];
+        char key[32];
+        const char *string;
+
+        snprintf(section,
+                 sizeof(section),
+                 "s_%zu",
+                 (large_keys - 1) / KEYS_PER_SECTION);
+        snprintf(key, sizeof(key), "k_%zu", large_keys - 1);
+
+        assert_int_equal(0, sroc_read_string(root, section, key, &string));
+        assert_int_equal(VALUE_LENGTH, strlen(string));
+        assert_int_equal(SROC_ERRINVAL, sroc_load_poll(job, &root));
+
+        sroc_load_release(job);
+        sroc_destroy_root(root);
+        close(timer);
+        close(epoll);
+}
+
+static void test_sroc_load_async_poll_before_done(void **state)
+{
+        struct sroc_load_job *job;
+        struct sroc_root *root = NULL;
+
+        assert_int_equal(0, sroc_load_async(large_path, NULL, &job));
+        assert_int_equal(SROC_ERRAGAIN, sroc_load_poll(job, &root));
+        assert_null(root);
+
+        // Released while still running, the job cleans up after itself
+        sroc_load_release(job);
+}
+
+static void test_sroc_load_async_cancel(void **state)
+{
+        struct sroc_load_job *job;
+        struct sroc_root *root = NULL;
+
+        assert_int_equal(0, sroc_load_async(large_path, NULL, &job));
+
+        sroc_load_cancel(job);
+        wait_for_job(job);
+
+        assert_int_equal(SROC_ERRCANCELED, sroc_load_poll(job, &root));
+        assert_null(root);
+
+        sroc_load_release(job);
+}
+
+/**
+ * Reading takes well under half of a load, so a job canceled half way is
+ * parsing. It must stop there rather than finish the parse and only then
+ * throw the root away
+ */
+static void test_sroc_load_async_cancel_while_parsing(void **state)
+{
+        struct sroc_load_job *job;
+        struct sroc_root *root = NULL;
+        uint64_t start = now_ns();
+
+        assert_int_equal(0, sroc_load_async(large_path, NULL, &job));
+        wait_for_job(job);
+
+        uint64_t full = now_ns() - start;
+
+        assert_int_equal(0, sroc_load_poll(job, &root));
+        sroc_load_release(job);
+        sroc_destroy_root(root);
+        root = NULL;
+
+        struct timespec half = {.tv_sec = (time_t)(full / 2 / 1000000000u),
+                                .tv_nsec = (long)(full / 2 % 1000000000u)};
+
+        assert_int_equal(0, sroc_load_async(large_path, NULL, &job));
+        nanosleep(&half, NULL);
+
+        uint64_t canceled = now_ns();
+
+        sroc_load_cancel(job);
+        wait_for_job(job);
+
+        uint64_t latency = now_ns() - canceled;
+
+        assert_int_equal(SROC_ERRCANCELED, sroc_load_poll(job, &root));
+        assert_null(root);
+
+        if (latency > full / 4) {
+                fail_msg("took %f s to stop of a %f s load",
+                         (double)latency / 1e9,
+                         (double)full / 1e9);
+        }
+
+        sroc_load_release(job);
+}
+
+static void record_done(struct sroc_load_job *job, void *data)
+{
+        atomic_store((_Atomic int *)data, 1);
+}
+
+struct polled_result {
+        _Atomic int called;
+        int result;
+        struct sroc_root *root;
+};
+
+static void poll_in_callback(struct sroc_load_job *job, void *data)
+{
+        struct polled_result *polled = data;
+
+        polled->result = sroc_load_poll(job, &polled->root);
+        atomic_store(&polled->called, 1);
+}
+
+/**
+ * Collecting the result from the callback must leave the descriptor drained,
+ * or a level triggered loop would keep waking up for it
+ */
+static void test_sroc_load_async_poll_from_callback(void **state)
+{
+        char path[] = "/tmp/sroc_load_async_XXXXXX";
+        int fd = mkstemp(path);
+        const char *text = "port = 80\n";
+        struct polled_result polled = {.root = NULL};
+        struct sroc_load_options options = {.callback = poll_in_callback,
+                                            .data = &polled};
+        struct sroc_load_job *job;
+        struct sroc_root *root = NULL;
+
+        assert_int_equal(strlen(text), write(fd, text, strlen(text)));
+        close(fd);
+        atomic_init(&polled.called, 0);
+
+        assert_int_equal(0, sroc_load_async(path, &options, &job));
+
+        while (atomic_load(&polled.called) == 0) {
+                struct timespec pause = {.tv_nsec = 1000000};
+
+                nanosleep(&pause, NULL);
+        }
+
+        struct pollfd ready = {.fd = sroc_load_fd(job), .events = POLLIN};
+
+        assert_int_equal(0, polled.result);
+        assert_non_null(polled.root);
+        assert_int_equal(0, poll(&ready, 1, 0));
+        assert_int_equal(SROC_ERRINVAL, sroc_load_poll(job, &root));
+
+        sroc_load_release(job);
+        sroc_destroy_root(polled.root);
+        unlink(path);
+}
+
+static void test_sroc_load_async_callback_and_limits(void **state)
+{
+        char path[] = "/tmp/sroc_load_async_XXXXXX";
+        int fd = mkstemp(path);
+        const char *text = "[server]\nport = 80\n";
+        struct sroc_limits limits = {.max_items = 1};
+        _Atomic int called = 0;
+        struct sroc_load_options options = {.callback = record_done,
+                                            .data = &called};
+        struct sroc_load_job *job;
+        struct sroc_root *root = NULL;
+        int64_t number;
+
+        assert_int_equal(strlen(text), write(fd, text, strlen(text)));
+        close(fd);
+
+        assert_int_equal(0, sroc_load_async(path, &options, &job));
+        wait_for_job(job);
+
+        assert_int_equal(1, atomic_load(&called));
+        assert_int_equal(0, sroc_load_poll(job, &root));
+        assert_int_equal(0, sroc_read_number(root, "server", "port", &number));
+        assert_int_equal(80, number);
+
+        sroc_load_release(job);
+        sroc_destroy_root(root);
+
+        options.limits = &limits;
+
+        assert_int_equal(0, sroc_load_async(path, &options, &job));
+        wait_for_job(job);
+
+        assert_int_equal(SROC_ERRITEMS, sroc_load_poll(job, &root));
+
+        sroc_load_release(job);
+        unlink(path);
+}
+
+static void test_sroc_load_async_missing_file(void **state)
+{
+        struct sroc_load_job *job;
+        struct sroc_root *root = NULL;
+
+        assert_int_equal(0,
+                         sroc_load_async("/nonexistent/sroc.conf", NULL, &job));
+        wait_for_job(job);
+
+        assert_int_equal(SROC_ERRIO, sroc_load_poll(job, &root));
+        assert_null(root);
+
+        sroc_load_release(job);
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test(test_sroc_load_async_keeps_loop_running),
+                cmocka_unit_test(test_sroc_load_async_poll_before_done),
+                cmocka_unit_test(test_sroc_load_async_cancel),
+                cmocka_unit_test(test_sroc_load_async_cancel_while_parsing),
+                cmocka_unit_test(test_sroc_load_async_poll_from_callback),
+                cmocka_unit_test(test_sroc_load_async_callback_and_limits),
+                cmocka_unit_test(test_sroc_load_async_missing_file),
+        };
+
+        return cmocka_run_group_tests(
+                tests, write_large_config, remove_large_config);
+}
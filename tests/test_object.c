@@ -0,0 +1,308 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+#include <sroc.h>
+
+// Deeper than any real configuration, to make sure nesting is not recursive
+// per field
+#define DEEP_NESTING 200
+
+static const char *test_string = "owner = {first_name: \"chris\", "
+                                 "last_name: \"frank\"}\n"
+                                 "\n"
+                                 "[server]\n"
+                                 "limits = {\n"
+                                 "    connections: 1000,\n"
+                                 "    # Comments are allowed between fields\n"
+                                 "    timeouts: {read: 5, write: -10},\n"
+                                 "    ports: [80, 443],\n"
+                                 "    tls: true,\n"
+                                 "    banner: \"say \\\"hi\\\"\",\n"
+                                 "}\n"
+                                 "empty = {}\n"
+                                 "port = 8080\n";
+
+static int count_change(enum sroc_change change, const char *section,
+                        const char *key, const struct sroc_value *old_value,
+                        const struct sroc_value *new_value, void *data)
+{
+        ++*(size_t *)data;
+
+        return 0;
+}
+
+static size_t count_changes(const char *old_string, const char *new_string)
+{
+        struct sroc_root *old_root = sroc_parse_string(old_string);
+        struct sroc_root *new_root = sroc_parse_string(new_string);
+        size_t changes = 0;
+
+        assert_non_null(old_root);
+        assert_non_null(new_root);
+        assert_int_equal(
+                0, sroc_diff(old_root, new_root, count_change, &changes));
+
+        sroc_destroy_root(old_root);
+        sroc_destroy_root(new_root);
+
+        return changes;
+}
+
+static void test_sroc_read_object(void **state)
+{
+        struct sroc_root *root = sroc_parse_string(test_string);
+        struct sroc_object *object;
+        const struct sroc_value *value;
+
+        assert_non_null(root);
+        assert_int_equal(0, sroc_read_object(root, NULL, "owner", &object));
+        assert_int_equal(2, object->length);
+        assert_int_equal(0, sroc_object_get(object, "last_name", &value));
+        assert_int_equal(SROC_STRING, value->type);
+        assert_string_equal("frank", value->string);
+
+        assert_int_equal(
+                0, sroc_read_object(root, "server", "limits", &object));
+        assert_int_equal(0, sroc_object_get(object, "connections", &value));
+        assert_int_equal(1000, value->number);
+        assert_int_equal(0, sroc_object_get(object, "banner", &value));
+        assert_string_equal("say \"hi\"", value->string);
+        assert_int_equal(0, sroc_object_get(object, "ports", &value));
+        assert_int_equal(2, value->array->length);
+        assert_int_equal(443, value->array->items[1]->number);
+        assert_int_equal(0, sroc_object_get(object, "timeouts", &value));
+        assert_int_equal(SROC_OBJECT, value->type);
+        assert_int_equal(0, sroc_object_get(value->object, "write", &value));
+        assert_int_equal(-10, value->number);
+        assert_int_equal(SROC_ERRNOKEY,
+                         sroc_object_get(object, "missing", &value));
+
+        assert_int_equal(0, sroc_read_object(root, "server", "empty", &object));
+        assert_int_equal(0, object->length);
+        assert_int_equal(SROC_ERRNOKEY, sroc_object_get(object, "a", &value));
+
+        assert_int_equal(SROC_ERRTYPE,
+                         sroc_read_object(root, "server", "port", &object));
+        assert_int_equal(SROC_ERRNOKEY,
+                         sroc_read_object(root, "server", "owner", &object));
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_iter_fields(void **state)
+{
+        struct sroc_root *root = sroc_parse_string(test_string);
+        const char *expected[] = {
+                "connections", "timeouts", "ports", "tls", "banner"};
+        struct sroc_object *object;
+        struct sroc_field_cursor cursor;
+        const struct sroc_field *field;
+        size_t seen = 0;
+
+        assert_int_equal(
+                0, sroc_read_object(root, "server", "limits", &object));
+
+        sroc_iter_fields(object, &cursor);
+
+        while ((field = sroc_next_field(&cursor)) != NULL) {
+                assert_string_equal(expected[seen], field->key);
+                ++seen;
+        }
+
+        assert_int_equal(5, seen);
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_object_large(void **state)
+{
+        char buffer[4096] = "big = {";
+        struct sroc_root *root;
+        struct sroc_object *object;
+        const struct sroc_value *value;
+        char key[32];
+
+        for (int i = 0; i < 100; ++i) {
+                size_t used = strlen(buffer);
+
+                snprintf(buffer + used,
+                         sizeof(buffer) - used,
+                         "field_%d: %d, ",
+                         i,
+                         i * 3);
+        }
+
+        strcat(buffer, "}\n");
+        root = sroc_parse_string(buffer);
+
+        assert_non_null(root);
+        assert_int_equal(0, sroc_read_object(root, NULL, "big", &object));
+        assert_int_equal(100, object->length);
+        assert_non_null(object->slots);
+
+        for (int i = 0; i < 100; ++i) {
+                snprintf(key, sizeof(key), "field_%d", i);
+                assert_int_equal(0, sroc_object_get(object, key, &value));
+                assert_int_equal(i * 3, value->number);
+        }
+
+        assert_int_equal(SROC_ERRNOKEY,
+                         sroc_object_get(object, "field_100", &value));
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_object_small_boundary(void **state)
+{
+        struct sroc_root *root = sroc_parse_string(
+                "small = {a: 1, b: 2, c: 3, d: 4, e: 5, f: 6, g: 7, h: 8}\n"
+                "large = {a: 1, b: 2, c: 3, d: 4, e: 5, f: 6, g: 7, h: 8, "
+                "i: 9}\n");
+        struct sroc_object *object;
+        const struct sroc_value *value;
+
+        assert_int_equal(0, sroc_read_object(root, NULL, "small", &object));
+        assert_int_equal(SROC_SMALL_OBJECT, object->length);
+        assert_null(object->slots);
+        assert_int_equal(0, sroc_object_get(object, "h", &value));
+        assert_int_equal(8, value->number);
+
+        assert_int_equal(0, sroc_read_object(root, NULL, "large", &object));
+        assert_non_null(object->slots);
+        assert_int_equal(0, sroc_object_get(object, "i", &value));
+        assert_int_equal(9, value->number);
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_object_deep_nesting(void **state)
+{
+        size_t length = 8 + DEEP_NESTING * 4 + 2 + DEEP_NESTING + 2;
+        char *buffer = malloc(length);
+        char *pos = buffer;
+
+        pos += sprintf(pos, "deep = ");
+
+        for (int i = 0; i < DEEP_NESTING; ++i) {
+                pos += sprintf(pos, "{a: ");
+        }
+
+        pos += sprintf(pos, "1");
+        memset(pos, '}', DEEP_NESTING);
+        strcpy(pos + DEEP_NESTING, "\n");
+
+        struct sroc_root *root = sroc_parse_string(buffer);
+        struct sroc_object *object;
+        const struct sroc_value *value = NULL;
+
+        assert_non_null(root);
+        assert_int_equal(0, sroc_read_object(root, NULL, "deep", &object));
+
+        for (int i = 0; i < DEEP_NESTING; ++i) {
+                assert_int_equal(0, sroc_object_get(object, "a", &value));
+                object = value->object;
+        }
+
+        assert_int_equal(SROC_NUMBER, value->type);
+        assert_int_equal(1, value->number);
+
+        struct sroc_limits limits = {.max_depth = 16};
+        struct sroc_root *limited = NULL;
+
+        assert_int_equal(SROC_ERRDEPTH,
+                         sroc_parse_limited(buffer,
+                                            strlen(buffer),
+                                            &limits,
+                                            &limited));
+
+        sroc_destroy_root(root);
+        free(buffer);
+}
+
+static void test_sroc_object_invalid(void **state)
+{
+        const char *invalid[] = {
+                "a = {b 1}\n",
+                "a = {b: 1\n",
+                "a = {b: 1 c: 2}\n",
+                "a = {: 1}\n",
+                "a = {b: 1, b: 2}\n",
+                "a = {b: 1, c: 2, d: 3, e: 4, f: 5, g: 6, h: 7, i: 8, c: 9}\n",
+                "a = {b: {c: [1, \"x\"]}}\n",
+                "a = {b: \"unterminated}\n",
+                "a = {b: 1} c\n",
+        };
+
+        for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i) {
+                struct sroc_root *root = sroc_parse_string(invalid[i]);
+
+                if (root != NULL) {
+                        fail_msg("parsed invalid input %zu", i);
+                }
+        }
+}
+
+static void test_sroc_object_emit_round_trips(void **state)
+{
+        struct sroc_root *root = sroc_parse_string(test_string);
+        struct sroc_sink sink;
+
+        sroc_init_buffer_sink(&sink);
+
+        assert_int_equal(0, sroc_emit(root, &sink));
+        assert_non_null(strstr(sink.buffer.data,
+                               "limits = {connections: 1000, timeouts: "
+                               "{read: 5, write: -10}, ports: [80, 443], "
+                               "tls: true, banner: \"say \\\"hi\\\"\"}\n"));
+        assert_non_null(strstr(sink.buffer.data, "empty = {}\n"));
+
+        struct sroc_root *parsed = sroc_parse_string(sink.buffer.data);
+        size_t changes = 0;
+
+        assert_non_null(parsed);
+        assert_int_equal(0, sroc_diff(root, parsed, count_change, &changes));
+        assert_int_equal(0, changes);
+
+        sroc_release_sink(&sink);
+        sroc_destroy_root(parsed);
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_object_diff(void **state)
+{
+        // Field order does not matter, values and keys do
+        assert_int_equal(0, count_changes("a = {x: 1, y: {z: 2}}\n",
+                                          "a = {y: {z: 2}, x: 1}\n"));
+        assert_int_equal(1, count_changes("a = {x: 1, y: {z: 2}}\n",
+                                          "a = {x: 1, y: {z: 3}}\n"));
+        assert_int_equal(1, count_changes("a = {x: 1}\n", "a = {y: 1}\n"));
+        assert_int_equal(
+                1, count_changes("a = {x: 1}\n", "a = {x: 1, y: 1}\n"));
+        assert_int_equal(1, count_changes("a = {x: 1}\n", "a = [1]\n"));
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test(test_sroc_read_object),
+                cmocka_unit_test(test_sroc_iter_fields),
+                cmocka_unit_test(test_sroc_object_large),
+                cmocka_unit_test(test_sroc_object_small_boundary),
+                cmocka_unit_test(test_sroc_object_deep_nesting),
+                cmocka_unit_test(test_sroc_object_invalid),
+                cmocka_unit_test(test_sroc_object_emit_round_trips),
+                cmocka_unit_test(test_sroc_object_diff),
+        };
+
+        return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,166 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <errno.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+#include <sroc.h>
+
+static void test_sroc_parse_string_empty(void **state)
+{
+        struct sroc_root *root = sroc_parse_string("");
+
+        assert_non_null(root);
+        assert_int_equal(0, root->items_length);
+        assert_int_equal(0, root->sections_length);
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_parse_string_root_items(void **state)
+{
+        const char *test_string = "# comment\n"
+                                  "name = \"Jane\" ; trailing\n"
+                                  "\n"
+                                  "enabled = true\n"
+                                  "count = -1,000,000\n";
+        struct sroc_root *root = sroc_parse_string(test_string);
+
+        assert_non_null(root);
+        assert_int_equal(3, root->items_length);
+        assert_string_equal("name", root->items[0]->key);
+        assert_int_equal(SROC_STRING, root->items[0]->value->type);
+        assert_string_equal("Jane", root->items[0]->value->string);
+        assert_int_equal(SROC_BOOL, root->items[1]->value->type);
+        assert_true(root->items[1]->value->boolean);
+        assert_int_equal(SROC_NUMBER, root->items[2]->value->type);
+        assert_int_equal(-1000000, root->items[2]->value->number);
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_parse_string_sections(void **state)
+{
+        const char *test_string = "test = \"Test\"\n"
+                                  "[name]\n"
+                                  "first = \"Jane\"\n"
+                                  "last = \"Doe\"\n"
+                                  "[empty]\n";
+        struct sroc_root *root = sroc_parse_string(test_string);
+
+        assert_non_null(root);
+        assert_int_equal(1, root->items_length);
+        assert_int_equal(2, root->sections_length);
+        assert_string_equal("name", root->sections[0]->key);
+        assert_int_equal(2, root->sections[0]->size);
+        assert_string_equal("last", root->sections[0]->items[1]->key);
+        assert_string_equal("empty", root->sections[1]->key);
+        assert_int_equal(0, root->sections[1]->size);
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_parse_string_escapes(void **state)
+{
+        const char *test_string = "s = \"He said \\\"Hi\\\" \\\\\"\n";
+        struct sroc_root *root = sroc_parse_string(test_string);
+
+        assert_non_null(root);
+        assert_string_equal("He said \"Hi\" \\", root->items[0]->value->string);
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_parse_string_arrays(void **state)
+{
+        const char *test_string = "a = [1,2,3]\n"
+                                  "b = [\n"
+                                  "    [\"x\"],\n"
+                                  "    [\"y\", \"z\"],\n"
+                                  "]\n";
+        struct sroc_root *root = sroc_parse_string(test_string);
+
+        assert_non_null(root);
+
+        struct sroc_array *a = root->items[0]->value->array;
+        struct sroc_array *b = root->items[1]->value->array;
+
+        assert_int_equal(3, a->length);
+        assert_int_equal(SROC_NUMBER, a->type);
+        assert_int_equal(3, a->items[2]->number);
+        assert_int_equal(2, b->length);
+        assert_int_equal(SROC_ARRAY, b->type);
+        assert_string_equal("z", b->items[1]->array->items[1]->string);
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_parse_string_number_limits(void **state)
+{
+        struct sroc_root *root = sroc_parse_string(
+                "max = 9223372036854775807\nmin = -9223372036854775808\n");
+
+        assert_non_null(root);
+        assert_true(root->items[0]->value->number == INT64_MAX);
+        assert_true(root->items[1]->value->number == INT64_MIN);
+
+        sroc_destroy_root(root);
+
+        assert_null(sroc_parse_string("big = 9223372036854775808\n"));
+        assert_int_equal(EINVAL, errno);
+}
+
+static void test_sroc_parse_string_invalid(void **state)
+{
+        assert_null(sroc_parse_string("key\n"));
+        assert_null(sroc_parse_string("key = \"unterminated\n"));
+        assert_null(sroc_parse_string("key = maybe\n"));
+        assert_null(sroc_parse_string("key = [1, \"mixed\"]\n"));
+        assert_null(sroc_parse_string("[section\n"));
+        assert_null(sroc_parse_string("key = 1 2\n"));
+}
+
+static void test_sroc_parse_string_utf8(void **state)
+{
+        struct sroc_root *root = sroc_parse_string(
+                "greeting = \"h\xc3\xa9llo \xf0\x9f\x91\x8b\"\n");
+
+        assert_non_null(root);
+        assert_string_equal("h\xc3\xa9llo \xf0\x9f\x91\x8b",
+                            root->items[0]->value->string);
+
+        sroc_destroy_root(root);
+
+        // Truncated sequence, overlong encoding and a lone continuation byte
+        assert_null(sroc_parse_string("s = \"caf\xc3\"\n"));
+        assert_int_equal(EINVAL, errno);
+        assert_null(sroc_parse_string("s = \"\xc0\xaf\"\n"));
+        assert_null(sroc_parse_string("s = \"\x80\"\n"));
+
+        // Keys are ASCII regardless of the locale
+        assert_null(sroc_parse_string("caf\xe9 = 1\n"));
+        assert_null(sroc_parse_string("caf\xc3\xa9 = 1\n"));
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test(test_sroc_parse_string_empty),
+                cmocka_unit_test(test_sroc_parse_string_root_items),
+                cmocka_unit_test(test_sroc_parse_string_sections),
+                cmocka_unit_test(test_sroc_parse_string_escapes),
+                cmocka_unit_test(test_sroc_parse_string_arrays),
+                cmocka_unit_test(test_sroc_parse_string_number_limits),
+                cmocka_unit_test(test_sroc_parse_string_invalid),
+                cmocka_unit_test(test_sroc_parse_string_utf8),
+        };
+
+        return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,168 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cmocka.h>
+#include <sroc.h>
+
+#define FILE_COUNT 64
+#define PATH_LENGTH 64
+
+struct batch_files {
+        char dir[32];
+        char paths[FILE_COUNT][PATH_LENGTH];
+        const char *path_list[FILE_COUNT];
+};
+
+static int write_file(const char *path, const char *contents)
+{
+        FILE *file = fopen(path, "w");
+
+        if (file == NULL) {
+                return -1;
+        }
+
+        fputs(contents, file);
+
+        return fclose(file);
+}
+
+/**
+ * Every seventh file has a syntax error, every eleventh does not exist and the
+ * rest hold a tenant number which is checked after parsing
+ */
+static int setup_files(void **state)
+{
+        struct batch_files *files = malloc(sizeof(struct batch_files));
+
+        if (files == NULL) {
+                return -1;
+        }
+
+        strcpy(files->dir, "/tmp/sroc-parse-many-XXXXXX");
+        *state = files;
+
+        if (mkdtemp(files->dir) == NULL) {
+                return -1;
+        }
+
+        for (size_t i = 0; i < FILE_COUNT; ++i) {
+                char contents[64];
+
+                snprintf(files->paths[i],
+                         PATH_LENGTH,
+                         "%s/%zu.conf",
+                         files->dir,
+                         i);
+                files->path_list[i] = files->paths[i];
+
+                if (i % 11 == 10) {
+                        continue;
+                }
+
+                if (i % 7 == 6) {
+                        strcpy(contents, "[tenant\n");
+                } else {
+                        snprintf(contents,
+                                 sizeof(contents),
+                                 "[tenant]\nid = %zu\n",
+                                 i);
+                }
+
+                if (write_file(files->paths[i], contents) != 0) {
+                        return -1;
+                }
+        }
+
+        return 0;
+}
+
+static int teardown_files(void **state)
+{
+        struct batch_files *files = *state;
+
+        for (size_t i = 0; i < FILE_COUNT; ++i) {
+                unlink(files->paths[i]);
+        }
+
+        rmdir(files->dir);
+        free(files);
+
+        return 0;
+}
+
+static void check_results(const struct batch_files *files, size_t nthreads)
+{
+        struct sroc_parse_result results[FILE_COUNT];
+        int expected_failures = 0;
+        int failures = sroc_parse_many(
+                files->path_list, FILE_COUNT, nthreads, results);
+
+        for (size_t i = 0; i < FILE_COUNT; ++i) {
+                if (i % 11 == 10) {
+                        ++expected_failures;
+                        assert_null(results[i].root);
+                        assert_int_equal(SROC_ERRIO, results[i].error);
+                } else if (i % 7 == 6) {
+                        ++expected_failures;
+                        assert_null(results[i].root);
+                        assert_int_equal(SROC_ERRINVAL, results[i].error);
+                } else {
+                        int64_t id;
+
+                        assert_int_equal(0, results[i].error);
+                        assert_int_equal(0,
+                                         sroc_read_number(results[i].root,
+                                                          "tenant",
+                                                          "id",
+                                                          &id));
+                        assert_int_equal(i, id);
+                }
+
+                sroc_destroy_root(results[i].root);
+        }
+
+        assert_int_equal(expected_failures, failures);
+}
+
+static void test_sroc_parse_many_single_thread(void **state)
+{
+        check_results(*state, 1);
+}
+
+static void test_sroc_parse_many_threads(void **state)
+{
+        check_results(*state, 4);
+        check_results(*state, 0);
+}
+
+static void test_sroc_parse_many_more_threads_than_files(void **state)
+{
+        check_results(*state, FILE_COUNT * 2);
+}
+
+static void test_sroc_parse_many_empty(void **state)
+{
+        assert_int_equal(0, sroc_parse_many(NULL, 0, 4, NULL));
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test(test_sroc_parse_many_single_thread),
+                cmocka_unit_test(test_sroc_parse_many_threads),
+                cmocka_unit_test(test_sroc_parse_many_more_threads_than_files),
+                cmocka_unit_test(test_sroc_parse_many_empty),
+        };
+
+        return cmocka_run_group_tests(tests, setup_files, teardown_files);
+}
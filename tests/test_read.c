@@ -0,0 +1,149 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+#include <sroc.h>
+
+static const char *test_string = "name = \"app\"\n"
+                                 "\n"
+                                 "[tenant_b]\n"
+                                 "backend_02_host = \"b2\"\n"
+                                 "backend_01_host = \"b1\"\n"
+                                 "backend = \"bare\"\n"
+                                 "backends = [1, 2]\n"
+                                 "port = 80\n"
+                                 "enabled = true\n"
+                                 "\n"
+                                 "[other]\n"
+                                 "\n"
+                                 "[tenant_a]\n"
+                                 "\n"
+                                 "[tenant]\n";
+
+static void test_sroc_read_values(void **state)
+{
+        struct sroc_root *root = sroc_parse_string(test_string);
+        const char *string;
+        int64_t number;
+        bool boolean;
+        struct sroc_array *array;
+        size_t length;
+
+        assert_int_equal(0, sroc_read_string(root, NULL, "name", &string));
+        assert_string_equal("app", string);
+        assert_int_equal(0,
+                         sroc_read_number(root, "tenant_b", "port", &number));
+        assert_int_equal(80, number);
+        assert_int_equal(0,
+                         sroc_read_bool(root, "tenant_b", "enabled", &boolean));
+        assert_true(boolean);
+        assert_int_equal(
+                0,
+                sroc_read_array(root, "tenant_b", "backends", &array, &length));
+        assert_int_equal(2, length);
+        assert_int_equal(2, array->items[1]->number);
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_read_errors(void **state)
+{
+        struct sroc_root *root = sroc_parse_string(test_string);
+        int64_t number;
+
+        assert_int_equal(SROC_ERRNOSECTION,
+                         sroc_read_number(root, "missing", "port", &number));
+        assert_int_equal(
+                SROC_ERRNOKEY,
+                sroc_read_number(root, "tenant_b", "missing", &number));
+        assert_int_equal(SROC_ERRTYPE,
+                         sroc_read_number(root, NULL, "name", &number));
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_iter_sections_prefix(void **state)
+{
+        struct sroc_root *root = sroc_parse_string(test_string);
+        struct sroc_section_cursor cursor;
+
+        sroc_iter_sections_prefix(root, "tenant_", &cursor);
+
+        assert_string_equal("tenant_a", sroc_next_section(&cursor)->key);
+        assert_string_equal("tenant_b", sroc_next_section(&cursor)->key);
+        assert_null(sroc_next_section(&cursor));
+
+        sroc_iter_sections_prefix(root, "", &cursor);
+
+        size_t count = 0;
+
+        while (sroc_next_section(&cursor) != NULL) {
+                ++count;
+        }
+
+        assert_int_equal(4, count);
+
+        sroc_iter_sections_prefix(root, "zzz", &cursor);
+
+        assert_null(sroc_next_section(&cursor));
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_iter_keys_prefix(void **state)
+{
+        struct sroc_root *root = sroc_parse_string(test_string);
+        struct sroc_table *table;
+        struct sroc_key_cursor cursor;
+
+        assert_int_equal(0, sroc_get_section(root, "tenant_b", &table));
+
+        sroc_iter_keys_prefix(table, "backend_", &cursor);
+
+        assert_string_equal("backend_01_host", sroc_next_key(&cursor)->key);
+        assert_string_equal("backend_02_host", sroc_next_key(&cursor)->key);
+        assert_null(sroc_next_key(&cursor));
+
+        sroc_iter_keys_prefix(table, "backend", &cursor);
+
+        assert_string_equal("backend", sroc_next_key(&cursor)->key);
+        assert_string_equal("backend_01_host", sroc_next_key(&cursor)->key);
+        assert_string_equal("backend_02_host", sroc_next_key(&cursor)->key);
+        assert_string_equal("backends", sroc_next_key(&cursor)->key);
+        assert_null(sroc_next_key(&cursor));
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_iter_unindexed_table(void **state)
+{
+        struct sroc_table *table = sroc_create_table(strdup("empty"));
+        struct sroc_key_cursor cursor;
+
+        sroc_iter_keys_prefix(table, "", &cursor);
+
+        assert_null(sroc_next_key(&cursor));
+
+        sroc_destroy_table(table);
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test(test_sroc_read_values),
+                cmocka_unit_test(test_sroc_read_errors),
+                cmocka_unit_test(test_sroc_iter_sections_prefix),
+                cmocka_unit_test(test_sroc_iter_keys_prefix),
+                cmocka_unit_test(test_sroc_iter_unindexed_table),
+        };
+
+        return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,155 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+#include <sroc.h>
+
+static const char *original_string = "name = \"app\"\n"
+                                     "\n"
+                                     "[db]\n"
+                                     "host = \"db.local\"\n"
+                                     "ports = [\n"
+                                     "    [5432],\n"
+                                     "    [5433],\n"
+                                     "]\n"
+                                     "\n"
+                                     "[cache]\n"
+                                     "size = 64\n"
+                                     "motd = \"[not a section]\"\n"
+                                     "\n"
+                                     "[log]\n"
+                                     "level = \"info\"\n";
+
+static void test_sroc_reparse_identical_moves_everything(void **state)
+{
+        struct sroc_root *old_root = sroc_parse_string(original_string);
+        struct sroc_item **old_items = old_root->items;
+        struct sroc_table *old_sections[3];
+
+        assert_int_equal(3, old_root->sections_length);
+        memcpy(old_sections, old_root->sections, sizeof(old_sections));
+
+        struct sroc_root *root = sroc_reparse(
+                old_root, original_string, strlen(original_string));
+
+        assert_non_null(root);
+        assert_ptr_equal(old_items, root->items);
+        assert_int_equal(3, root->sections_length);
+
+        for (size_t i = 0; i < 3; ++i) {
+                assert_ptr_equal(old_sections[i], root->sections[i]);
+        }
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_reparse_changed_section(void **state)
+{
+        const char *changed_string = "name = \"app\"\n"
+                                     "\n"
+                                     "[db]\n"
+                                     "host = \"db.local\"\n"
+                                     "ports = [\n"
+                                     "    [5432],\n"
+                                     "    [5433],\n"
+                                     "]\n"
+                                     "\n"
+                                     "[cache]\n"
+                                     "size = 128\n"
+                                     "motd = \"[not a section]\"\n"
+                                     "\n"
+                                     "[log]\n"
+                                     "level = \"info\"\n";
+        struct sroc_root *old_root = sroc_parse_string(original_string);
+        struct sroc_table *old_db = old_root->sections[0];
+        struct sroc_table *old_cache = old_root->sections[1];
+        struct sroc_table *old_log = old_root->sections[2];
+
+        struct sroc_root *root = sroc_reparse(
+                old_root, changed_string, strlen(changed_string));
+
+        assert_non_null(root);
+        assert_int_equal(1, root->items_length);
+        assert_int_equal(3, root->sections_length);
+        assert_ptr_equal(old_db, root->sections[0]);
+        assert_ptr_not_equal(old_cache, root->sections[1]);
+        assert_ptr_equal(old_log, root->sections[2]);
+        assert_string_equal("cache", root->sections[1]->key);
+        assert_int_equal(128, root->sections[1]->items[0]->value->number);
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_reparse_added_removed_reordered(void **state)
+{
+        const char *changed_string = "name = \"renamed\"\n"
+                                     "\n"
+                                     "[metrics]\n"
+                                     "port = 9090\n"
+                                     "\n"
+                                     "[log]\n"
+                                     "level = \"info\"\n";
+        struct sroc_root *old_root = sroc_parse_string(original_string);
+        struct sroc_table *old_log = old_root->sections[2];
+
+        struct sroc_root *root = sroc_reparse(
+                old_root, changed_string, strlen(changed_string));
+
+        assert_non_null(root);
+        assert_string_equal("renamed", root->items[0]->value->string);
+        assert_int_equal(2, root->sections_length);
+        assert_string_equal("metrics", root->sections[0]->key);
+        assert_ptr_equal(old_log, root->sections[1]);
+
+        sroc_destroy_root(root);
+}
+
+static void test_sroc_reparse_invalid_keeps_old_root(void **state)
+{
+        const char *invalid_string = "name = \"app\"\n"
+                                     "\n"
+                                     "[db]\n"
+                                     "host = oops\n";
+        struct sroc_root *old_root = sroc_parse_string(original_string);
+        struct sroc_root *root = sroc_reparse(
+                old_root, invalid_string, strlen(invalid_string));
+
+        assert_null(root);
+        assert_int_equal(3, old_root->sections_length);
+        assert_string_equal("db.local",
+                            old_root->sections[0]->items[0]->value->string);
+
+        sroc_destroy_root(old_root);
+}
+
+static void test_sroc_reparse_null_old_root(void **state)
+{
+        struct sroc_root *root = sroc_reparse(
+                NULL, original_string, strlen(original_string));
+
+        assert_non_null(root);
+        assert_int_equal(3, root->sections_length);
+
+        sroc_destroy_root(root);
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test(test_sroc_reparse_identical_moves_everything),
+                cmocka_unit_test(test_sroc_reparse_changed_section),
+                cmocka_unit_test(test_sroc_reparse_added_removed_reordered),
+                cmocka_unit_test(test_sroc_reparse_invalid_keeps_old_root),
+                cmocka_unit_test(test_sroc_reparse_null_old_root),
+        };
+
+        return cmocka_run_group_tests(tests, NULL, NULL);
+}
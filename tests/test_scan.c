@@ -0,0 +1,316 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+#include <sroc.h>
+
+#include "../src/scan.h"
+#include "../src/utf8.h"
+
+// Long enough to cover several blocks of the widest tier plus a tail
+#define PADDED_LENGTH 200
+
+// Characters each kernel stops at or runs over, and a few it must not mix up
+static const char scan_alphabet[] = " \t\r\n\v\f\b\x0e"
+                                    "09/:\"\\#;[]{}=,.ax\x80\xc3\xa9";
+
+static enum scan_tier initial_tier;
+
+static int save_tier(void **state)
+{
+        initial_tier = scan_active_tier();
+
+        return 0;
+}
+
+static int restore_tier(void **state)
+{
+        return scan_use_tier(initial_tier);
+}
+
+/**
+ * Runs every kernel of every supported tier over buffer at each offset and
+ * length up to length, checking each agrees with the scalar tier
+ */
+static void check_tiers_agree(const char *buffer, size_t length)
+{
+        struct scan_kernels scalar;
+
+        assert_int_equal(0, scan_use_tier(SCAN_SCALAR));
+        scalar = scan_kernels;
+
+        for (int tier = SCAN_SSE2; tier <= (int)scan_supported_tier(); ++tier) {
+                assert_int_equal(0, scan_use_tier((enum scan_tier)tier));
+
+                for (size_t at = 0; at < length; at += 7) {
+                        const char *start = buffer + at;
+                        size_t rest = length - at;
+
+                        assert_int_equal(scalar.skip_blanks(start, rest),
+                                         scan_kernels.skip_blanks(start, rest));
+                        assert_int_equal(scalar.skip_space(start, rest),
+                                         scan_kernels.skip_space(start, rest));
+                        assert_int_equal(
+                                scalar.skip_space_back(buffer, length - at),
+                                scan_kernels.skip_space_back(buffer,
+                                                             length - at));
+                        assert_int_equal(
+                                scalar.count_digits(start, rest),
+                                scan_kernels.count_digits(start, rest));
+                        assert_int_equal(
+                                scalar.find_string_stop(start, rest),
+                                scan_kernels.find_string_stop(start, rest));
+                        assert_int_equal(
+                                scalar.find_section_stop(start, rest),
+                                scan_kernels.find_section_stop(start, rest));
+                        assert_int_equal(
+                                scalar.utf8_validate(start, rest),
+                                scan_kernels.utf8_validate(start, rest));
+                }
+        }
+}
+
+static void test_scan_tiers(void **state)
+{
+        enum scan_tier supported = scan_supported_tier();
+
+        assert_true(scan_active_tier() <= supported);
+        assert_string_equal("scalar", scan_tier_name(SCAN_SCALAR));
+        assert_string_equal("avx512", scan_tier_name(SCAN_AVX512));
+
+        for (int tier = SCAN_SCALAR; tier <= SCAN_AVX512; ++tier) {
+                int expected = (tier <= (int)supported) ? 0 : -1;
+
+                assert_int_equal(expected,
+                                 scan_use_tier((enum scan_tier)tier));
+        }
+
+        // A tier the CPU cannot run leaves the active one alone
+        assert_true(scan_active_tier() <= supported);
+}
+
+/**
+ * Moves each stop character through every position of a run the kernels
+ * skip, so it lands on, before and across each block boundary
+ */
+static void test_scan_block_boundaries(void **state)
+{
+        const struct {
+                char fill;
+                char stop;
+        } cases[] = {
+                {' ', 'a'},
+                {'\t', '\n'},
+                {'\f', '\x0e'},
+                {'\v', '\b'},
+                {'5', '/'},
+                {'0', ':'},
+                {'x', '"'},
+                {'x', '\\'},
+                {'x', '\n'},
+                {'=', '#'},
+                {'=', ';'},
+                {'=', '}'},
+                {'a', '\x80'},
+        };
+        char buffer[PADDED_LENGTH];
+
+        for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+                for (size_t at = 0; at <= PADDED_LENGTH; ++at) {
+                        memset(buffer, cases[c].fill, PADDED_LENGTH);
+
+                        if (at < PADDED_LENGTH) {
+                                buffer[at] = cases[c].stop;
+                        }
+
+                        for (size_t length = at; length <= PADDED_LENGTH;
+                             length += 13) {
+                                check_tiers_agree(buffer, length);
+                        }
+                }
+        }
+}
+
+static void test_scan_random(void **state)
+{
+        char buffer[PADDED_LENGTH];
+        size_t alphabet_length = sizeof(scan_alphabet) - 1;
+        uint32_t seed = 7;
+
+        for (int i = 0; i < 2000; ++i) {
+                seed = seed * 1103515245 + 12345;
+
+                // Runs of one character make the kernels cross blocks
+                size_t length = (seed >> 16) % (PADDED_LENGTH + 1);
+                char run = scan_alphabet[(seed >> 8) % alphabet_length];
+
+                for (size_t pos = 0; pos < length; ++pos) {
+                        seed = seed * 1103515245 + 12345;
+
+                        buffer[pos] = ((seed >> 16) % 16 == 0)
+                                              ? scan_alphabet[(seed >> 20)
+                                                              % alphabet_length]
+                                              : run;
+                }
+
+                check_tiers_agree(buffer, length);
+        }
+}
+
+static void test_scan_small_matches(void **state)
+{
+        uint64_t hashes[SROC_SMALL_OBJECT];
+        uint32_t seed = 11;
+
+        for (int i = 0; i < 2000; ++i) {
+                // Few distinct hashes, so most sets hold repeats, and some
+                // differ from others in one half only
+                for (size_t h = 0; h < SROC_SMALL_OBJECT; ++h) {
+                        seed = seed * 1103515245 + 12345;
+                        hashes[h] = (uint64_t)((seed >> 16) % 3) << 32
+                                    | (seed >> 24) % 3;
+                }
+
+                seed = seed * 1103515245 + 12345;
+
+                uint64_t hash = (uint64_t)((seed >> 16) % 3) << 32
+                                | (seed >> 24) % 3;
+                unsigned int expected = 0;
+
+                for (size_t h = 0; h < SROC_SMALL_OBJECT; ++h) {
+                        expected |= (unsigned int)(hashes[h] == hash) << h;
+                }
+
+                for (int tier = SCAN_SCALAR;
+                     tier <= (int)scan_supported_tier(); ++tier) {
+                        assert_int_equal(0,
+                                         scan_use_tier((enum scan_tier)tier));
+                        assert_int_equal(expected,
+                                         scan_kernels.small_matches(hashes,
+                                                                    hash));
+                }
+        }
+}
+
+/**
+ * Emits the tree parsed from text, or NULL when parsing or emitting fails
+ */
+static char *parse_and_emit(const char *text)
+{
+        struct sroc_root *root = sroc_parse_string(text);
+        struct sroc_sink sink;
+
+        if (root == NULL) {
+                return NULL;
+        }
+
+        sroc_init_buffer_sink(&sink);
+
+        int result = sroc_emit(root, &sink);
+
+        sroc_destroy_root(root);
+
+        if (result != 0) {
+                sroc_release_sink(&sink);
+
+                return NULL;
+        }
+
+        return sink.buffer.data;
+}
+
+static void test_scan_parse_matches_across_tiers(void **state)
+{
+        const char *lines[] = {
+                "\n",
+                "# a comment with \"quotes\" and [brackets]\n",
+                "    ; indented comment\n",
+                "[section_with_a_rather_long_name_to_scan]\n",
+                "key = \"a string long enough to span a few vector blocks\"\n",
+                "esc = \"say \\\"hi\\\" \\\\ again\"\n",
+                "utf = \"caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x91\x8b\"\n",
+                "num = 1,234,567,890\n",
+                "neg = -12345678901234567\n",
+                "frac = 3.14159265358979\n",
+                "arr = [1, 22, 333,\t4444]\n",
+                "obj = {a: 1, b: \"two\", c: [3, 4]}\n",
+                "flag = true\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\r\n",
+                "big = 99999999999999999999\n",
+                "bad = \"caf\xc3\"\n",
+                "open = \"unterminated\n",
+        };
+        size_t line_count = sizeof(lines) / sizeof(lines[0]);
+        char text[4096];
+        uint32_t seed = 3;
+
+        for (int i = 0; i < 300; ++i) {
+                size_t length = 0;
+
+                text[0] = '\0';
+
+                for (;;) {
+                        seed = seed * 1103515245 + 12345;
+
+                        // Lines that fail to parse are rare, so most texts
+                        // parse for a while first
+                        size_t line = (seed >> 16) % (line_count * 4);
+
+                        line = (line < line_count * 3) ? line % (line_count - 3)
+                                                       : line % line_count;
+
+                        size_t line_length = strlen(lines[line]);
+
+                        if (length + line_length >= sizeof(text)
+                            || (seed >> 8) % 32 == 0) {
+                                break;
+                        }
+
+                        memcpy(text + length, lines[line], line_length + 1);
+                        length += line_length;
+                }
+
+                assert_int_equal(0, scan_use_tier(SCAN_SCALAR));
+
+                char *expected = parse_and_emit(text);
+
+                for (int tier = SCAN_SSE2; tier <= (int)scan_supported_tier();
+                     ++tier) {
+                        assert_int_equal(0,
+                                         scan_use_tier((enum scan_tier)tier));
+
+                        char *emitted = parse_and_emit(text);
+
+                        if (expected == NULL) {
+                                assert_null(emitted);
+                        } else {
+                                assert_non_null(emitted);
+                                assert_string_equal(expected, emitted);
+                        }
+
+                        free(emitted);
+                }
+
+                free(expected);
+        }
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test(test_scan_tiers),
+                cmocka_unit_test(test_scan_block_boundaries),
+                cmocka_unit_test(test_scan_random),
+                cmocka_unit_test(test_scan_small_matches),
+                cmocka_unit_test(test_scan_parse_matches_across_tiers),
+        };
+
+        return cmocka_run_group_tests(tests, save_tier, restore_tier);
+}
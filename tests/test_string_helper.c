@@ -341,6 +341,193 @@ static void test_string_strip_surrounding_space_single_space(void **state)
         free(dest);
 }
 
+// The span helpers replace the functions above, so each one is checked
+// against its null terminated counterpart on the same inputs
+
+static const char *equivalence_inputs[] = {
+        "",
+        " ",
+        "x",
+        "  f  ",
+        "h ",
+        "\t\n\v\f\r mixed \t whitespace \r\n",
+        "    Hello world! - Test     ",
+        "no_space_at_all",
+        "                                   long leading run",
+        "long trailing run                                    ",
+        "                                                     ",
+        "key = value\nnext = line\n",
+};
+
+#define EQUIVALENCE_COUNT                                                      \
+        (sizeof(equivalence_inputs) / sizeof(equivalence_inputs[0]))
+
+/**
+ * Builds strings of every length up to 80 out of a pseudo random mix of
+ * spaces, tabs and letters so runs cross the 16 byte blocks of the vector
+ * paths at every offset
+ */
+static void generate_input(char *buffer, size_t length, uint32_t *seed)
+{
+        static const char alphabet[] = "    \t\t\nab";
+
+        for (size_t i = 0; i < length; ++i) {
+                *seed = *seed * 1103515245 + 12345;
+                buffer[i] = alphabet[(*seed >> 16) % (sizeof(alphabet) - 1)];
+        }
+
+        buffer[length] = '\0';
+}
+
+static void check_trim_equivalence(const char *string)
+{
+        struct sroc_span span;
+        struct sroc_span trimmed;
+        int64_t first = string_find_first_nonspace(string);
+        int64_t last = string_find_last_nonspace(string);
+        char *stripped = NULL;
+        int64_t stripped_length
+                = string_strip_surrounding_space(string, &stripped);
+
+        span_from_string(&span, string);
+        span_trim(&span, &trimmed);
+
+        if (first < 0) {
+                assert_int_equal(span.n, span_skip_space(&span));
+                assert_int_equal(0, span_skip_space_back(&span));
+                assert_int_equal(-1, stripped_length);
+                assert_int_equal(0, trimmed.n);
+
+                return;
+        }
+
+        assert_int_equal(first, span_skip_space(&span));
+        assert_int_equal(last + 1, span_skip_space_back(&span));
+        assert_int_equal(stripped_length, trimmed.n);
+        assert_memory_equal(stripped, trimmed.p, trimmed.n);
+        assert_ptr_equal(string + first, trimmed.p);
+
+        free(stripped);
+}
+
+static void test_span_trim_equivalence(void **state)
+{
+        char buffer[81];
+        uint32_t seed = 7;
+
+        for (size_t i = 0; i < EQUIVALENCE_COUNT; ++i) {
+                check_trim_equivalence(equivalence_inputs[i]);
+        }
+
+        for (int round = 0; round < 50; ++round) {
+                for (size_t length = 0; length < sizeof(buffer); ++length) {
+                        generate_input(buffer, length, &seed);
+                        check_trim_equivalence(buffer);
+                }
+        }
+}
+
+static void test_span_get_delimiter_equivalence(void **state)
+{
+        const char delimiters[] = {'\n', '=', '!', ' '};
+
+        for (size_t i = 0; i < EQUIVALENCE_COUNT; ++i) {
+                for (size_t d = 0; d < sizeof(delimiters); ++d) {
+                        const char *string = equivalence_inputs[i];
+                        char delimiter = delimiters[d];
+                        struct sroc_span span;
+                        struct sroc_span found = {NULL, 0};
+                        char *dest = NULL;
+                        int64_t expected = string_get_delimiter(
+                                string, delimiter, &dest);
+
+                        span_from_string(&span, string);
+
+                        assert_int_equal(
+                                expected,
+                                span_get_delimiter(&span, delimiter, &found));
+                        assert_int_equal(expected, span_find(&span, delimiter));
+
+                        if (expected >= 0) {
+                                assert_ptr_equal(string, found.p);
+                                assert_memory_equal(dest, found.p, found.n);
+                                free(dest);
+                        }
+                }
+        }
+}
+
+static void test_span_splice_equivalence(void **state)
+{
+        const char *string = "Hello world!";
+        struct sroc_span span;
+
+        span_from_string(&span, string);
+
+        for (int64_t start = 0; start <= (int64_t)span.n + 1; ++start) {
+                for (int64_t end = 0; end <= (int64_t)span.n + 1; ++end) {
+                        struct sroc_span view;
+                        char *dest = NULL;
+                        int64_t expected
+                                = string_splice(string, &dest, start, end);
+                        int result = span_splice(
+                                &span, (size_t)start, (size_t)end, &view);
+
+                        if (expected < 0) {
+                                assert_int_equal(-1, result);
+
+                                continue;
+                        }
+
+                        assert_int_equal(0, result);
+                        assert_int_equal(expected, view.n);
+                        assert_memory_equal(dest, view.p, view.n);
+                        free(dest);
+                }
+        }
+}
+
+static void test_span_bounded_by_length(void **state)
+{
+        // Nothing past n is ever read, so the bytes after it do not matter
+        const char buffer[] = {' ', 'a', 'b', ' ', '=', 'c'};
+        struct sroc_span span;
+        struct sroc_span trimmed;
+        struct sroc_span copy;
+
+        span_init(&span, buffer, 4);
+        span_trim(&span, &trimmed);
+
+        assert_int_equal(2, trimmed.n);
+        assert_ptr_equal(buffer + 1, trimmed.p);
+        assert_int_equal(-1, span_find(&span, '='));
+
+        span_init(&copy, buffer + 1, 2);
+
+        char *string = span_dup(&copy);
+
+        assert_string_equal("ab", string);
+        free(string);
+}
+
+static void test_span_unescape(void **state)
+{
+        const char buffer[] = "say \\\"hi\\\" \\\\ x\"";
+        char dest[sizeof(buffer)];
+        struct sroc_span span;
+
+        // Leave out the closing quote, as the parser does
+        span_init(&span, buffer, sizeof(buffer) - 2);
+
+        assert_int_equal(12, span_unescape(&span, dest));
+        assert_string_equal("say \"hi\" \\ x", dest);
+
+        span_init(&span, buffer, 0);
+
+        assert_int_equal(0, span_unescape(&span, dest));
+        assert_string_equal("", dest);
+}
+
 int main(void)
 {
         const struct CMUnitTest tests[] = {
@@ -377,6 +564,11 @@ int main(void)
                 cmocka_unit_test(test_string_strip_surrounding_space_sentence),
                 cmocka_unit_test(
                         test_string_strip_surrounding_space_single_space),
+                cmocka_unit_test(test_span_trim_equivalence),
+                cmocka_unit_test(test_span_get_delimiter_equivalence),
+                cmocka_unit_test(test_span_splice_equivalence),
+                cmocka_unit_test(test_span_bounded_by_length),
+                cmocka_unit_test(test_span_unescape),
         };
 
         return cmocka_run_group_tests(tests, NULL, NULL);
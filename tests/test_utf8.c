@@ -0,0 +1,183 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <locale.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+
+#include "../src/parse_helper.h"
+#include "../src/utf8.h"
+
+// Long enough to cover several vector blocks plus a scalar tail
+#define PADDED_LENGTH 100
+
+static void test_utf8_validate_valid(void **state)
+{
+        const char *valid = "plain ascii, "
+                            "caf\xc3\xa9, "
+                            "\xe2\x82\xac, "
+                            "\xf0\x9f\x91\x8b, "
+                            "\xed\x9f\xbf, "
+                            "\xf4\x8f\xbf\xbf";
+
+        assert_int_equal(strlen(valid), utf8_validate(valid, strlen(valid)));
+        assert_int_equal(0, utf8_validate("", 0));
+}
+
+static void test_utf8_validate_invalid(void **state)
+{
+        // Each case is valid up to the offset of the bad sequence
+        const struct {
+                const char *input;
+                size_t offset;
+        } cases[] = {
+                {"ab\x80", 2},                   // Lone continuation byte
+                {"ab\xc3", 2},                   // Truncated at the end
+                {"ab\xc3z", 2},                  // Missing continuation
+                {"\xc0\xaf", 0},                 // Overlong two byte
+                {"x\xe0\x80\xaf", 1},            // Overlong three byte
+                {"xy\xf0\x80\x80\xaf", 2},       // Overlong four byte
+                {"\xed\xa0\x80", 0},             // UTF-16 surrogate
+                {"\xf4\x90\x80\x80", 0},         // Past U+10FFFF
+                {"\xf5\x80\x80\x80", 0},         // Invalid lead byte
+                {"\xff", 0},                     // Never valid
+                {"\xe2\x82\xac\xe2\x82", 3},     // Truncated after valid
+                {"\xc3\xa9\x80", 2},             // Too many continuations
+        };
+
+        for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+                size_t length = strlen(cases[i].input);
+
+                assert_int_equal(cases[i].offset,
+                                 utf8_validate(cases[i].input, length));
+                assert_int_equal(cases[i].offset,
+                                 utf8_validate_scalar(cases[i].input, length));
+        }
+}
+
+/**
+ * Moves a sequence through every position of an ASCII buffer so it lands on,
+ * before and across each vector block boundary
+ */
+static void test_utf8_validate_block_boundaries(void **state)
+{
+        const char *sequences[] = {
+                "\xc3\xa9",
+                "\xe2\x82\xac",
+                "\xf0\x9f\x91\x8b",
+                "\xe2\x82",
+                "\xf0\x80\x80\x80",
+                "\x80",
+        };
+        char buffer[PADDED_LENGTH];
+
+        for (size_t s = 0; s < sizeof(sequences) / sizeof(sequences[0]); ++s) {
+                size_t length = strlen(sequences[s]);
+
+                for (size_t at = 0; at + length <= PADDED_LENGTH; ++at) {
+                        memset(buffer, 'a', PADDED_LENGTH);
+                        memcpy(buffer + at, sequences[s], length);
+
+                        assert_int_equal(
+                                utf8_validate_scalar(buffer, PADDED_LENGTH),
+                                utf8_validate(buffer, PADDED_LENGTH));
+                }
+
+                // Truncated by the end of the buffer
+                for (size_t cut = 0; cut < length; ++cut) {
+                        size_t at = PADDED_LENGTH - cut;
+
+                        memset(buffer, 'a', PADDED_LENGTH);
+                        memcpy(buffer + at, sequences[s], cut);
+
+                        assert_int_equal(
+                                utf8_validate_scalar(buffer, PADDED_LENGTH),
+                                utf8_validate(buffer, PADDED_LENGTH));
+                }
+        }
+}
+
+static void test_utf8_validate_matches_scalar(void **state)
+{
+        const char *pieces[] = {
+                "a",
+                "abcdefghijklmnopqrstuvwxyz",
+                "\xc3\xa9",
+                "\xe2\x82\xac",
+                "\xf0\x9f\x91\x8b",
+                "\x80",
+                "\xc3",
+                "\xed\xa0\x80",
+        };
+        size_t piece_count = sizeof(pieces) / sizeof(pieces[0]);
+        char buffer[512];
+        uint32_t seed = 1;
+
+        for (int i = 0; i < 20000; ++i) {
+                size_t length = 0;
+
+                for (;;) {
+                        seed = seed * 1103515245 + 12345;
+
+                        // Invalid pieces are rare so most inputs are valid
+                        // for a while before failing
+                        size_t piece = (seed >> 16) % (piece_count * 8);
+
+                        if (piece < piece_count * 7) {
+                                piece %= 5;
+                        } else {
+                                piece %= piece_count;
+                        }
+
+                        const char *next = pieces[piece];
+                        size_t next_length = strlen(next);
+
+                        if (length + next_length > sizeof(buffer)
+                            || (seed >> 8) % 64 == 0) {
+                                break;
+                        }
+
+                        memcpy(buffer + length, next, next_length);
+                        length += next_length;
+                }
+
+                assert_int_equal(utf8_validate_scalar(buffer, length),
+                                 utf8_validate(buffer, length));
+        }
+}
+
+static void test_char_to_token_ignores_locale(void **state)
+{
+        // Latin-1 locales consider 0xE9 alphabetic, the parser never should
+        setlocale(LC_ALL, "");
+
+        for (int ch = 0x80; ch <= 0xFF; ++ch) {
+                assert_int_equal(UNKNOWN, char_to_token((char)ch));
+        }
+
+        assert_int_equal(ALPHA_CHAR, char_to_token('z'));
+        assert_int_equal(NUMERIC_CHAR, char_to_token('7'));
+        assert_int_equal(UNKNOWN, char_to_token('\0'));
+
+        setlocale(LC_ALL, "C");
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test(test_utf8_validate_valid),
+                cmocka_unit_test(test_utf8_validate_invalid),
+                cmocka_unit_test(test_utf8_validate_block_boundaries),
+                cmocka_unit_test(test_utf8_validate_matches_scalar),
+                cmocka_unit_test(test_char_to_token_ignores_locale),
+        };
+
+        return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,856 @@
+// Copyright 2019 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+// sroc-compile turns a sroc file into C source which defines the parsed tree
+// as static const data, so fixed configurations need no parsing at runtime
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sroc.h>
+
+#include "../src/hash.h"
+
+// Number of seeds tried for a bucket before the slot count is doubled
+#define MAX_SEED_TRIALS (1 << 16)
+
+// Places the fields of generated objects. Any seed but 0 does, which marks
+// objects placed by the keyed hash of the process that built them
+#define OBJECT_SEED UINT64_C(0x9e3779b97f4a7c15)
+
+struct generator {
+        FILE *out;
+        size_t counter;
+};
+
+/**
+ * A perfect lookup under construction. hashes holds the key hash of every
+ * entry and skip marks duplicate keys, which only the first occurrence can
+ * resolve
+ */
+struct perfect_lookup {
+        size_t length;
+        uint64_t *hashes;
+        bool *skip;
+        size_t mask;
+        size_t *slots;
+        size_t seeds_mask;
+        uint64_t *seeds;
+};
+
+static void *checked_calloc(size_t count, size_t size)
+{
+        void *memory = calloc(count == 0 ? 1 : count, size);
+
+        if (memory == NULL) {
+                fprintf(stderr, "sroc-compile: out of memory\n");
+                exit(EXIT_FAILURE);
+        }
+
+        return memory;
+}
+
+static uint64_t seed_for_trial(size_t trial)
+{
+        return (trial == 0) ? 0 : hash_mix((uint64_t)trial);
+}
+
+static size_t slot_for(uint64_t hash, uint64_t seed, size_t mask)
+{
+        return (size_t)hash_mix(hash ^ seed) & mask;
+}
+
+/**
+ * Finds a seed which places every member of a bucket into a free and distinct
+ * slot, and claims those slots
+ */
+static bool place_bucket(struct perfect_lookup *lookup, const size_t *members,
+                         size_t count, uint64_t *seed_dest)
+{
+        for (size_t trial = 0; trial < MAX_SEED_TRIALS; ++trial) {
+                uint64_t seed = seed_for_trial(trial);
+                size_t placed = 0;
+
+                while (placed < count) {
+                        size_t member = members[placed];
+                        size_t slot = slot_for(
+                                lookup->hashes[member], seed, lookup->mask);
+
+                        if (lookup->slots[slot] != SROC_EMPTY_SLOT) {
+                                break;
+                        }
+
+                        lookup->slots[slot] = member;
+                        ++placed;
+                }
+
+                if (placed == count) {
+                        *seed_dest = seed;
+
+                        return true;
+                }
+
+                // Undo the partial placement of this trial
+                for (size_t i = 0; i < placed; ++i) {
+                        size_t member = members[i];
+
+                        lookup->slots[slot_for(lookup->hashes[member],
+                                               seed,
+                                               lookup->mask)]
+                                = SROC_EMPTY_SLOT;
+                }
+        }
+
+        return false;
+}
+
+/**
+ * Tries to place every bucket with the given slot count. Buckets are placed
+ * largest first since they are the hardest to fit
+ */
+static bool try_place_buckets(struct perfect_lookup *lookup, size_t capacity)
+{
+        size_t buckets = lookup->seeds_mask + 1;
+        size_t *starts = checked_calloc(buckets + 1, sizeof(size_t));
+        size_t *fill = checked_calloc(buckets, sizeof(size_t));
+        size_t *members = checked_calloc(lookup->length, sizeof(size_t));
+        size_t *order = checked_calloc(buckets, sizeof(size_t));
+        bool success = true;
+
+        lookup->mask = capacity - 1;
+        lookup->slots = checked_calloc(capacity, sizeof(size_t));
+
+        for (size_t i = 0; i < capacity; ++i) {
+                lookup->slots[i] = SROC_EMPTY_SLOT;
+        }
+
+        // Group the entries by bucket with a counting sort
+        for (size_t i = 0; i < lookup->length; ++i) {
+                if (!lookup->skip[i]) {
+                        ++starts[(lookup->hashes[i] & lookup->seeds_mask) + 1];
+                }
+        }
+
+        for (size_t i = 0; i < buckets; ++i) {
+                starts[i + 1] += starts[i];
+        }
+
+        for (size_t i = 0; i < lookup->length; ++i) {
+                if (!lookup->skip[i]) {
+                        size_t bucket = lookup->hashes[i] & lookup->seeds_mask;
+
+                        members[starts[bucket] + fill[bucket]++] = i;
+                }
+        }
+
+        // Order the buckets by descending size, bucket sizes are small so a
+        // pass per size is cheap
+        size_t largest = 0;
+        size_t ordered = 0;
+
+        for (size_t i = 0; i < buckets; ++i) {
+                if (fill[i] > largest) {
+                        largest = fill[i];
+                }
+        }
+
+        for (size_t size = largest; size > 0; --size) {
+                for (size_t i = 0; i < buckets; ++i) {
+                        if (fill[i] == size) {
+                                order[ordered++] = i;
+                        }
+                }
+        }
+
+        for (size_t i = 0; i < ordered && success; ++i) {
+                size_t bucket = order[i];
+
+                success = place_bucket(lookup,
+                                       members + starts[bucket],
+                                       fill[bucket],
+                                       &lookup->seeds[bucket]);
+        }
+
+        free(starts);
+        free(fill);
+        free(members);
+        free(order);
+
+        if (!success) {
+                free(lookup->slots);
+                lookup->slots = NULL;
+        }
+
+        return success;
+}
+
+/**
+ * Builds a lookup in which every key is found with a single probe. index must
+ * be the sorted index of keys, so duplicates are adjacent
+ */
+static void build_perfect_lookup(struct perfect_lookup *lookup,
+                                 const char *const *keys, const size_t *index,
+                                 size_t length)
+{
+        lookup->length = length;
+        lookup->hashes = checked_calloc(length, sizeof(uint64_t));
+        lookup->skip = checked_calloc(length, sizeof(bool));
+
+        for (size_t i = 0; i < length; ++i) {
+                lookup->hashes[i] = hash_bytes(keys[i], strlen(keys[i]));
+
+                if (i > 0 && strcmp(keys[index[i]], keys[index[i - 1]]) == 0) {
+                        lookup->skip[index[i]] = true;
+                }
+        }
+
+        size_t buckets = 1;
+
+        while (buckets * 4 < length) {
+                buckets *= 2;
+        }
+
+        lookup->seeds_mask = buckets - 1;
+        lookup->seeds = checked_calloc(buckets, sizeof(uint64_t));
+
+        size_t capacity = 8;
+
+        while (capacity < length * 2) {
+                capacity *= 2;
+        }
+
+        while (!try_place_buckets(lookup, capacity)) {
+                capacity *= 2;
+
+                if (capacity > length * 1024) {
+                        // Only two different keys with equal hashes get here
+                        fprintf(stderr,
+                                "sroc-compile: unable to build lookup\n");
+                        exit(EXIT_FAILURE);
+                }
+        }
+}
+
+static void destroy_perfect_lookup(struct perfect_lookup *lookup)
+{
+        free(lookup->hashes);
+        free(lookup->skip);
+        free(lookup->slots);
+        free(lookup->seeds);
+}
+
+static void write_c_string(FILE *out, const char *string)
+{
+        fputc('"', out);
+
+        for (const unsigned char *ch = (const unsigned char *)string;
+             *ch != '\0';
+             ++ch) {
+                if (*ch == '"' || *ch == '\\' || *ch == '?') {
+                        fprintf(out, "\\%c", *ch);
+                } else if (*ch >= 0x20 && *ch < 0x7f) {
+                        fputc(*ch, out);
+                } else {
+                        fprintf(out, "\\%03o", *ch);
+                }
+        }
+
+        fputc('"', out);
+}
+
+static void write_number(FILE *out, int64_t number)
+{
+        if (number == INT64_MIN) {
+                fprintf(out, "INT64_MIN");
+        } else {
+                fprintf(out, "INT64_C(%" PRId64 ")", number);
+        }
+}
+
+static void write_size_array(FILE *out, const char *name, size_t id,
+                             const size_t *values, size_t length)
+{
+        fprintf(out, "static const size_t %s%zu[] = {", name, id);
+
+        for (size_t i = 0; i < length; ++i) {
+                if (values[i] == SROC_EMPTY_SLOT) {
+                        fprintf(out, "%sSROC_EMPTY_SLOT", (i == 0) ? "" : ", ");
+                } else {
+                        fprintf(out, "%s%zu", (i == 0) ? "" : ", ", values[i]);
+                }
+        }
+
+        fprintf(out, "};\n");
+}
+
+/**
+ * Writes the sorted index and the perfect lookup of a list of keys and returns
+ * the id they were written under
+ */
+static size_t write_indexes(struct generator *generator,
+                            const char *const *keys, const size_t *index,
+                            size_t length)
+{
+        size_t id = generator->counter++;
+
+        if (length == 0) {
+                return id;
+        }
+
+        struct perfect_lookup lookup;
+
+        build_perfect_lookup(&lookup, keys, index, length);
+
+        write_size_array(generator->out, "index", id, index, length);
+        write_size_array(
+                generator->out, "slots", id, lookup.slots, lookup.mask + 1);
+
+        fprintf(generator->out, "static const uint64_t seeds%zu[] = {", id);
+
+        for (size_t i = 0; i <= lookup.seeds_mask; ++i) {
+                fprintf(generator->out,
+                        "%sUINT64_C(0x%016" PRIx64 ")",
+                        (i == 0) ? "" : ", ",
+                        lookup.seeds[i]);
+        }
+
+        fprintf(generator->out,
+                "};\n"
+                "#define LOOKUP%zu {%zu, (size_t *)slots%zu, %zu, "
+                "(uint64_t *)seeds%zu, NULL}\n",
+                id,
+                lookup.mask,
+                id,
+                lookup.seeds_mask,
+                id);
+
+        destroy_perfect_lookup(&lookup);
+
+        return id;
+}
+
+static void write_index_fields(struct generator *generator, size_t id,
+                               size_t length, const char *index_field,
+                               const char *lookup_field)
+{
+        if (length == 0) {
+                fprintf(generator->out,
+                        "        .%s = NULL,\n"
+                        "        .%s = {0, NULL, 0, NULL, NULL},\n",
+                        index_field,
+                        lookup_field);
+
+                return;
+        }
+
+        fprintf(generator->out,
+                "        .%s = (size_t *)index%zu,\n"
+                "        .%s = LOOKUP%zu,\n",
+                index_field,
+                id,
+                lookup_field,
+                id);
+}
+
+/**
+ * Writes the designated initializer of a value. Arrays and objects must have
+ * been written under id already
+ */
+static void write_initializer(FILE *out, const struct sroc_value *value,
+                              size_t id)
+{
+        switch (value->type) {
+        case SROC_ARRAY:
+                fprintf(out,
+                        "{.type = SROC_ARRAY, "
+                        ".array = (struct sroc_array *)&array%zu}",
+                        id);
+                break;
+        case SROC_BOOL:
+                fprintf(out,
+                        "{.type = SROC_BOOL, .boolean = %s}",
+                        value->boolean ? "true" : "false");
+                break;
+        case SROC_NUMBER:
+                fprintf(out, "{.type = SROC_NUMBER, .number = ");
+                write_number(out, value->number);
+                fprintf(out, "}");
+                break;
+        case SROC_STRING:
+                fprintf(out, "{.type = SROC_STRING, .string = (char *)");
+                write_c_string(out, value->string);
+                fprintf(out, "}");
+                break;
+        case SROC_OBJECT:
+                fprintf(out,
+                        "{.type = SROC_OBJECT, "
+                        ".object = (struct sroc_object *)&object%zu}",
+                        id);
+                break;
+        }
+}
+
+static size_t write_value(struct generator *generator,
+                          const struct sroc_value *value);
+
+/**
+ * Writes the contents of an array under a new id, children first
+ */
+static size_t write_array(struct generator *generator,
+                          const struct sroc_array *array)
+{
+        FILE *out = generator->out;
+        size_t *children = checked_calloc(array->length, sizeof(size_t));
+
+        for (size_t i = 0; i < array->length; ++i) {
+                children[i] = write_value(generator, array->items[i]);
+        }
+
+        size_t id = generator->counter++;
+
+        if (array->length > 0) {
+                fprintf(out,
+                        "static struct sroc_value *const "
+                        "array_items%zu[] = {",
+                        id);
+
+                for (size_t i = 0; i < array->length; ++i) {
+                        fprintf(out,
+                                "%s(struct sroc_value *)&value%zu",
+                                (i == 0) ? "" : ", ",
+                                children[i]);
+                }
+
+                fprintf(out, "};\n");
+        }
+
+        fprintf(out,
+                "static const struct sroc_array array%zu = {%zu, %d, ",
+                id,
+                array->length,
+                (int)array->type);
+
+        if (array->length > 0) {
+                fprintf(out, "(struct sroc_value **)array_items%zu", id);
+        } else {
+                fprintf(out, "NULL");
+        }
+
+        fprintf(out, ", %zu, true};\n", array->length);
+
+        free(children);
+
+        return id;
+}
+
+/**
+ * Places the fields of a large object again under OBJECT_SEED, since the
+ * parsed object placed them by a hash only this process can compute
+ */
+static size_t *place_fields(const struct sroc_object *object)
+{
+        size_t *slots = checked_calloc(object->mask + 1, sizeof(size_t));
+
+        for (size_t i = 0; i <= object->mask; ++i) {
+                slots[i] = SROC_EMPTY_SLOT;
+        }
+
+        for (size_t i = 0; i < object->length; ++i) {
+                size_t slot = slot_for(
+                        object->hashes[i], OBJECT_SEED, object->mask);
+
+                while (slots[slot] != SROC_EMPTY_SLOT) {
+                        slot = (slot + 1) & object->mask;
+                }
+
+                slots[slot] = i;
+        }
+
+        return slots;
+}
+
+/**
+ * Writes the contents of an object under a new id, children first. The
+ * fields and key hashes are copied from the parsed object as they are, the
+ * lookup is placed again by place_fields
+ */
+static size_t write_object(struct generator *generator,
+                           const struct sroc_object *object)
+{
+        FILE *out = generator->out;
+        size_t *children = checked_calloc(object->length, sizeof(size_t));
+        size_t hash_count = (object->slots == NULL) ? SROC_SMALL_OBJECT
+                                                    : object->length;
+
+        for (size_t i = 0; i < object->length; ++i) {
+                const struct sroc_value *value = &object->fields[i].value;
+
+                if (value->type == SROC_ARRAY) {
+                        children[i] = write_array(generator, value->array);
+                } else if (value->type == SROC_OBJECT) {
+                        children[i] = write_object(generator, value->object);
+                }
+        }
+
+        size_t id = generator->counter++;
+
+        if (object->length > 0) {
+                fprintf(out,
+                        "static const struct sroc_field object_fields%zu[] "
+                        "= {",
+                        id);
+
+                for (size_t i = 0; i < object->length; ++i) {
+                        fprintf(out, "%s{(char *)", (i == 0) ? "" : ", ");
+                        write_c_string(out, object->fields[i].key);
+                        fprintf(out, ", ");
+                        write_initializer(
+                                out, &object->fields[i].value, children[i]);
+                        fprintf(out, "}");
+                }
+
+                fprintf(out, "};\n");
+        }
+
+        fprintf(out, "static const uint64_t object_hashes%zu[] = {", id);
+
+        for (size_t i = 0; i < hash_count; ++i) {
+                fprintf(out,
+                        "%sUINT64_C(0x%016" PRIx64 ")",
+                        (i == 0) ? "" : ", ",
+                        object->hashes[i]);
+        }
+
+        fprintf(out, "};\n");
+
+        if (object->slots != NULL) {
+                size_t *slots = place_fields(object);
+
+                write_size_array(
+                        out, "object_slots", id, slots, object->mask + 1);
+                free(slots);
+        }
+
+        fprintf(out, "static const struct sroc_object object%zu = {%zu, ",
+                id,
+                object->length);
+
+        if (object->length > 0) {
+                fprintf(out, "(struct sroc_field *)object_fields%zu, ", id);
+        } else {
+                fprintf(out, "NULL, ");
+        }
+
+        fprintf(out, "(uint64_t *)object_hashes%zu, %zu, ", id, object->mask);
+
+        if (object->slots != NULL) {
+                fprintf(out, "(size_t *)object_slots%zu, ", id);
+        } else {
+                fprintf(out, "NULL, ");
+        }
+
+        fprintf(out, "UINT64_C(0x%016" PRIx64 ")};\n", OBJECT_SEED);
+
+        free(children);
+
+        return id;
+}
+
+/**
+ * Writes a value and everything it references, children first. Returns the
+ * id of the value
+ */
+static size_t write_value(struct generator *generator,
+                          const struct sroc_value *value)
+{
+        size_t id;
+
+        if (value->type == SROC_ARRAY) {
+                id = write_array(generator, value->array);
+        } else if (value->type == SROC_OBJECT) {
+                id = write_object(generator, value->object);
+        } else {
+                id = generator->counter++;
+        }
+
+        FILE *out = generator->out;
+
+        fprintf(out, "static const struct sroc_value value%zu = ", id);
+        write_initializer(out, value, id);
+        fprintf(out, ";\n");
+
+        return id;
+}
+
+/**
+ * Writes a list of items along with its indexes. Returns the id of the list
+ */
+static size_t write_items(struct generator *generator,
+                          struct sroc_item *const *items, const size_t *index,
+                          size_t length)
+{
+        FILE *out = generator->out;
+        size_t *ids = checked_calloc(length, sizeof(size_t));
+        const char **keys = checked_calloc(length, sizeof(char *));
+
+        for (size_t i = 0; i < length; ++i) {
+                size_t value_id = write_value(generator, items[i]->value);
+
+                ids[i] = generator->counter++;
+                keys[i] = items[i]->key;
+
+                fprintf(out,
+                        "static const struct sroc_item item%zu = {(char *)",
+                        ids[i]);
+                write_c_string(out, items[i]->key);
+                fprintf(out,
+                        ", (struct sroc_value *)&value%zu, "
+                        "UINT64_C(0x%016" PRIx64 "), false};\n",
+                        value_id,
+                        items[i]->value_hash);
+        }
+
+        size_t id = write_indexes(generator, keys, index, length);
+
+        if (length > 0) {
+                fprintf(out,
+                        "static struct sroc_item *const items%zu[] = {",
+                        id);
+
+                for (size_t i = 0; i < length; ++i) {
+                        fprintf(out,
+                                "%s(struct sroc_item *)&item%zu",
+                                (i == 0) ? "" : ", ",
+                                ids[i]);
+                }
+
+                fprintf(out, "};\n");
+        }
+
+        free(ids);
+        free(keys);
+
+        return id;
+}
+
+static size_t write_table(struct generator *generator,
+                          const struct sroc_table *table)
+{
+        FILE *out = generator->out;
+        size_t items_id = write_items(
+                generator, table->items, table->index, table->size);
+        size_t id = generator->counter++;
+
+        fprintf(out, "static const struct sroc_table table%zu = {\n", id);
+        fprintf(out, "        .key = (char *)");
+        write_c_string(out, table->key);
+        fprintf(out, ",\n        .size = %zu,\n", table->size);
+
+        if (table->size > 0) {
+                fprintf(out,
+                        "        .items = (struct sroc_item **)items%zu,\n",
+                        items_id);
+        } else {
+                fprintf(out, "        .items = NULL,\n");
+        }
+
+        // Span fingerprints are keyed per process, so a generated table has
+        // none
+        write_index_fields(generator, items_id, table->size, "index", "lookup");
+        fprintf(out, "};\n");
+
+        return id;
+}
+
+static void write_root(struct generator *generator,
+                       const struct sroc_root *root, const char *symbol)
+{
+        FILE *out = generator->out;
+        size_t items_id = write_items(
+                generator, root->items, root->items_index, root->items_length);
+        size_t *ids = checked_calloc(root->sections_length, sizeof(size_t));
+        const char **keys
+                = checked_calloc(root->sections_length, sizeof(char *));
+
+        for (size_t i = 0; i < root->sections_length; ++i) {
+                ids[i] = write_table(generator, root->sections[i]);
+                keys[i] = root->sections[i]->key;
+        }
+
+        size_t sections_id = write_indexes(generator,
+                                           keys,
+                                           root->sections_index,
+                                           root->sections_length);
+
+        if (root->sections_length > 0) {
+                fprintf(out,
+                        "static struct sroc_table *const sections%zu[] = {",
+                        sections_id);
+
+                for (size_t i = 0; i < root->sections_length; ++i) {
+                        fprintf(out,
+                                "%s(struct sroc_table *)&table%zu",
+                                (i == 0) ? "" : ", ",
+                                ids[i]);
+                }
+
+                fprintf(out, "};\n");
+        }
+
+        fprintf(out, "\nconst struct sroc_root %s = {\n", symbol);
+        fprintf(out, "        .items_length = %zu,\n", root->items_length);
+
+        if (root->items_length > 0) {
+                fprintf(out,
+                        "        .items = (struct sroc_item **)items%zu,\n",
+                        items_id);
+        } else {
+                fprintf(out, "        .items = NULL,\n");
+        }
+
+        write_index_fields(generator,
+                           items_id,
+                           root->items_length,
+                           "items_index",
+                           "items_lookup");
+        fprintf(out,
+                "        .sections_length = %zu,\n",
+                root->sections_length);
+
+        if (root->sections_length > 0) {
+                fprintf(out,
+                        "        .sections = "
+                        "(struct sroc_table **)sections%zu,\n",
+                        sections_id);
+        } else {
+                fprintf(out, "        .sections = NULL,\n");
+        }
+
+        write_index_fields(generator,
+                           sections_id,
+                           root->sections_length,
+                           "sections_index",
+                           "sections_lookup");
+
+        // Marks the root as read only for sroc_derive and sroc_destroy_root
+        fprintf(out, "        .references = SROC_STATIC_ROOT,\n");
+        fprintf(out, "};\n");
+
+        free(ids);
+        free(keys);
+}
+
+static int write_source(const char *path, const char *input,
+                        const struct sroc_root *root, const char *symbol)
+{
+        FILE *out = fopen(path, "w");
+
+        if (out == NULL) {
+                fprintf(stderr, "sroc-compile: unable to open %s\n", path);
+
+                return -1;
+        }
+
+        struct generator generator = {
+                .out = out,
+                .counter = 0,
+        };
+
+        fprintf(out,
+                "// Generated by sroc-compile from %s - do not edit\n\n"
+                "#include <stdbool.h>\n"
+                "#include <stddef.h>\n"
+                "#include <stdint.h>\n\n"
+                "#include <sroc.h>\n\n"
+                "// The library reads through non-const pointers but never\n"
+                "// writes through them, so the data can stay in .rodata\n"
+                "#if defined(__GNUC__)\n"
+                "#pragma GCC diagnostic ignored \"-Wcast-qual\"\n"
+                "#endif\n\n",
+                input);
+
+        write_root(&generator, root, symbol);
+
+        if (fclose(out) != 0) {
+                fprintf(stderr, "sroc-compile: unable to write %s\n", path);
+
+                return -1;
+        }
+
+        return 0;
+}
+
+static int write_header(const char *path, const char *input,
+                        const char *symbol)
+{
+        FILE *out = fopen(path, "w");
+
+        if (out == NULL) {
+                fprintf(stderr, "sroc-compile: unable to open %s\n", path);
+
+                return -1;
+        }
+
+        fprintf(out,
+                "// Generated by sroc-compile from %s - do not edit\n\n"
+                "#pragma once\n\n"
+                "#include <sroc.h>\n\n"
+                "// Embedded configuration which can be passed to any of the\n"
+                "// sroc_read_* functions. It lives in read-only memory and\n"
+                "// must never be destroyed, reparsed or modified\n"
+                "extern const struct sroc_root %s;\n",
+                input,
+                symbol);
+
+        if (fclose(out) != 0) {
+                fprintf(stderr, "sroc-compile: unable to write %s\n", path);
+
+                return -1;
+        }
+
+        return 0;
+}
+
+int main(int argc, char **argv)
+{
+        if (argc != 5) {
+                fprintf(stderr,
+                        "Usage: sroc-compile <input.conf> <output.c> "
+                        "<output.h> <symbol>\n");
+
+                return EXIT_FAILURE;
+        }
+
+        FILE *input = fopen(argv[1], "r");
+
+        if (input == NULL) {
+                fprintf(stderr, "sroc-compile: unable to open %s\n", argv[1]);
+
+                return EXIT_FAILURE;
+        }
+
+        struct sroc_root *root = sroc_parse_file(input);
+
+        fclose(input);
+
+        if (root == NULL) {
+                fprintf(stderr, "sroc-compile: unable to parse %s\n", argv[1]);
+
+                return EXIT_FAILURE;
+        }
+
+        int result = write_source(argv[2], argv[1], root, argv[4]);
+
+        if (result == 0) {
+                result = write_header(argv[3], argv[1], argv[4]);
+        }
+
+        sroc_destroy_root(root);
+
+        return (result == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}